@@ -0,0 +1,140 @@
+/*
+ * File: argument-values.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <argument-values.h>
+#include <utf8.h>
+
+// STL includes
+#include <stdexcept>
+#include <thread>
+#include <exception>
+
+namespace
+{
+  // Make the list of characters allowed in values
+  std::string printableChars()
+  {
+    std::string chars;
+    for (int c = 33; c <= 126; ++c)
+      chars += static_cast<char>(c);
+    for (int c = 128; c <= 255; ++c)
+      chars += static_cast<char>(c);
+    return chars;
+  }
+}
+
+const std::string ArgumentValues::VALID_CHARS = printableChars();
+
+// Use fixed values
+ArgumentValues::ArgumentValues(const std::vector<std::string>& values) :
+  trie_{ build(values) }
+{
+}
+
+// Use values in a trie
+ArgumentValues::ArgumentValues(std::unique_ptr<CommandTrie> trie) :
+  trie_{ std::move(trie) }
+{
+}
+
+// Use a provider
+ArgumentValues::ArgumentValues(ValueProvider provider, std::chrono::milliseconds ttl) :
+  provider_{ std::move(provider) },
+  ttl_{ ttl }
+{
+}
+
+// Get the values to complete from
+std::shared_ptr<const CommandTrie> ArgumentValues::trie()
+{
+  if (!provider_)
+    return trie_;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Swap in the new values if a fetch has finished. If it failed, keep the old
+  // ones and try again once they've expired
+  if (pending_.valid() && pending_.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+  {
+    try
+    {
+      trie_ = pending_.get();
+      error_.clear();
+    }
+    catch (std::exception& e)
+    {
+      error_ = e.what();
+    }
+    fetched_at_ = std::chrono::steady_clock::now();
+  }
+
+  // Fetch again if we've never fetched, or the values have expired
+  bool expired = std::chrono::steady_clock::now() - fetched_at_ >= ttl_;
+  if (!pending_.valid() && ((!trie_ && error_.empty()) || expired))
+    startFetch();
+  return trie_;
+}
+
+// Get why the last fetch failed
+std::string ArgumentValues::error() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return error_;
+}
+
+// Build a trie of values
+std::unique_ptr<CommandTrie> ArgumentValues::build(const std::vector<std::string>& values)
+{
+  auto trie = std::make_unique<CommandTrie>(VALID_CHARS);
+  for (const auto& value : values)
+  {
+    if (!value.empty() && value.find_first_not_of(VALID_CHARS) == std::string::npos && isValidUtf8(value))
+      trie->insert(value);
+  }
+  return trie;
+}
+
+// Start fetching the values
+void ArgumentValues::startFetch()
+{
+  // The thread only shares the promise's state with us, so it can outlive the values
+  std::promise<std::unique_ptr<CommandTrie>> fetched;
+  pending_ = fetched.get_future();
+  std::thread([provider = provider_, fetched = std::move(fetched)]() mutable
+  {
+    try
+    {
+      fetched.set_value(build(provider()));
+    }
+    catch (...)
+    {
+      fetched.set_exception(std::current_exception());
+    }
+  }).detach();
+}
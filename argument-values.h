@@ -0,0 +1,134 @@
+/*
+ * File: argument-values.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// test-console includes
+#include <trie.h>
+
+// STL includes
+#include <string>
+#include <vector>
+#include <functional>
+#include <future>
+#include <memory>
+#include <chrono>
+#include <mutex>
+
+/*!
+ * A function that gets the values an argument can take (e.g. node names from
+ * a remote service). It's called on a background thread, so it can take a
+ * while, and it can throw if it can't get them. It can still be running after
+ * the command it's for has gone, so it shouldn't refer to anything that goes with it
+ */
+using ValueProvider = std::function<std::vector<std::string>()>;
+
+/*!
+ * The values one argument of a command can take, for <Tab> completion. They're
+ * either fixed when the command is set up, or come from a provider. A
+ * provider isn't called until the argument is first completed, and its values
+ * are kept for a time to live. When they've expired, the old values are still
+ * used while the new ones are fetched (and built into a trie) in the
+ * background, so completing never waits for the provider. Nor does destroying
+ * the values: a fetch that's still running is left to finish on its own
+ * thread, and its result is thrown away. Sessions that share a registry
+ * complete from the same values, so they can be used from any thread.
+ */
+class ArgumentValues
+{
+public:
+
+  //! The bytes allowed in values: any printable ASCII character except a space (which splits arguments),
+  //! and the bytes of non-ASCII UTF-8 characters
+  static const std::string VALID_CHARS;
+
+  /*!
+   * Use a fixed set of values
+   * \param values The values. Any with characters that aren't allowed (or that aren't valid UTF-8) are left out
+   */
+  explicit ArgumentValues(const std::vector<std::string>& values);
+
+  /*!
+   * Use values that are already in a trie (e.g. one opened from an image with CommandTrie::openImage())
+   * \param trie The values
+   */
+  explicit ArgumentValues(std::unique_ptr<CommandTrie> trie);
+
+  /*!
+   * Get the values from a provider when they're needed
+   * \param provider The function that gets the values
+   * \param ttl How long to keep the values before getting them again
+   */
+  ArgumentValues(ValueProvider provider, std::chrono::milliseconds ttl);
+
+  /*!
+   * Get the values to complete from, starting to fetch them in the background if they've expired
+   * \return The values, or nullptr if the first fetch hasn't finished yet (or failed). They're kept
+   *         for as long as they're held, even if newer ones arrive
+   */
+  std::shared_ptr<const CommandTrie> trie();
+
+  /*!
+   * Get why the last fetch of the values failed
+   * \return The error, or an empty string if it didn't fail
+   */
+  std::string error() const;
+
+private:
+
+  /*!
+   * Build a trie of values
+   * \param values The values
+   * \return The trie
+   */
+  static std::unique_ptr<CommandTrie> build(const std::vector<std::string>& values);
+
+  //! Start fetching the values in the background
+  void startFetch();
+
+  //! Guards everything that changes when the values are fetched
+  mutable std::mutex mutex_;
+
+  //! The values, once we have them
+  std::shared_ptr<const CommandTrie> trie_;
+
+  //! Where the values come from (empty for fixed values)
+  ValueProvider provider_;
+
+  //! How long the provider's values are kept
+  std::chrono::milliseconds ttl_{ 0 };
+
+  //! When the values were last fetched
+  std::chrono::steady_clock::time_point fetched_at_;
+
+  //! The fetch in progress, if there is one. It's not from std::async, so dropping it doesn't wait for the provider
+  std::future<std::unique_ptr<CommandTrie>> pending_;
+
+  //! Why the last fetch failed
+  std::string error_;
+};
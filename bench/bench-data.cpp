@@ -0,0 +1,70 @@
+/*
+ * File: bench/bench-data.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <bench/bench-data.h>
+
+// STL includes
+#include <random>
+
+const std::string BENCH_COMMAND_CHARS = "abcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Make a set of synthetic commands
+std::vector<std::string> syntheticCommands(std::size_t n)
+{
+  static const char* const words[] = { "cluster", "node", "drain", "get", "set", "show", "config", "log",
+    "user", "group", "add", "remove", "list", "status", "restart", "queue", "job", "net", "route", "disk" };
+  const std::size_t n_words = sizeof(words) / sizeof(words[0]);
+
+  // A fixed seed, so every run measures the same commands
+  std::mt19937 gen(12345);
+  std::uniform_int_distribution<std::size_t> pick(0, n_words - 1);
+  std::uniform_int_distribution<int> n_parts(1, 3);
+
+  std::vector<std::string> commands;
+  commands.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    std::string command;
+    for (int part = n_parts(gen); part > 0; --part)
+    {
+      command += words[pick(gen)];
+      command += '-';
+    }
+
+    // The index in base 36 keeps the commands unique
+    std::size_t id = i;
+    do
+    {
+      command += BENCH_COMMAND_CHARS[id % 36];
+      id /= 36;
+    } while (id > 0);
+    commands.push_back(std::move(command));
+  }
+  return commands;
+}
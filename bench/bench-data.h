@@ -0,0 +1,50 @@
+/*
+ * File: bench/bench-data.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// STL includes
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/*!
+ * Data shared by the benchmarks. The commands are made up, but look like a
+ * real command set: a few words joined by '-', so many of them share long
+ * prefixes, with a number on the end to keep each one unique
+ */
+
+//! The characters the synthetic commands use
+extern const std::string BENCH_COMMAND_CHARS;
+
+/*!
+ * Make a set of synthetic commands
+ * \param n The number of commands
+ * \return The commands, which are always the same for the same n
+ */
+std::vector<std::string> syntheticCommands(std::size_t n);
@@ -0,0 +1,155 @@
+/*
+ * File: bench/concurrent-trie-bench.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Benchmarks for ConcurrentCommandTrie: searching from several threads, with
+ * and without another thread adding and removing commands at the same time,
+ * against the plain trie on one thread for a baseline.
+ */
+
+// test-console includes
+#include <concurrent-trie.h>
+#include <bench/bench-data.h>
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+// STL includes
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+namespace
+{
+  // The number of commands in the trie
+  constexpr std::size_t N_COMMANDS = 10000;
+
+  // The trie and what's searched for, shared by the benchmark's threads
+  std::unique_ptr<ConcurrentCommandTrie> shared_trie;
+  std::vector<std::string> shared_prefixes;
+
+  // The thread changing the trie while it's searched, and how many changes it made
+  std::thread writer;
+  std::atomic<bool> stop_writer{ false };
+  std::atomic<std::size_t> n_changes{ 0 };
+
+  // Build the shared trie, and start the writer if we want one
+  void setUp(bool with_writer)
+  {
+    auto commands = syntheticCommands(N_COMMANDS);
+    shared_trie = std::make_unique<ConcurrentCommandTrie>(BENCH_COMMAND_CHARS);
+    shared_trie->update([&](CommandTrie& trie)
+    {
+      for (const auto& command : commands)
+        trie.insert(command);
+    });
+
+    shared_prefixes.clear();
+    for (std::size_t i = 0; i < commands.size() && shared_prefixes.size() < 1024; i += 7)
+      shared_prefixes.push_back(commands[i].substr(0, commands[i].find('-') + 1));
+
+    n_changes = 0;
+    stop_writer = false;
+    if (with_writer)
+    {
+      writer = std::thread([]()
+      {
+        // Like nodes joining and leaving a cluster
+        for (std::size_t i = 0; !stop_writer; ++i)
+        {
+          std::string command = "node-joined-" + std::to_string(i % 16);
+          if (i % 32 < 16)
+            shared_trie->insert(command);
+          else
+            shared_trie->remove(command);
+          ++n_changes;
+        }
+      });
+    }
+  }
+
+  // Stop the writer and free the trie
+  void tearDown()
+  {
+    stop_writer = true;
+    if (writer.joinable())
+      writer.join();
+    shared_trie.reset();
+  }
+}
+
+// Time searching the plain trie, for a baseline
+static void BM_PlainTrieFind(benchmark::State& state)
+{
+  auto commands = syntheticCommands(N_COMMANDS);
+  CommandTrie trie(BENCH_COMMAND_CHARS);
+  for (const auto& command : commands)
+    trie.insert(command);
+
+  std::vector<std::string> prefixes;
+  for (std::size_t i = 0; i < commands.size() && prefixes.size() < 1024; i += 7)
+    prefixes.push_back(commands[i].substr(0, commands[i].find('-') + 1));
+
+  TrieMatches matches;
+  std::size_t i = 0;
+  for (auto _ : state)
+  {
+    trie.find(prefixes[i], matches);
+    benchmark::DoNotOptimize(matches.paths());
+    i = (i + 1) % prefixes.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PlainTrieFind);
+
+// Time searching from several threads at once
+static void BM_ConcurrentTrieFind(benchmark::State& state, bool with_writer)
+{
+  if (state.thread_index() == 0)
+    setUp(with_writer);
+
+  TrieMatches matches;
+  std::size_t i = static_cast<std::size_t>(state.thread_index());
+  for (auto _ : state)
+  {
+    shared_trie->find(shared_prefixes[i], matches);
+    benchmark::DoNotOptimize(matches.paths());
+    i = (i + 1) % shared_prefixes.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0)
+  {
+    tearDown();
+    state.counters["changes"] = static_cast<double>(n_changes.load());
+  }
+}
+BENCHMARK_CAPTURE(BM_ConcurrentTrieFind, readers_only, false)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_CAPTURE(BM_ConcurrentTrieFind, with_writer, true)->ThreadRange(1, 8)->UseRealTime();
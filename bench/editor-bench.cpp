@@ -0,0 +1,246 @@
+/*
+ * File: bench/editor-bench.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Benchmarks for the line editor. The renderer is measured on its own, and
+ * the whole console is measured by feeding it a scripted stream of key
+ * presses. For the console, stdin is swapped for a pipe (the console reads a
+ * pipe as it would a terminal, without changing any settings) and stdout is
+ * swapped for another pipe, so we can count the bytes that would have gone
+ * to the terminal.
+ */
+
+// test-console includes
+#include <console.h>
+#include <renderer.h>
+#include <line-buffer.h>
+#include <output.h>
+#include <bench/bench-data.h>
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+// POSIX includes
+#include <unistd.h>
+#include <fcntl.h>
+
+// STL includes
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <cstdint>
+
+namespace
+{
+  /*!
+   * Swap stdin and stdout for pipes while it exists, so the console can be
+   * fed keys and its output counted
+   */
+  class PipedStdio
+  {
+  public:
+    PipedStdio()
+    {
+      std::cout.flush();
+      if (pipe(input_) != 0 || pipe(output_) != 0)
+        throw std::runtime_error("Unable to create the pipes for the console");
+      fcntl(output_[0], F_SETFL, fcntl(output_[0], F_GETFL) | O_NONBLOCK);
+      saved_stdin_ = dup(0);
+      saved_stdout_ = dup(1);
+      dup2(input_[0], 0);
+      dup2(output_[1], 1);
+    }
+
+    ~PipedStdio()
+    {
+      std::cout.flush();
+      dup2(saved_stdin_, 0);
+      dup2(saved_stdout_, 1);
+      for (int fd : { saved_stdin_, saved_stdout_, input_[0], input_[1], output_[0], output_[1] })
+        close(fd);
+    }
+
+    // Send keys to the console
+    void type(const std::string& keys)
+    {
+      std::size_t done = 0;
+      while (done < keys.size())
+      {
+        ssize_t n = write(input_[1], keys.data() + done, keys.size() - done);
+        if (n <= 0)
+          throw std::runtime_error("Unable to write to the console input");
+        done += n;
+      }
+    }
+
+    // Throw away the console's output, returning the number of bytes
+    std::size_t drain()
+    {
+      std::size_t total = 0;
+      char buffer[4096];
+      ssize_t n = 0;
+      while ((n = read(output_[0], buffer, sizeof(buffer))) > 0)
+        total += n;
+      return total;
+    }
+
+  private:
+    int input_[2] = { -1, -1 };
+    int output_[2] = { -1, -1 };
+    int saved_stdin_ = -1;
+    int saved_stdout_ = -1;
+  };
+
+  //! A script of key presses, and the number of lines and keys in it
+  struct KeyScript
+  {
+    std::string bytes;
+    std::size_t lines = 0;
+    std::size_t keys = 0;
+  };
+
+  // Build a script that edits lines the way someone typing commands does: type
+  // the start, complete it with <Tab>, fix a typo, move about and press <Enter>
+  KeyScript editingScript(const std::vector<std::string>& commands, std::size_t n_lines)
+  {
+    KeyScript script;
+    for (std::size_t i = 0; i < n_lines; ++i)
+    {
+      const std::string& command = commands[(i * 7919) % commands.size()];
+      std::size_t typed = command.find('-') + 2;
+      script.bytes.append(command, 0, typed);
+      script.keys += typed;
+
+      script.bytes += '\t';
+      script.bytes += "xy\x7f\x7f";
+      script.bytes.append(command, typed, std::string::npos);
+      script.keys += 5 + command.size() - typed;
+
+      script.bytes += " arg\x1b[D\x1b[D\x1b[D\x1b[CX\x1b[F\r";
+      script.keys += 11;
+      ++script.lines;
+    }
+    return script;
+  }
+
+  // Type a key at the end of a line, rendering after each one
+  void renderTyping(LineBuffer& line, LineRenderer& renderer, OutputBuffer& out, std::size_t length)
+  {
+    for (std::size_t i = 0; i < length; ++i)
+    {
+      line.insert(static_cast<char>('a' + i % 26));
+      renderer.render(line, out);
+    }
+  }
+}
+
+// Time the renderer for typing a line, one key at a time
+static void BM_RenderTyping(benchmark::State& state)
+{
+  std::size_t length = static_cast<std::size_t>(state.range(0));
+  LineBuffer line;
+  LineRenderer renderer;
+  OutputBuffer out;
+  std::size_t bytes = 0;
+  for (auto _ : state)
+  {
+    line.clear();
+    renderer.reset();
+    renderTyping(line, renderer, out, length);
+    bytes += out.size();
+    out.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * length);
+  state.counters["bytes_per_key"] = static_cast<double>(bytes) / (state.iterations() * length);
+}
+BENCHMARK(BM_RenderTyping)->Arg(16)->Arg(80)->Arg(1000);
+
+// Time the renderer for typing in the middle of a line, which has to redraw what's after the cursor
+static void BM_RenderMidLine(benchmark::State& state)
+{
+  std::size_t length = static_cast<std::size_t>(state.range(0));
+  LineBuffer line;
+  LineRenderer renderer;
+  OutputBuffer out;
+  renderTyping(line, renderer, out, length);
+  line.moveCursor(length / 2);
+  renderer.render(line, out);
+  out.clear();
+
+  std::size_t bytes = 0;
+  for (auto _ : state)
+  {
+    line.insert('x');
+    renderer.render(line, out);
+    line.eraseBefore();
+    renderer.render(line, out);
+    bytes += out.size();
+    out.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+  state.counters["bytes_per_key"] = static_cast<double>(bytes) / (state.iterations() * 2);
+}
+BENCHMARK(BM_RenderMidLine)->Arg(16)->Arg(80)->Arg(1000);
+
+// Time the whole console handling a scripted stream of keys, with the commands it completes
+static void BM_ConsoleEditing(benchmark::State& state)
+{
+  auto commands = syntheticCommands(static_cast<std::size_t>(state.range(0)));
+  KeyScript script = editingScript(commands, 100);
+
+  std::size_t bytes_out = 0;
+  {
+    PipedStdio stdio;
+    TestConsole console("bench ->");
+    for (const auto& command : commands)
+      console.addCommand(command, [](std::string_view, OutputBuffer&) {});
+
+    stdio.type(script.bytes);
+    for (std::size_t done = 0; done < script.lines; )
+      done += console.processPendingInput().size();
+    stdio.drain();
+
+    for (auto _ : state)
+    {
+      stdio.type(script.bytes);
+      for (std::size_t done = 0; done < script.lines; )
+      {
+        done += console.processPendingInput().size();
+        bytes_out += stdio.drain();
+      }
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * script.keys);
+  state.SetBytesProcessed(state.iterations() * script.bytes.size());
+  state.counters["lines_per_second"] = benchmark::Counter(static_cast<double>(state.iterations() * script.lines),
+    benchmark::Counter::kIsRate);
+  state.counters["bytes_out_per_key"] = static_cast<double>(bytes_out) / (state.iterations() * script.keys);
+}
+BENCHMARK(BM_ConsoleEditing)->ArgName("commands")->Arg(1000)->Arg(100000)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,249 @@
+/*
+ * File: bench/trie-bench.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Benchmarks for CommandTrie. Each one runs for 1k, 10k and 100k commands,
+ * with both node layouts, so the layouts (and any new trie we try) can be
+ * compared on the same commands.
+ */
+
+// test-console includes
+#include <trie.h>
+#include <bench/bench-data.h>
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+// STL includes
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+namespace
+{
+  // Get the node layout for a benchmark argument
+  TrieMode benchMode(std::int64_t arg)
+  {
+    return arg == 0 ? TrieMode::simple : TrieMode::radix;
+  }
+
+  // Build a trie holding a set of commands
+  CommandTrie buildTrie(const std::vector<std::string>& commands, TrieMode mode)
+  {
+    CommandTrie trie(BENCH_COMMAND_CHARS, mode);
+    for (const auto& command : commands)
+      trie.insert(command);
+    return trie;
+  }
+
+  // Get prefixes of the commands to search for: the first word, which
+  // matches many commands, and most of the command, which matches a few
+  std::vector<std::string> searchPrefixes(const std::vector<std::string>& commands)
+  {
+    std::vector<std::string> prefixes;
+    for (std::size_t i = 0; i < commands.size() && prefixes.size() < 1024; i += 7)
+    {
+      const std::string& command = commands[i];
+      prefixes.push_back(command.substr(0, command.find('-') + 1));
+      prefixes.push_back(command.substr(0, command.size() - 1));
+    }
+    return prefixes;
+  }
+
+  // Run a benchmark for each number of commands and each node layout
+  void trieArgs(benchmark::internal::Benchmark* b)
+  {
+    b->ArgNames({ "commands", "radix" });
+    for (std::int64_t n : { 1000, 10000, 100000 })
+      for (std::int64_t mode : { 0, 1 })
+        b->Args({ n, mode });
+  }
+}
+
+// Time inserting every command into an empty trie, and report its memory use
+static void BM_TrieInsert(benchmark::State& state)
+{
+  auto commands = syntheticCommands(static_cast<std::size_t>(state.range(0)));
+  TrieMode mode = benchMode(state.range(1));
+
+  std::size_t bytes = 0;
+  std::size_t nodes = 0;
+  for (auto _ : state)
+  {
+    CommandTrie trie(BENCH_COMMAND_CHARS, mode);
+    for (const auto& command : commands)
+      trie.insert(command);
+    benchmark::ClobberMemory();
+
+    state.PauseTiming();
+    bytes = trie.memoryUsage();
+    nodes = trie.nodeCount();
+    state.ResumeTiming();
+  }
+
+  double n = static_cast<double>(commands.size());
+  state.SetItemsProcessed(state.iterations() * commands.size());
+  state.counters["bytes_per_command"] = static_cast<double>(bytes) / n;
+  state.counters["nodes_per_command"] = static_cast<double>(nodes) / n;
+}
+BENCHMARK(BM_TrieInsert)->Apply(trieArgs)->Unit(benchmark::kMillisecond);
+
+// Time a search with the version returning a tuple (which allocates its results)
+static void BM_TrieFind(benchmark::State& state, bool ret_pos)
+{
+  auto commands = syntheticCommands(static_cast<std::size_t>(state.range(0)));
+  CommandTrie trie = buildTrie(commands, benchMode(state.range(1)));
+  auto prefixes = searchPrefixes(commands);
+
+  std::size_t i = 0;
+  std::size_t found = 0;
+  for (auto _ : state)
+  {
+    auto result = trie.find(prefixes[i], ret_pos);
+    found += std::get<2>(result).size();
+    benchmark::DoNotOptimize(result);
+    i = (i + 1) % prefixes.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["commands_per_find"] = benchmark::Counter(static_cast<double>(found),
+    benchmark::Counter::kAvgIterations);
+}
+BENCHMARK_CAPTURE(BM_TrieFind, completion, false)->Apply(trieArgs);
+BENCHMARK_CAPTURE(BM_TrieFind, with_commands, true)->Apply(trieArgs);
+
+// Time a search into reusable results, which shouldn't allocate once they've grown
+static void BM_TrieFindMatches(benchmark::State& state, bool ret_pos)
+{
+  auto commands = syntheticCommands(static_cast<std::size_t>(state.range(0)));
+  CommandTrie trie = buildTrie(commands, benchMode(state.range(1)));
+  auto prefixes = searchPrefixes(commands);
+
+  TrieMatches matches;
+  std::size_t i = 0;
+  std::size_t allocations = 0;
+  for (auto _ : state)
+  {
+    trie.find(prefixes[i], matches, ret_pos);
+    allocations += matches.allocations();
+    benchmark::DoNotOptimize(matches.paths());
+    i = (i + 1) % prefixes.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["allocations"] = static_cast<double>(allocations);
+}
+BENCHMARK_CAPTURE(BM_TrieFindMatches, completion, false)->Apply(trieArgs);
+BENCHMARK_CAPTURE(BM_TrieFindMatches, with_commands, true)->Apply(trieArgs);
+
+// Time completing after every key while typing commands, searching the whole line each time
+static void BM_TrieTypingFind(benchmark::State& state)
+{
+  auto commands = syntheticCommands(static_cast<std::size_t>(state.range(0)));
+  CommandTrie trie = buildTrie(commands, benchMode(state.range(1)));
+
+  TrieMatches matches;
+  std::size_t i = 0;
+  std::size_t n_keys = 0;
+  for (auto _ : state)
+  {
+    const std::string& command = commands[i];
+    for (std::size_t length = 1; length <= command.size(); ++length)
+    {
+      trie.find(command.substr(0, length), matches);
+      benchmark::DoNotOptimize(matches.paths());
+    }
+    n_keys += command.size();
+    i = (i + 7919) % commands.size();
+  }
+  state.SetItemsProcessed(n_keys);
+}
+BENCHMARK(BM_TrieTypingFind)->Apply(trieArgs);
+
+// Time the same, moving a cursor one key at a time instead
+static void BM_TrieTypingCursor(benchmark::State& state)
+{
+  auto commands = syntheticCommands(static_cast<std::size_t>(state.range(0)));
+  CommandTrie trie = buildTrie(commands, benchMode(state.range(1)));
+
+  TrieMatches matches;
+  TrieCursor cursor;
+  std::size_t i = 0;
+  std::size_t n_keys = 0;
+  for (auto _ : state)
+  {
+    const std::string& command = commands[i];
+    for (std::size_t length = 1; length <= command.size(); ++length)
+    {
+      trie.moveCursor(cursor, std::string_view(command).substr(0, length));
+      trie.find(cursor, matches);
+      benchmark::DoNotOptimize(matches.paths());
+    }
+    n_keys += command.size();
+    i = (i + 7919) % commands.size();
+  }
+  state.SetItemsProcessed(n_keys);
+}
+BENCHMARK(BM_TrieTypingCursor)->Apply(trieArgs);
+
+// Time opening a trie image, to compare with inserting every command (BM_TrieInsert)
+static void BM_TrieImageOpen(benchmark::State& state)
+{
+  auto commands = syntheticCommands(static_cast<std::size_t>(state.range(0)));
+  std::string path = (std::filesystem::temp_directory_path() / "test-console-bench.trie").string();
+  buildTrie(commands, benchMode(state.range(1))).saveImage(path);
+
+  for (auto _ : state)
+  {
+    CommandTrie trie = CommandTrie::openImage(path);
+    benchmark::DoNotOptimize(trie.nodeCount());
+  }
+  std::filesystem::remove(path);
+}
+BENCHMARK(BM_TrieImageOpen)->Apply(trieArgs)->Unit(benchmark::kMicrosecond);
+
+// Time searching a trie image, which should be the same as searching a trie built in memory (BM_TrieFindMatches)
+static void BM_TrieImageFind(benchmark::State& state)
+{
+  auto commands = syntheticCommands(static_cast<std::size_t>(state.range(0)));
+  std::string path = (std::filesystem::temp_directory_path() / "test-console-bench.trie").string();
+  buildTrie(commands, benchMode(state.range(1))).saveImage(path);
+  CommandTrie trie = CommandTrie::openImage(path);
+  auto prefixes = searchPrefixes(commands);
+
+  TrieMatches matches;
+  std::size_t i = 0;
+  for (auto _ : state)
+  {
+    trie.find(prefixes[i], matches);
+    benchmark::DoNotOptimize(matches.paths());
+    i = (i + 1) % prefixes.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  std::filesystem::remove(path);
+}
+BENCHMARK(BM_TrieImageFind)->Apply(trieArgs);
@@ -0,0 +1,226 @@
+/*
+ * File: command-registry.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <command-registry.h>
+#include <utf8.h>
+
+// STL includes
+#include <stdexcept>
+#include <limits>
+#include <mutex>
+
+// Create an empty registry
+CommandRegistry::CommandRegistry(const std::string& valid_chars) :
+  trie_(valid_chars)
+{
+}
+
+// Add or replace a command
+void CommandRegistry::add(const std::string& name, CommandHandler handler)
+{
+  add(name, ConsoleCommandHandler([handler = std::move(handler)](TestConsole&, std::string_view args,
+    OutputBuffer& out) { handler(args, out); }));
+}
+
+// Add or replace a command that needs its console
+void CommandRegistry::add(const std::string& name, ConsoleCommandHandler handler)
+{
+  std::vector<std::pair<std::string, ConsoleCommandHandler>> commands;
+  commands.emplace_back(name, std::move(handler));
+  add(std::move(commands));
+}
+
+// Add or replace several commands
+void CommandRegistry::add(std::vector<std::pair<std::string, ConsoleCommandHandler>> commands)
+{
+  // The trie checks the characters, but not that they make up whole UTF-8 characters
+  for (const auto& command : commands)
+  {
+    if (!isValidUtf8(command.first))
+      throw std::out_of_range("The command name '" + command.first + "' isn't valid UTF-8");
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+
+  // Commands that are already there keep their slots, and new ones get a free one. They
+  // all go into one copy of the trie, so adding many commands only copies it once
+  std::vector<std::uint32_t> slots(commands.size());
+  std::vector<std::size_t> added;
+  try
+  {
+    trie_.update([&](CommandTrie& trie)
+    {
+      for (std::size_t i = 0; i < commands.size(); ++i)
+      {
+        if (trie.lookup(commands[i].first, slots[i]))
+          continue;
+        slots[i] = allocateSlot();
+        added.push_back(i);
+        trie.insert(commands[i].first, slots[i]);
+      }
+    });
+  }
+  catch (...)
+  {
+    // Nothing was published, so the new slots are still free
+    for (auto i : added)
+      free_slots_.push_back(slots[i]);
+    throw;
+  }
+
+  for (std::size_t i = 0; i < commands.size(); ++i)
+    handlers_[slots[i]] = std::move(commands[i].second);
+
+  for (std::size_t n = 0; n < added.size(); ++n)
+  {
+    try
+    {
+      fuzzy_.insert(commands[added[n]].first);
+    }
+    catch (...)
+    {
+      // Take out the new commands the fuzzy matcher doesn't have
+      trie_.update([&](CommandTrie& trie)
+      {
+        for (std::size_t k = n; k < added.size(); ++k)
+          trie.remove(commands[added[k]].first);
+      });
+      for (std::size_t k = n; k < added.size(); ++k)
+      {
+        handlers_[slots[added[k]]] = nullptr;
+        free_slots_.push_back(slots[added[k]]);
+      }
+      throw;
+    }
+  }
+}
+
+// Remove a command
+bool CommandRegistry::remove(const std::string& name)
+{
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  std::uint32_t slot = 0;
+  if (!trie_.lookup(name, slot))
+    return false;
+
+  trie_.remove(name);
+  fuzzy_.remove(name);
+  handlers_[slot] = nullptr;
+  arguments_[slot].clear();
+  free_slots_.push_back(slot);
+  return true;
+}
+
+// Note that a command was used
+void CommandRegistry::used(const std::string& name)
+{
+  // Collect the scores, and only publish them now and again, as each publish copies the trie
+  std::unordered_map<std::string, std::uint32_t> scores;
+  {
+    std::lock_guard<std::mutex> lock(score_mutex_);
+    ++pending_scores_[name];
+    ++n_pending_;
+    auto now = std::chrono::steady_clock::now();
+    if (n_pending_ < SCORE_BATCH && now - scores_published_ < SCORE_INTERVAL)
+      return;
+    scores.swap(pending_scores_);
+    n_pending_ = 0;
+    scores_published_ = now;
+  }
+
+  // Commands removed since they were used are skipped
+  trie_.update([&](CommandTrie& trie)
+  {
+    for (const auto& [command, amount] : scores)
+      trie.addScore(command, amount);
+  });
+}
+
+// Give a new command a slot
+std::uint32_t CommandRegistry::allocateSlot()
+{
+  if (!free_slots_.empty())
+  {
+    std::uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+  }
+
+  if (handlers_.size() >= std::numeric_limits<std::uint32_t>::max())
+    throw std::length_error("There are too many commands");
+  handlers_.emplace_back();
+  arguments_.emplace_back();
+  return static_cast<std::uint32_t>(handlers_.size() - 1);
+}
+
+// Find a command's handler
+ConsoleCommandHandler CommandRegistry::find(const std::string& name) const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::uint32_t slot = 0;
+  if (!trie_.lookup(name, slot))
+    return nullptr;
+  return handlers_[slot];
+}
+
+// Set the values of an argument
+void CommandRegistry::setArgument(const std::string& name, std::size_t position,
+  std::shared_ptr<ArgumentValues> values)
+{
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  std::uint32_t slot = 0;
+  if (!trie_.lookup(name, slot))
+    throw std::out_of_range("There's no command '" + name + "'");
+
+  auto& arguments = arguments_[slot];
+  if (arguments.size() <= position)
+    arguments.resize(position + 1);
+  arguments[position] = std::move(values);
+}
+
+// Find the values of an argument
+std::shared_ptr<ArgumentValues> CommandRegistry::argument(const std::string& name, std::size_t position) const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::uint32_t slot = 0;
+  if (!trie_.lookup(name, slot) || arguments_[slot].size() <= position)
+    return nullptr;
+  return arguments_[slot][position];
+}
+
+// Search the command names for a fuzzy match
+void CommandRegistry::findFuzzy(const std::string& pattern, FuzzyMatches& matches, std::size_t first,
+  std::size_t max_commands) const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  fuzzy_.find(pattern, matches, first, max_commands);
+
+  // The matches point into the matcher, which can change once the lock's released
+  matches.keepCommands();
+}
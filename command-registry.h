@@ -0,0 +1,228 @@
+/*
+ * File: command-registry.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// test-console includes
+#include <concurrent-trie.h>
+#include <fuzzy.h>
+#include <output.h>
+#include <argument-values.h>
+
+// STL includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <future>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <chrono>
+
+/*!
+ * The function called for a command
+ * \param args Anything typed after the command name (with the spaces before it removed)
+ * \param out Where to write the command's output (each line should end with "\r\n")
+ */
+using CommandHandler = std::function<void(std::string_view args, OutputBuffer& out)>;
+
+class TestConsole;
+
+/*!
+ * The function called for a command that works on the console it was typed in (e.g. to show that
+ * console's history). A registry can be shared by many consoles, so this is how its commands know
+ * which one they're for
+ * \param console The console the command was typed in
+ * \param args Anything typed after the command name (with the spaces before it removed)
+ * \param out Where to write the command's output (each line should end with "\r\n")
+ */
+using ConsoleCommandHandler = std::function<void(TestConsole& console, std::string_view args, OutputBuffer& out)>;
+
+/*!
+ * The function called for a command that runs in the background
+ * \param args Anything typed after the command name (with the spaces before it removed)
+ * \return The command's output, shown above the prompt when it's ready (nothing is shown if it's empty)
+ */
+using AsyncCommandHandler = std::function<std::future<std::string>(std::string args)>;
+
+/*!
+ * All the commands the console knows about. The handlers are kept in a
+ * vector of slots, and each command's slot is kept with the command in the
+ * completion trie, so running a command uses the same walk as completing it.
+ * Adding or removing a command updates the trie, the fuzzy matcher and the
+ * slots together. Each slot also holds the values for completing the
+ * command's arguments, which go when the command is removed.
+ *
+ * A registry can be shared by many consoles (e.g. the sessions of a
+ * ConsoleServer), and commands can be added and removed from any thread
+ * while they use it. Completion searches a snapshot of the trie without a
+ * lock; the handlers, the fuzzy matcher and the argument values are guarded
+ * by a reader-writer lock (values from a provider look after their own fetching).
+ */
+class CommandRegistry
+{
+public:
+
+  //! The most uses to collect before publishing their scores
+  static constexpr std::size_t SCORE_BATCH = 64;
+
+  //! The longest to wait before publishing the scores of commands that have been used
+  static constexpr std::chrono::seconds SCORE_INTERVAL{ 1 };
+
+  /*!
+   * Create an empty registry
+   * \param valid_chars The characters allowed in command names
+   */
+  explicit CommandRegistry(const std::string& valid_chars);
+
+  /*!
+   * Add a command, or replace the handler of one that's already there
+   * \param name The command name
+   * \param handler The function to call for the command
+   * \throws std::out_of_range The name includes invalid characters
+   * \throws std::length_error There's no more space for commands
+   */
+  void add(const std::string& name, CommandHandler handler);
+
+  /*!
+   * Add a command that needs the console it's typed in, or replace the handler of one that's already there
+   * \param name The command name
+   * \param handler The function to call for the command
+   * \throws std::out_of_range The name includes invalid characters
+   * \throws std::length_error There's no more space for commands
+   */
+  void add(const std::string& name, ConsoleCommandHandler handler);
+
+  /*!
+   * Add several commands (or replace their handlers), published together. Adding
+   * a command copies the trie, so this is much quicker than adding them one by one
+   * \param commands The command names, with the function to call for each
+   * \throws std::out_of_range A name includes invalid characters (none of the commands are added)
+   * \throws std::length_error There's no more space for commands
+   */
+  void add(std::vector<std::pair<std::string, ConsoleCommandHandler>> commands);
+
+  /*!
+   * Remove a command
+   * \param name The command name
+   * \return True if the command was there
+   */
+  bool remove(const std::string& name);
+
+  /*!
+   * Find the handler for a command
+   * \param name The command name
+   * \return A copy of the handler (as other threads can replace or remove it), or an empty function if
+   *         there's no such command
+   */
+  ConsoleCommandHandler find(const std::string& name) const;
+
+  /*!
+   * Note that a command was used, so it ranks higher when completing
+   * \param name The command name
+   * \note Publishing a score copies the trie, so scores are collected and published together,
+   *       every SCORE_BATCH uses or when SCORE_INTERVAL has passed since they were last published
+   */
+  void used(const std::string& name);
+
+  /*!
+   * Set the values one of a command's arguments can take, for completion
+   * \param name The command name
+   * \param position Which argument it is (0 for the first)
+   * \param values The values, replacing any that were set before
+   * \throws std::out_of_range There's no such command
+   */
+  void setArgument(const std::string& name, std::size_t position, std::shared_ptr<ArgumentValues> values);
+
+  /*!
+   * Find the values one of a command's arguments can take
+   * \param name The command name
+   * \param position Which argument it is (0 for the first)
+   * \return The values, or nullptr if none were set. They're kept while they're held, even if the command is removed
+   */
+  std::shared_ptr<ArgumentValues> argument(const std::string& name, std::size_t position) const;
+
+  /*!
+   * Get the trie of command names for completion. Take a snapshot of it to search it
+   * \return The trie
+   */
+  const ConcurrentCommandTrie& trie() const { return trie_; }
+
+  /*!
+   * Search the command names for a fuzzy match, like FuzzyMatcher::find()
+   * \param pattern The characters to look for
+   * \retval matches Set to what was found. The commands are copied into it, so they stay valid
+   *         if other threads change the registry
+   * \param first The first matching command to return
+   * \param max_commands The most commands to return
+   */
+  void findFuzzy(const std::string& pattern, FuzzyMatches& matches, std::size_t first, std::size_t max_commands) const;
+
+private:
+
+  /*!
+   * Give a new command a slot, reusing a free one if there is one (the lock must be held)
+   * \return The slot
+   * \throws std::length_error There are no more slots
+   */
+  std::uint32_t allocateSlot();
+
+  //! Guards everything but the trie. Writers hold it while they change the trie too, so a slot found under it is current
+  mutable std::shared_mutex mutex_;
+
+  //! The command names, with each one's handler slot as its value
+  ConcurrentCommandTrie trie_;
+
+  //! The command names for fuzzy completion
+  FuzzyMatcher fuzzy_;
+
+  //! The handlers - slots of removed commands hold an empty function
+  std::vector<ConsoleCommandHandler> handlers_;
+
+  //! The values for each slot's arguments, by position (null where none were set)
+  std::vector<std::vector<std::shared_ptr<ArgumentValues>>> arguments_;
+
+  //! The slots of removed commands, to reuse
+  std::vector<std::uint32_t> free_slots_;
+
+  //! Guards the scores waiting to be published
+  std::mutex score_mutex_;
+
+  //! How many times each command has been used since the scores were last published
+  std::unordered_map<std::string, std::uint32_t> pending_scores_;
+
+  //! The number of uses waiting to be published
+  std::size_t n_pending_ = 0;
+
+  //! When the scores were last published
+  std::chrono::steady_clock::time_point scores_published_;
+};
@@ -0,0 +1,196 @@
+/*
+ * File: concurrent-trie.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <concurrent-trie.h>
+
+// STL includes
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+// Announce a reader and take the current snapshot
+ConcurrentCommandTrie::Snapshot::Snapshot(const ConcurrentCommandTrie& owner)
+{
+  // Claim a free slot with the current epoch. The slot is set before the
+  // snapshot is read, so a writer that doesn't see the slot has already
+  // published the snapshot we'll read (all of these are sequentially consistent)
+  // Each thread starts looking at its own slot, so readers don't fight over the first one
+  static thread_local std::size_t first_slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % MAX_READERS;
+  for (std::size_t i = first_slot, n_tried = 1;; i = (i + 1) % MAX_READERS, ++n_tried)
+  {
+    auto& slot = owner.readers_[i].epoch;
+    std::uint64_t free_slot = 0;
+    if (slot.load(std::memory_order_relaxed) == 0 && slot.compare_exchange_strong(free_slot, owner.epoch_.load()))
+    {
+      slot_ = &slot;
+      break;
+    }
+    if (n_tried % MAX_READERS == 0)
+      std::this_thread::yield();
+  }
+  trie_ = owner.current_.load();
+}
+
+// Finish reading
+ConcurrentCommandTrie::Snapshot::~Snapshot()
+{
+  slot_->store(0, std::memory_order_release);
+}
+
+// Create an empty trie
+ConcurrentCommandTrie::ConcurrentCommandTrie(const std::string& valid_chars, TrieMode mode) :
+  current_{ new CommandTrie(valid_chars, mode) }
+{
+}
+
+// Free the snapshots
+ConcurrentCommandTrie::~ConcurrentCommandTrie()
+{
+  for (const auto& retired : retired_)
+    delete retired.trie;
+  delete current_.load();
+}
+
+// Add a command
+void ConcurrentCommandTrie::insert(const std::string& str, std::uint32_t value)
+{
+  update([&](CommandTrie& trie) { trie.insert(str, value); });
+}
+
+// Remove a command
+bool ConcurrentCommandTrie::remove(const std::string& str)
+{
+  // Don't copy the trie if there's nothing to remove
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  std::uint32_t value = 0;
+  if (!current_.load()->lookup(str, value))
+    return false;
+
+  auto trie = new CommandTrie(*current_.load());
+  trie->remove(str);
+  publish(trie);
+  return true;
+}
+
+// Increase the usage score of a command
+bool ConcurrentCommandTrie::addScore(const std::string& str, std::uint32_t amount)
+{
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  std::uint32_t value = 0;
+  if (!current_.load()->lookup(str, value))
+    return false;
+
+  auto trie = new CommandTrie(*current_.load());
+  trie->addScore(str, amount);
+  publish(trie);
+  return true;
+}
+
+// Make several changes at once
+void ConcurrentCommandTrie::update(const std::function<void(CommandTrie&)>& change)
+{
+  // Only the writer changes the current snapshot, so it can be copied without announcing a reader
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  auto trie = new CommandTrie(*current_.load());
+  try
+  {
+    change(*trie);
+  }
+  catch (...)
+  {
+    delete trie;
+    throw;
+  }
+  publish(trie);
+}
+
+// Search for a prefix
+std::tuple<std::size_t, std::string, std::vector<std::string>>
+  ConcurrentCommandTrie::find(const std::string& str, bool ret_pos) const
+{
+  return snapshot()->find(str, ret_pos);
+}
+
+// Search for a prefix, into a set of matches
+void ConcurrentCommandTrie::find(const std::string& str, TrieMatches& matches, bool ret_pos, std::size_t first,
+  std::size_t max_commands) const
+{
+  snapshot()->find(str, matches, ret_pos, first, max_commands);
+}
+
+// Search for the best scoring commands with a prefix
+void ConcurrentCommandTrie::findRanked(const std::string& str, TrieMatches& matches, std::size_t first,
+  std::size_t max_commands) const
+{
+  snapshot()->findRanked(str, matches, first, max_commands);
+}
+
+// Find a command's value
+bool ConcurrentCommandTrie::lookup(const std::string& str, std::uint32_t& value) const
+{
+  return snapshot()->lookup(str, value);
+}
+
+// Get the number of snapshots waiting to be freed
+std::size_t ConcurrentCommandTrie::retiredCount() const
+{
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  return retired_.size();
+}
+
+// Publish a new snapshot
+void ConcurrentCommandTrie::publish(const CommandTrie* trie)
+{
+  // Readers that start after the epoch moves on will see the new snapshot
+  const CommandTrie* old = current_.exchange(trie);
+  retired_.push_back({ old, epoch_.fetch_add(1) });
+  reclaim();
+}
+
+// Free the snapshots no reader can be using
+void ConcurrentCommandTrie::reclaim()
+{
+  // A snapshot retired in epoch E can only be in use by readers that started in E or earlier
+  std::uint64_t oldest = epoch_.load();
+  for (const auto& reader : readers_)
+  {
+    std::uint64_t epoch = reader.epoch.load();
+    if (epoch != 0)
+      oldest = std::min(oldest, epoch);
+  }
+
+  auto in_use = std::remove_if(retired_.begin(), retired_.end(), [oldest](const Retired& retired)
+  {
+    if (retired.epoch >= oldest)
+      return false;
+    delete retired.trie;
+    return true;
+  });
+  retired_.erase(in_use, retired_.end());
+}
@@ -0,0 +1,223 @@
+/*
+ * File: concurrent-trie.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// test-console includes
+#include <trie.h>
+
+// STL includes
+#include <string>
+#include <vector>
+#include <tuple>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+/*!
+ * A command trie that can be changed from any thread while other threads
+ * search it. Searches never take a lock: each one reads an immutable snapshot
+ * of the trie. A change copies the current snapshot, changes the copy and
+ * publishes it with an atomic pointer swap, so a search sees the trie either
+ * before or after the change and never a half-built node. Writers are
+ * serialised with a mutex.
+ *
+ * Old snapshots are freed with epoch-based reclamation. A reader announces
+ * the epoch it started in, and a replaced snapshot is freed once every reader
+ * that could still be using it has finished. Changes copy the whole trie, so
+ * they're much slower than searches - group them with update() if there are
+ * many at once.
+ */
+class ConcurrentCommandTrie
+{
+public:
+
+  //! The most threads that can search at the same time (more wait for a free slot)
+  static constexpr std::size_t MAX_READERS = 64;
+
+  /*!
+   * A snapshot of the trie to search. It's not changed or freed while the snapshot is held
+   */
+  class Snapshot
+  {
+  public:
+    ~Snapshot();
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    const CommandTrie& operator*() const { return *trie_; }
+    const CommandTrie* operator->() const { return trie_; }
+
+  private:
+    friend class ConcurrentCommandTrie;
+
+    /*!
+     * Announce a reader and take the current snapshot
+     * \param owner The trie to read
+     */
+    explicit Snapshot(const ConcurrentCommandTrie& owner);
+
+    //! The reader's slot in the owner's epochs
+    std::atomic<std::uint64_t>* slot_;
+
+    //! The snapshot
+    const CommandTrie* trie_;
+  };
+
+  /*!
+   * Create an empty trie
+   * \param valid_chars The characters allowed in commands
+   * \param mode How to lay out the nodes
+   */
+  ConcurrentCommandTrie(const std::string& valid_chars, TrieMode mode = TrieMode::radix);
+
+  //! Free the snapshots (there mustn't be any readers left)
+  ~ConcurrentCommandTrie();
+
+  ConcurrentCommandTrie(const ConcurrentCommandTrie&) = delete;
+  ConcurrentCommandTrie& operator=(const ConcurrentCommandTrie&) = delete;
+
+  /*!
+   * Take a snapshot of the trie, to search it more than once without seeing changes in between
+   * \return The snapshot
+   */
+  Snapshot snapshot() const { return Snapshot(*this); }
+
+  /*!
+   * Add a command
+   * \param str The command
+   * \param value A value to keep with the command
+   * \throws std::out_of_range The command includes invalid characters
+   * \throws std::length_error The trie is full
+   */
+  void insert(const std::string& str, std::uint32_t value = 0);
+
+  /*!
+   * Remove a command
+   * \param str The command
+   * \return True if the command was there
+   */
+  bool remove(const std::string& str);
+
+  /*!
+   * Increase the usage score of a command
+   * \param str The command
+   * \param amount How much to add
+   * \return True if the command was there
+   */
+  bool addScore(const std::string& str, std::uint32_t amount = 1);
+
+  /*!
+   * Make several changes, published together
+   * \param change A function that changes the trie it's given. If it throws, nothing is published
+   */
+  void update(const std::function<void(CommandTrie&)>& change);
+
+  /*!
+   * Search for a prefix, like CommandTrie::find()
+   * \param str The prefix
+   * \param ret_pos True to also return the matching commands
+   * \return The number of paths, the completion and (if ret_pos is true) the commands
+   */
+  std::tuple<std::size_t, std::string, std::vector<std::string>>
+    find(const std::string& str, bool ret_pos = false) const;
+
+  /*!
+   * Search for a prefix, like CommandTrie::find()
+   * \param str The prefix
+   * \retval matches Set to what was found
+   * \param ret_pos True to also return the matching commands
+   * \param first The first matching command to return
+   * \param max_commands The most commands to return
+   */
+  void find(const std::string& str, TrieMatches& matches, bool ret_pos = false, std::size_t first = 0,
+    std::size_t max_commands = std::numeric_limits<std::size_t>::max()) const;
+
+  /*!
+   * Search for a prefix, returning the best scoring commands, like CommandTrie::findRanked()
+   * \param str The prefix
+   * \retval matches Set to what was found
+   * \param first The first matching command to return
+   * \param max_commands The most commands to return
+   */
+  void findRanked(const std::string& str, TrieMatches& matches, std::size_t first, std::size_t max_commands) const;
+
+  /*!
+   * Find the value kept with a command
+   * \param str The command
+   * \retval value Set to the command's value, if it's there
+   * \return True if the command is there
+   */
+  bool lookup(const std::string& str, std::uint32_t& value) const;
+
+  /*!
+   * Get the number of replaced snapshots that are still waiting for readers to finish
+   * \return The number of snapshots
+   */
+  std::size_t retiredCount() const;
+
+private:
+
+  //! A replaced snapshot, and the epoch it was replaced in
+  struct Retired
+  {
+    const CommandTrie* trie;  /*!< The snapshot */
+    std::uint64_t epoch;      /*!< Readers that started in this epoch or earlier might still use it */
+  };
+
+  //! A reader's epoch, on its own cache line so readers don't slow each other down
+  struct alignas(64) ReaderSlot
+  {
+    std::atomic<std::uint64_t> epoch{ 0 };  /*!< The epoch the reader started in, or 0 if it's free */
+  };
+
+  /*!
+   * Publish a new snapshot, retiring the current one (the writer lock must be held)
+   * \param trie The new snapshot
+   */
+  void publish(const CommandTrie* trie);
+
+  //! Free the retired snapshots no reader can be using (the writer lock must be held)
+  void reclaim();
+
+  //! The current snapshot
+  std::atomic<const CommandTrie*> current_;
+
+  //! The current epoch, moved on each time a snapshot is replaced
+  mutable std::atomic<std::uint64_t> epoch_{ 1 };
+
+  //! The readers' epochs
+  mutable ReaderSlot readers_[MAX_READERS];
+
+  //! Serialises the writers
+  mutable std::mutex write_mutex_;
+
+  //! The replaced snapshots waiting to be freed
+  std::vector<Retired> retired_;
+};
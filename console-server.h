@@ -0,0 +1,142 @@
+/*
+ * File: console-server.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// test-console includes
+#include <console.h>
+
+// STL includes
+#include <string>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+/*!
+ * Runs many console sessions at once, for operators connecting over TCP or
+ * through a pty, on a small pool of worker threads. Each session is a
+ * TestConsole that's handed what arrives on its connection and sends what it
+ * writes, so a session only costs its line, history and buffers: the commands
+ * (and the command trie and argument values in them) are in one registry that
+ * every session shares.
+ *
+ * Each worker waits on its own epoll set and owns the sessions it accepted,
+ * so a session is only ever touched by one thread and needs no locks. The
+ * listening sockets are in every worker's set, and the kernel wakes one of
+ * them for each new connection. Messages posted to a session from other
+ * threads (e.g. by background commands) wake its worker through an eventfd.
+ *
+ * Connections are read and written without blocking: anything a slow client
+ * hasn't taken yet waits in the session (up to a limit, then the session is
+ * closed). A session ends when its operator disconnects or types 'quit'.
+ *
+ * \note The server uses epoll, so it's only built for Linux
+ */
+class ConsoleServer
+{
+public:
+
+  //! The most output a session can have waiting for a slow client, before it's closed
+  static constexpr std::size_t MAX_PENDING_OUTPUT = 1 << 20;
+
+  /*!
+   * Start the worker threads. There are no sessions until listen() or openPty() is called
+   * \param prompt The prompt each session shows
+   * \param commands The commands, shared by all the sessions. They can be added and removed while the server is running
+   * \param n_workers The number of worker threads (at least 1)
+   * \throws std::runtime_error The workers couldn't be set up
+   */
+  ConsoleServer(const std::string& prompt, std::shared_ptr<CommandRegistry> commands, unsigned int n_workers);
+
+  /*!
+   * Stop the server, closing all the sessions
+   */
+  ~ConsoleServer();
+
+  /*!
+   * Accept connections on a TCP port
+   * \param port The port, or 0 to pick a free one
+   * \param address The IPv4 address to listen on (the default only takes connections from this machine)
+   * \param telnet Whether to ask telnet clients to send each key as it's pressed and leave the echo to us.
+   *               Without it, clients must already do that (e.g. socat with a raw terminal)
+   * \return The port being listened on
+   * \throws std::runtime_error The port couldn't be listened on
+   */
+  std::uint16_t listen(std::uint16_t port, const std::string& address = "127.0.0.1", bool telnet = true);
+
+  /*!
+   * Open a session on a new pty, for an operator to attach to with a terminal program (e.g. screen or picocom)
+   * \brief The session lasts until the operator types 'quit' or the server stops, so operators can
+   *        detach and come back to it
+   * \return The path of the pty (e.g. /dev/pts/3)
+   * \throws std::runtime_error The pty couldn't be opened
+   */
+  std::string openPty();
+
+  /*!
+   * Stop the workers and close all the sessions. The server can't be started again
+   */
+  void stop();
+
+  /*!
+   * Get the number of sessions running
+   * \return The number of sessions
+   */
+  std::size_t sessionCount() const { return n_sessions_.load(std::memory_order_relaxed); }
+
+private:
+
+  //! A worker thread and the sessions it runs (defined with the platform code)
+  struct Worker;
+
+  //! One operator's session (defined with the platform code)
+  struct Session;
+
+  //! The prompt each session shows
+  std::string prompt_;
+
+  //! The commands every session shares
+  std::shared_ptr<CommandRegistry> commands_;
+
+  //! The workers
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  //! The listening sockets
+  std::vector<int> listeners_;
+
+  //! Which worker gets the next pty session
+  std::atomic<std::size_t> next_worker_{ 0 };
+
+  //! The number of sessions running
+  std::atomic<std::size_t> n_sessions_{ 0 };
+
+  //! Whether stop() has been called
+  std::atomic<bool> stopped_{ false };
+};
@@ -27,49 +27,239 @@
 
 // test-console includes
 #include "console.h"
+#include <utf8.h>
 
 // STL includes
-#include <iostream>
 #include <exception>
 #include <tuple>
+#include <iterator>
+#include <string_view>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
 
 namespace
 {
+  // Make the set of valid characters for our commands: letters, digits, '-' and
+  // '_', and the bytes of non-ASCII UTF-8 characters (e.g. for host names)
+  std::string commandChars()
+  {
+    std::string chars = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_";
+    for (int c = 128; c <= 255; ++c)
+      chars += static_cast<char>(c);
+    return chars;
+  }
+
   //! The set of valid characters for our commands
-  const std::string VALID_COMM_CHARS = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_";
+  const std::string VALID_COMM_CHARS = commandChars();
+
+  //! The most commands to list for each double <Tab> press
+  const std::size_t COMPLETION_PAGE_SIZE = 40;
+
+  // Make a handler for a command that just prints a message
+  ConsoleCommandHandler reply(std::string text)
+  {
+    return [text = std::move(text)](TestConsole&, std::string_view, OutputBuffer& out) { out << text << "\r\n"; };
+  }
 }
 
 // Construct the console
 TestConsole::TestConsole(const std::string& prompt) : 
   prompt_{ prompt },
-  completion_trie_(VALID_COMM_CHARS)
+  registry_{ makeCommands() },
+  completion_mode_{ CompletionMode::prefix },
+  idle_timeout_ms_{ -1 },
+  background_{ std::make_shared<BackgroundLink>(this) }
 {
   initialisePlatformVariables();  
-  
-  // Set up some commands - the key is the command name and the value is a string
-  // that's printed when the command is called
-  commands_["hello"] = "Hello! How are you?";
-  commands_["help"] = "Sorry. I can't help you!";
-  commands_["apple"] = "Banana!";
-  commands_["append"] = "Did you mean upend?\r\n \\/\r\n-[]-\r\n ()";
-  commands_["quit"] = "Thanks for dropping by!";
-  commands_["quick"] = "I'm going as fast as I can!";
-  commands_["sugar"] = "Hi, honey!";
-  commands_["send"] = "Received!";
-  commands_["snooze"] = "Zzzzzzzzzzzz...";
-  commands_["point"] = "It's rude to point!";
-  commands_["change"] = "Change is good - what would you like to change?";
-  commands_["challenge"] = "Created in 1990, what was the name of the first internet search engine?";
-  commands_["ping"] = "Pong";
-  commands_["ring"] = "Who ya gonna call?";
-  commands_["xray"] = "You saw right through me!";
-
-  // Add the commands to the auto completion trie
-  for (auto &c : commands_)
-    completion_trie_.insert(c.first);
-
-  // Add the special 'history' command
-  completion_trie_.insert("history");
+}
+
+// Construct a console for a session
+TestConsole::TestConsole(const std::string& prompt, std::shared_ptr<CommandRegistry> commands,
+  std::function<void()> wake) :
+  prompt_{ prompt },
+  registry_{ std::move(commands) },
+  session_{ std::make_unique<SessionIo>(std::move(wake)) },
+  completion_mode_{ CompletionMode::prefix },
+  idle_timeout_ms_{ -1 },
+  background_{ std::make_shared<BackgroundLink>(this) }
+{
+}
+
+// Make the console's commands
+std::shared_ptr<CommandRegistry> TestConsole::makeCommands()
+{
+  auto registry = std::make_shared<CommandRegistry>(VALID_COMM_CHARS);
+
+  // Set up some commands - each one just prints a message. They're all added
+  // together at the end, so the trie is only copied once
+  std::vector<std::pair<std::string, ConsoleCommandHandler>> commands;
+  commands.emplace_back("hello", reply("Hello! How are you?"));
+  commands.emplace_back("help", reply("Sorry. I can't help you!"));
+  commands.emplace_back("apple", reply("Banana!"));
+  commands.emplace_back("append", reply("Did you mean upend?\r\n \\/\r\n-[]-\r\n ()"));
+  commands.emplace_back("quit", reply("Thanks for dropping by!"));
+  commands.emplace_back("quick", reply("I'm going as fast as I can!"));
+  commands.emplace_back("sugar", reply("Hi, honey!"));
+  commands.emplace_back("send", reply("Received!"));
+  commands.emplace_back("snooze", reply("Zzzzzzzzzzzz..."));
+  commands.emplace_back("point", reply("It's rude to point!"));
+  commands.emplace_back("change", reply("Change is good - what would you like to change?"));
+  commands.emplace_back("challenge", reply("Created in 1990, what was the name of the first internet search engine?"));
+  commands.emplace_back("ping", reply("Pong"));
+  commands.emplace_back("ring", reply("Who ya gonna call?"));
+  commands.emplace_back("xray", reply("You saw right through me!"));
+
+  // A command that takes a while, to show commands running in the background
+  commands.emplace_back("wait", backgroundCommand("wait", [](std::string args)
+  {
+    int seconds = std::atoi(args.c_str());
+    if (seconds <= 0)
+      seconds = 1;
+    return std::async(std::launch::async, [seconds]()
+    {
+      std::this_thread::sleep_for(std::chrono::seconds(seconds));
+      return "Waited for " + std::to_string(seconds) + (seconds == 1 ? " second" : " seconds");
+    });
+  }));
+
+  // Add the special 'history' command - not a fully featured
+  // history, but we can show what's in the list
+  commands.emplace_back("history", [](TestConsole& console, std::string_view, OutputBuffer& out)
+  {
+    const CommandHistory& history = console.history_;
+    for (std::size_t pos = history.begin(); pos != history.end(); pos = history.next(pos))
+      out << history[pos] << "\r\n";
+  });
+
+  // And 'stats', to show where the time goes when handling keys ('stats reset' starts again)
+  commands.emplace_back("stats", [](TestConsole& console, std::string_view args, OutputBuffer& out)
+  {
+    if (args == "reset")
+      console.stats_.clear();
+    else
+      console.stats_.print(out);
+  });
+  registry->add(std::move(commands));
+  registry->setArgument("stats", 0, std::make_unique<ArgumentValues>(std::vector<std::string>{ "reset" }));
+
+  // Complete 'ping' with node names from a (slow) provider, to show values that are fetched when needed
+  registry->setArgument("ping", 0, std::make_unique<ArgumentValues>([]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::vector<std::string> nodes;
+    for (int i = 1; i <= 200; ++i)
+      nodes.push_back("node-" + std::to_string(1000 + i).substr(1));
+    return nodes;
+  }, std::chrono::minutes(1)));
+  return registry;
+}
+
+// Clean up the console
+TestConsole::~TestConsole()
+{
+  // Background commands that are still running drop their results, rather than making us wait for them
+  {
+    std::lock_guard<std::mutex> lock(background_->mutex);
+    background_->console = nullptr;
+  }
+  if (!session_)
+    cleanUpConsole();
+}
+
+// Add a command
+void TestConsole::addCommand(const std::string& name, CommandHandler handler)
+{
+  registry_->add(name, std::move(handler));
+}
+
+// Add a command that needs its console
+void TestConsole::addCommand(const std::string& name, ConsoleCommandHandler handler)
+{
+  registry_->add(name, std::move(handler));
+}
+
+// Add a command that runs in the background
+void TestConsole::addAsyncCommand(const std::string& name, AsyncCommandHandler handler)
+{
+  registry_->add(name, backgroundCommand(name, std::move(handler)));
+}
+
+// Make the handler for a background command
+ConsoleCommandHandler TestConsole::backgroundCommand(const std::string& name, AsyncCommandHandler handler)
+{
+  return [name, handler = std::move(handler)](TestConsole& console, std::string_view args, OutputBuffer&)
+  {
+    console.runInBackground(name, handler(std::string(args)));
+  };
+}
+
+// Wait for a background command's result
+void TestConsole::runInBackground(const std::string& name, std::future<std::string> result)
+{
+  // The thread only holds the link, so it can carry on after the console's gone (and just drop the result)
+  {
+    std::lock_guard<std::mutex> lock(background_->mutex);
+    ++background_->running;
+  }
+  std::thread([link = background_, name, result = std::move(result)]() mutable
+  {
+    std::string message;
+    try
+    {
+      message = result.get();
+    }
+    catch (std::exception& e)
+    {
+      message = "Command '" + name + "' failed: " + e.what();
+    }
+
+    std::lock_guard<std::mutex> lock(link->mutex);
+    if (link->console && !message.empty())
+      link->console->post(std::move(message));
+    --link->running;
+  }).detach();
+}
+
+// Check for background commands that haven't finished
+bool TestConsole::hasBackgroundCommands() const
+{
+  std::lock_guard<std::mutex> lock(background_->mutex);
+  return background_->running > 0;
+}
+
+// Remove a command
+bool TestConsole::removeCommand(const std::string& name)
+{
+  return registry_->remove(name);
+}
+
+// Set fixed values for an argument
+void TestConsole::setArgumentValues(const std::string& command, std::size_t position,
+  const std::vector<std::string>& values)
+{
+  registry_->setArgument(command, position, std::make_unique<ArgumentValues>(values));
+}
+
+// Set an argument's values from a trie image
+void TestConsole::setArgumentImage(const std::string& command, std::size_t position, const std::string& path)
+{
+  auto trie = std::make_unique<CommandTrie>(CommandTrie::openImage(path));
+  registry_->setArgument(command, position, std::make_unique<ArgumentValues>(std::move(trie)));
+}
+
+// Get an argument's values from a provider
+void TestConsole::setArgumentProvider(const std::string& command, std::size_t position, ValueProvider provider,
+  std::chrono::milliseconds ttl)
+{
+  registry_->setArgument(command, position, std::make_unique<ArgumentValues>(std::move(provider), ttl));
+}
+
+// Choose how <Tab> completes commands
+void TestConsole::setCompletionMode(CompletionMode mode)
+{
+  completion_mode_ = mode;
 }
 
 // Start the console
@@ -81,275 +271,732 @@ int TestConsole::start()
   //       to do what we expect of \n normally
   try
   {
-    // Just echo the user's input until they type 'quit'
-    std::string input{ "" };
-    while (input != "quit")
+    // Run the user's commands until they type 'quit'
+    std::string command{ "" };
+    while (command != "quit")
     {
-      // Flush to make sure the prompt is shown
-      std::cout << prompt_ << " " << std::flush;
-      input = getUserInputLine();
+      // Write out the prompt (and anything the last command showed)
+      out_ << prompt_ << " ";
+      writeOutput();
+      std::string input = getUserInputLine();
 
-      // Not a fully featured history, but
-      // we can show what's in the list
-      if (input == "history")
-      {
-        for (auto &h : history_)
-          std::cout << h << "\r\n";
-      }
-      else
-      {
-        auto cmd = commands_.find(input);
-        if (cmd != commands_.end())
-          std::cout << cmd->second << "\r\n";
-        else if (input != "")
-          std::cout << "Command '" << input << "' not found.\r\n";
-      }
-
-      // Save the history if it's not the same as the previous entry
-      if (input != "" && (history_.empty() || input != history_.back()))
-        history_.push_back(input);
+      command = runCommand(input);
     }
+    writeOutput();
   }
   catch (std::exception& e)
   {
-    std::cout << "There was an error getting the user's input: " << e.what() << "\r\n";
+    out_ << "There was an error getting the user's input: " << e.what() << "\r\n";
+    writeOutput();
   }
  
   return 0;
 }
 
-// Get the user input line
-std::string TestConsole::getUserInputLine() const
+// Keep the history in a file
+void TestConsole::openHistory(const std::string& path, std::size_t max_entries)
 {
-  // The line the user is entering
-  std::string line{ "" };
+  history_.setMaxEntries(max_entries);
+  history_.open(path);
+  history_index_.clear();
+}
 
-  // Keep track of where the cursor is in the input line
-  std::string::size_type cursor_pos = 0;
+// Record the keys to a trace
+void TestConsole::recordKeys(const std::string& path)
+{
+  key_trace_.open(path);
+}
 
-  // The position we are in the history
-  std::size_t history_pos = history_.size();
+// Set the function to call while waiting for input
+void TestConsole::setIdleHandler(int timeout_ms, std::function<void()> handler)
+{
+  idle_timeout_ms_ = timeout_ms;
+  idle_handler_ = std::move(handler);
+}
 
-  // Keep the current line if we move through the history
-  std::string current_line{ "" };
+// Run a line as a command
+std::string TestConsole::runCommand(const std::string& input)
+{
+  // The command name is the first word, and anything after it is passed to the handler
+  auto name_start = std::min(input.find_first_not_of(' '), input.size());
+  auto name_end = std::min(input.find(' ', name_start), input.size());
+  std::string command = input.substr(name_start, name_end - name_start);
+  std::string_view args(input);
+  args.remove_prefix(std::min(input.find_first_not_of(' ', name_end), input.size()));
 
-  KeyPressed key_pressed = KeyPressed::undefined;
+  ConsoleCommandHandler handler = registry_->find(command);
+  if (handler)
+  {
+    handler(*this, args, out_);
+
+    // Rank the commands used most often first when listing completions
+    registry_->used(command);
+  }
+  else if (!command.empty())
+    out_ << "Command '" << command << "' not found.\r\n";
+
+  // Save the history if it's not the same as the previous entry
+  history_.add(input);
+  history_index_.update(history_);
+  return command;
+}
 
-  // Allow detection of two tab presses to show list of commands
-  bool tab_pressed = false;
+// Handle whatever input is ready, without waiting
+std::vector<std::string> TestConsole::processPendingInput()
+{
+  std::vector<std::string> lines;
+  if (!editing_)
+  {
+    out_ << prompt_ << " ";
+    beginLine();
+  }
+
+  if (keys_.empty())
+    readKeys(0);
+  showMessages();
 
-  while (key_pressed != KeyPressed::enter)
+  // Each line finished runs as a command before the keys after it start the next line
+  std::string line;
+  while (processKeys(keys_, line))
   {
-    std::vector<std::tuple<KeyPressed, char>> keys = getKeyPresses();
-    for (auto &k : keys)
+    runCommand(line);
+    lines.push_back(std::move(line));
+    out_ << prompt_ << " ";
+    beginLine();
+  }
+  flushKeys();
+  return lines;
+}
+
+// Post a message to show above the prompt
+void TestConsole::post(std::string message)
+{
+  messages_.push(std::move(message));
+
+  // Only the first message since the console last looked needs to wake it
+  if (!wake_pending_.exchange(true, std::memory_order_acq_rel))
+  {
+    if (session_)
+      session_->wake();
+    else
+      wakeConsole();
+  }
+}
+
+// Show the messages other threads have posted
+bool TestConsole::showMessages()
+{
+  // Clear the flag first, so a message posted while we're here wakes us again
+  wake_pending_.store(false, std::memory_order_release);
+
+  std::string message;
+  if (!messages_.pop(message))
+    return false;
+
+  // Take the prompt and line off the screen, and put them back after the messages
+  renderer_.erase(out_);
+  do
+  {
+    // The terminal doesn't turn a new line into \r\n for us
+    for (std::string::size_type i = 0; i < message.size(); ++i)
     {
-      key_pressed = std::get<0>(k);
+      if (message[i] == '\n' && (i == 0 || message[i - 1] != '\r'))
+        out_ << '\r';
+      out_ << message[i];
+    }
+    if (message.empty() || message.back() != '\n')
+      out_ << "\r\n";
+  } while (messages_.pop(message));
+
+  if (editing_)
+  {
+    out_ << prompt_ << " ";
+    resetRenderer(displayWidth(prompt_) + 1);
+  }
+  return true;
+}
+
+// Get how long the caller can wait before processPendingInput() needs calling
+int TestConsole::inputTimeout() const
+{
+  if (!keys_.empty())
+    return 0;
+  return session_ ? session_->waitLimit() : inputWaitLimit();
+}
+
+// Get ready to edit a new line
+void TestConsole::beginLine()
+{
+  line_.clear();
+  history_pos_ = history_.end();
+  current_line_.clear();
+  tab_pressed_ = false;
+  n_listed_ = 0;
+  editing_ = true;
+
+  // The prompt has just been shown, so there's nothing on the line yet
+  resetRenderer(displayWidth(prompt_) + 1);
+}
+
+// Start rendering a line after a prompt
+void TestConsole::resetRenderer(std::size_t prompt_width)
+{
+  // A session doesn't know the size of the operator's terminal, so its lines are treated as one row
+  renderer_.reset(prompt_width, session_ ? 0 : terminalWidth());
+}
 
-      // Enter stops processing as it indicates the user is done
-      if (key_pressed == KeyPressed::enter)
+// Get the user input line
+std::string TestConsole::getUserInputLine()
+{
+  beginLine();
+
+  std::string line;
+  while (true)
+  {
+    // Use up any keys left over from the last line before reading more
+    if (keys_.empty())
+      readKeys(idle_handler_ ? idle_timeout_ms_ : -1);
+
+    // Show anything other threads have posted, then if nothing arrived
+    // before the timeout, let the embedding program do some work
+    bool shown = showMessages();
+    if (keys_.empty() && !shown && idle_handler_)
+      idle_handler_();
+
+    bool done = processKeys(keys_, line);
+    flushKeys();
+    if (done)
+      return line;
+  }
+}
+
+// Read the next keys
+void TestConsole::readKeys(int timeout_ms)
+{
+  // A session is handed its input, so there's never anything to wait for
+  KeyBuffer& keys = key_trace_.isOpen() ? recorded_keys_ : keys_;
+  if (session_)
+  {
+    // Time the decoding the way the platforms do, so a session's keys are counted too
+    auto decode_start = ConsoleStats::now();
+    std::size_t n_events = keys.size();
+    session_->getKeyPresses(keys);
+    if (keys.size() != n_events)
+      stats_.decoded(decode_start);
+  }
+  else
+    getKeyPresses(keys, timeout_ms);
+  if (!key_trace_.isOpen())
+    return;
+
+  // This read was kept apart so we record exactly what it got
+  key_trace_.write(recorded_keys_);
+  keys_.append(recorded_keys_);
+}
+
+// Flush the output from handling keys
+void TestConsole::flushKeys()
+{
+  std::size_t n_bytes = out_.size();
+  auto flush_start = ConsoleStats::now();
+  writeOutput();
+  stats_.record(ConsoleStats::Stage::flush, flush_start);
+  stats_.echoed(n_bytes);
+}
+
+// Write out the output buffer
+void TestConsole::writeOutput()
+{
+  if (session_)
+    session_->send(out_);
+  else
+    flushOutput();
+}
+
+// Hand over what arrived on a session's connection
+void TestConsole::receive(const char* data, std::size_t n_bytes)
+{
+  session_->receive(data, n_bytes);
+}
+
+// Get what a session has to send
+std::string& TestConsole::output()
+{
+  return session_->output();
+}
+
+// Apply a batch of key presses to the line
+bool TestConsole::processKeys(KeyBuffer& keys, std::string& completed_line)
+{
+  auto edit_start = ConsoleStats::now();
+  std::size_t n_keys = 0;
+  KeyPressed key_pressed = KeyPressed::undefined;
+  for (; !keys.empty(); keys.pop())
+  {
+    KeyEvent& k = keys.front();
+    key_pressed = k.key;
+    n_keys += k.repeat;
+
+    // While searching the history, most keys change the search rather than the line
+    if (history_search_.active() && searchHistory(k))
+      continue;
+
+    // A paste containing a new line finishes this line, and the rest of it
+    // is left in the buffer to start the next line
+    bool rest_of_paste = false;
+    if (key_pressed == KeyPressed::paste)
+    {
+      std::string_view text = keys.text(k);
+      auto eol = text.find_first_of("\r\n");
+      if (eol != std::string_view::npos)
       {
-        // On Linux, we need to use both \r and \n
-        // because of the terminal setting.
-        // It will also work on the Windows version
-        std::cout << "\r\n";
-        break;
+        auto next = text.find_first_not_of("\r\n", eol);
+        pasteText(text.substr(0, eol));
+        if (next != std::string_view::npos)
+        {
+          keys.consumeText(next);
+          rest_of_paste = true;
+        }
+        key_pressed = KeyPressed::enter;
       }
+    }
+
+    // Enter stops processing as it indicates the user is done
+    if (key_pressed == KeyPressed::enter)
+    {
+      // On Linux, we need to use both \r and \n
+      // because of the terminal setting.
+      // It will also work on the Windows version
+      stats_.record(ConsoleStats::Stage::edit, edit_start);
+      auto render_start = ConsoleStats::now();
+      renderer_.render(line_, out_);
+      renderer_.finishLine(out_);
+      stats_.record(ConsoleStats::Stage::render, render_start);
+      stats_.handled(n_keys);
+
+      // Keep anything typed after <Enter> for the next line
+      if (!rest_of_paste)
+        keys.pop();
+      completed_line = line_.str();
+      editing_ = false;
+      return true;
+    }
 
-      // If we've got a printable char, print it and add to string
-      switch (key_pressed)
+    // Each key just changes the line and the cursor - the renderer
+    // works out what to show once the whole batch has been handled
+    switch (key_pressed)
+    {
+    case KeyPressed::alphanum:
+      // Insert the char where the cursor is (as many times as it was pressed)
+      line_.insert(k.c, k.repeat);
+      break;
+    case KeyPressed::backspace:
+      // We can't delete if there's nothing there
+      if (line_.eraseBefore(k.repeat) < k.repeat)
+        out_ << '\a'; // Sound a bell as backspace is invalid
+      break;
+    case KeyPressed::leftarrow:
+    case KeyPressed::rightarrow:
       {
-      case KeyPressed::alphanum:
+        // Move a whole character at a time, and beep if we ran out of line
+        std::size_t pos = line_.cursor();
+        for (std::uint32_t n = 0; n < k.repeat; ++n)
         {
-        // Get the char and print it
-          char c = std::get<1>(k);
-          std::cout << c;
-
-          // If we're not at the end of the string, print out the rest of
-          // the string and insert the char in the right place
-          if (cursor_pos != line.size())
+          std::size_t next = key_pressed == KeyPressed::leftarrow ? line_.previousChar(pos) : line_.nextChar(pos);
+          if (next == pos)
           {
-            std::cout << line.substr(cursor_pos);
-            line.insert(cursor_pos, 1, c);
-
-            // Move the cursor back to where it was
-            std::cout << std::string(line.size() - (cursor_pos+1), '\b');
+            out_ << '\a';
+            break;
           }
-          else  // If we are at the end, just add the char
-            line += c;
-          ++cursor_pos; 
-          break;
+          pos = next;
         }
-      case KeyPressed::backspace:
-        // We can't delete if there's nothing there
-        if (!line.empty() && cursor_pos != 0)
+        line_.moveCursor(pos);
+      }
+      break;
+    case KeyPressed::home:
+      line_.moveCursor(0);
+      break;
+    case KeyPressed::end:
+      line_.moveCursor(line_.size());
+      break;
+    case KeyPressed::wordleft:
+    case KeyPressed::wordright:
+      {
+        // Move a word at a time, and beep if we ran out of words
+        std::size_t pos = line_.cursor();
+        for (std::uint32_t n = 0; n < k.repeat; ++n)
         {
-          // If the cursor is in the middle of the line, it's more complicated!
-          if (cursor_pos != line.size())
-          {
-            // Remove the char deleted from the display and line string
-            std::cout << "\b" << line.substr(cursor_pos) + " ";
-            line.erase(cursor_pos-1, 1);
-
-            // Move the cursor back one space (remembering the space we put on the end)
-            std::cout << std::string(line.size() - (cursor_pos-2), '\b');
-          }
-          else
+          std::size_t next = key_pressed == KeyPressed::wordleft ? line_.previousWord(pos) : line_.nextWord(pos);
+          if (next == pos)
           {
-            // Move back, erase the last character and move back again
-            // Also remove the last character of the line string
-            std::cout << "\b \b";
-            line.pop_back();
+            out_ << '\a';
+            break;
           }
-          --cursor_pos;
+          pos = next;
         }
-        else
-          std::cout << "\a"; // Sound a bell as backspace is invalid
-        break;
-      case KeyPressed::leftarrow:
-        if (cursor_pos > 0)
+        line_.moveCursor(pos);
+      }
+      break;
+    case KeyPressed::pageup:
+      // Jump to the oldest history entry
+      if (history_pos_ != history_.begin())
+      {
+        if (history_pos_ == history_.end())
+          current_line_ = line_.str();
+        history_pos_ = history_.begin();
+        line_.assign(history_[history_pos_]);
+      }
+      else
+        out_ << '\a';
+      break;
+    case KeyPressed::pagedown:
+      // Jump back to the line that was being typed before moving through the history
+      if (history_pos_ != history_.end())
+      {
+        history_pos_ = history_.end();
+        line_.assign(current_line_);
+      }
+      else
+        out_ << '\a';
+      break;
+    case KeyPressed::uparrow:
+      {
+        // If we're not already in the history, save the current line
+        if (history_pos_ == history_.end())
+          current_line_ = line_.str();
+
+        // Move back through the history, but not past the top (or a damaged entry, which becomes the top)
+        std::uint32_t n = 0;
+        for (; n < k.repeat && history_pos_ != history_.begin(); ++n)
         {
-          // Move the cursor backwards
-          std::cout << "\b";
-          --cursor_pos;
+          std::size_t pos = history_.previous(history_pos_);
+          if (pos == history_pos_)
+            break;
+          history_pos_ = pos;
         }
-        else
-          std::cout << "\a"; // Sound a bell as left arrow can't move further back
-        break;
-      case KeyPressed::rightarrow:
-        // Check the cursor is not at the end
-        if (cursor_pos != line.size())
+        if (n > 0)
+          line_.assign(history_[history_pos_]);
+        if (n < k.repeat)
+          out_ << '\a';  // If we're at the beginning of the history, just beep
+      }
+      break;
+    case KeyPressed::downarrow:
+      {
+        // Move forward through the history, but not past the end
+        std::uint32_t n = 0;
+        for (; n < k.repeat && history_pos_ != history_.end(); ++n)
+          history_pos_ = history_.next(history_pos_);
+        if (n > 0)
         {
-          // Output the character at the current position to move the cursor forward
-          std::cout << line[cursor_pos];
-          ++cursor_pos;
+          if (history_pos_ == history_.end())
+            line_.assign(current_line_);
+          else
+            line_.assign(history_[history_pos_]);
         }
-        else
-          std::cout << "\a";
-        break;
-      case KeyPressed::uparrow:
-        // If we're not already in the history, save the current line
-        if (history_pos == history_.size())
-          current_line = line;
+        if (n < k.repeat)
+          out_ << '\a'; // If we're at the end of the history, just beep
+      }
+      break;
+    case KeyPressed::del:
+      // Check we're not at the end of the string, and remove the characters if we're not
+      if (line_.eraseAfter(k.repeat) < k.repeat)
+        out_ << '\a';
+      break;
+    case KeyPressed::tab:
+      {
+        // Get what we can complete. If nothing starts with the line and we're doing
+        // fuzzy completion, we look for commands containing its characters instead
+        std::string line = line_.str();
 
-        // Check we're not at the top of the history
-        if (history_pos != 0)
+        // Once there's a space after the command name, we complete its arguments instead
+        std::size_t name_start = line.find_first_not_of(' ');
+        if (name_start != std::string::npos && line.find(' ', name_start) != std::string::npos)
         {
-          // Move to the previous history place
-          --history_pos;
-
-          std::string new_line = history_[history_pos];
-          replaceLine(line.size(), new_line, cursor_pos);
-          line = new_line;
-          cursor_pos = line.size();
+          completeArgument(line);
+          break;
         }
-        else 
-          std::cout << '\a';  // If we're at the beginning of the history, just beep
-        break;
-      case KeyPressed::downarrow:
-        // Check we're not already at the endo of the history
-        if (history_pos != history_.size())
+
+        // Other threads can change the commands, so search one snapshot of them. The cursor
+        // notices if it was moved through an older one, and starts again
+        auto completion_start = ConsoleStats::now();
+        auto commands = registry_->trie().snapshot();
+        commands->moveCursor(completion_cursor_, line);
+        commands->find(completion_cursor_, completion_matches_);
+        stats_.record(ConsoleStats::Stage::completion, completion_start);
+        std::size_t n_paths = completion_matches_.paths();
+        // Commands can share the first bytes of a character, so only complete whole characters
+        std::string_view completion = completion_matches_.completion();
+        completion = completion.substr(0, completeUtf8Length(completion));
+        bool use_fuzzy = completion_mode_ == CompletionMode::fuzzy && completion_matches_.total() == 0 &&
+          !line.empty();
+
+        // If this was a double tab, show the next page of available commands, with the best first
+        if (tab_pressed_)
         {
-          ++history_pos;
-          std::string new_line;
-          if (history_pos == history_.size())
-            new_line = current_line;
+          std::string no_matches = "No commands match '" + line + "' for tab completion";
+          if (use_fuzzy)
+          {
+            registry_->findFuzzy(line, fuzzy_matches_, n_listed_, COMPLETION_PAGE_SIZE);
+            listMatches(fuzzy_matches_, no_matches);
+          }
           else
-            new_line = history_[history_pos];
-          replaceLine(line.size(), new_line, cursor_pos);
-          line = new_line;
-          cursor_pos = line.size();
+          {
+            commands->findRanked(completion_cursor_, completion_matches_, n_listed_, COMPLETION_PAGE_SIZE);
+            listMatches(completion_matches_, no_matches);
+          }
         }
-        else
-          std::cout << '\a'; // If we're at the end of the history, just beep
-        break;
-      case KeyPressed::del:
-        // Check we're not at the end of the string
-        if (cursor_pos != line.size())
+        else if (use_fuzzy)
         {
-          // Remove the character from the line, and output the rest of the rest
-          // of the string to remove the character, then move the cursor back to
-          // where it was
-          line.erase(cursor_pos, 1);
-          std::cout << line.substr(cursor_pos) << " " 
-            << std::string(line.size() - (cursor_pos - 1), '\b');
+          // Only complete a fuzzy match if it's the only one - otherwise the user
+          // can press <Tab> again to choose
+          registry_->findFuzzy(line, fuzzy_matches_, 0, 1);
+          if (fuzzy_matches_.total() == 1)
+          {
+            line_.assign(fuzzy_matches_[0]);
+          }
+          else
+          {
+            out_ << '\a';
+            tab_pressed_ = true;
+          }
         }
         else
-          std::cout << "\a";
-        break;
-      case KeyPressed::tab:
         {
-          // Get what we can complete - if this is the second tab press, show available
-          // commands
-          auto [n_paths, completion, all_cmds] = completion_trie_.find(line, tab_pressed);
-
-          // If this was a double tab, show the commands
-          if (tab_pressed)
+          // Check the partial command exists in the trie and if it does,
+          // show it. Otherwise, sound a bell
+          // If the completion is the same as the line, then it's too ambiguous to
+          // add anything
+          if (n_paths > 0 && completion != line)
           {
-            std::cout << "\r\n";
-            if (all_cmds.empty())
-              std::cout << "No commands match '" << line << "' for tab completion\r\n";
-            else
-            {
-              for (auto c : all_cmds)
-                std::cout << c << "\r\n";
-            }
-            tab_pressed = false;
-            std::cout << prompt_ << " " << line;
+            line_.assign(completion);
           }
           else
           {
-            // Check the partial command exists in the trie and if it does,
-            // show it. Otherwise, sound a bell
-            // If the completion is the same as the line, then it's too ambiguous to
-            // add anything
-            if (n_paths > 0 && completion != line)
-            {
-              replaceLine(line.size(), completion, cursor_pos);
-              line = completion;
-              cursor_pos = line.size();
-            }
-            else
-            {
-              std::cout << "\a";
-              tab_pressed = true; // Only mark as pressed if we did no completion
-            }
+            out_ << '\a';
+            tab_pressed_ = true; // Only mark as pressed if we did no completion
           }
-          break;
         }
-      case KeyPressed::error:
-        throw std::runtime_error("There was an error when processing key inputs");
         break;
-      default: // Anything else, we can just ignore!
+      }
+    case KeyPressed::paste:
+      pasteText(keys.text(k));
+      break;
+    case KeyPressed::error:
+      throw std::runtime_error("There was an error when processing key inputs");
+      break;
+    case KeyPressed::search:
+      // Start searching back through the history
+      history_search_.start();
+      break;
+    default: // Anything else, we can just ignore!
+      break;
+    }
+    
+    // Clear the tab press if the user did anything else
+    if (key_pressed != KeyPressed::tab)
+    {
+      tab_pressed_ = false;
+      n_listed_ = 0;
+    }
+  }
+
+  // Show everything we've done for this batch of keys in one go
+  stats_.record(ConsoleStats::Stage::edit, edit_start);
+  auto render_start = ConsoleStats::now();
+  if (history_search_.active())
+    showHistorySearch();
+  else
+    renderer_.render(line_, out_);
+  stats_.record(ConsoleStats::Stage::render, render_start);
+  stats_.handled(n_keys);
+  return false;
+}
+
+// Handle a key press while searching the history
+bool TestConsole::searchHistory(const KeyEvent& k)
+{
+  switch (k.key)
+  {
+  case KeyPressed::alphanum:
+    for (std::uint32_t n = 0; n < k.repeat; ++n)
+      history_search_.push(k.c, history_, history_index_);
+    if (!history_search_.found())
+      out_ << '\a';
+    return true;
+  case KeyPressed::backspace:
+    for (std::uint32_t n = 0; n < k.repeat; ++n)
+    {
+      if (!history_search_.pop())
+      {
+        out_ << '\a';
         break;
       }
-      
-      // Clear the tab press if the user did anything else
-      if (key_pressed != KeyPressed::tab)
-        tab_pressed = false;
     }
+    return true;
+  case KeyPressed::search:
+    // Another <Ctrl-R> finds the next older match
+    if (!history_search_.older())
+      out_ << '\a';
+    return true;
+  case KeyPressed::cancel:
+    // Leave the line as it was before the search
+    history_search_.stop();
+    redrawPrompt();
+    return true;
+  default:
+    break;
+  }
 
-    // Make sure anything we've done is updated
-    std::cout << std::flush;
+  // Anything else uses the match, and is then handled as normal
+  std::string_view match = history_search_.match(history_);
+  if (!match.empty())
+    line_.assign(match);
+  history_search_.stop();
+  redrawPrompt();
+  return false;
+}
+
+// Show the history search in place of the prompt and line
+void TestConsole::showHistorySearch()
+{
+  std::string_view match = history_search_.match(history_);
+  const std::string& text = history_search_.text();
+
+  renderer_.erase(out_);
+  std::string prompt = !text.empty() && !history_search_.found() ? "(failed reverse-i-search)`" : "(reverse-i-search)`";
+  prompt.append(text).append("': ");
+  out_ << prompt;
+
+  // Put the cursor at the start of the matching text, as readline does
+  search_line_.assign(match);
+  auto found = match.find(text);
+  search_line_.moveCursor(found == std::string_view::npos ? match.size() : found);
+  resetRenderer(displayWidth(prompt));
+  renderer_.render(search_line_, out_);
+}
+
+// Clear the line and show the prompt again
+void TestConsole::redrawPrompt()
+{
+  renderer_.erase(out_);
+  out_ << prompt_ << " ";
+  resetRenderer(displayWidth(prompt_) + 1);
+}
+
+// Insert a block of pasted text at the cursor
+void TestConsole::pasteText(std::string_view text)
+{
+  // Only keep the printable characters - tabs are treated as spaces
+  std::string printable;
+  printable.reserve(text.size());
+  for (std::size_t pos = 0; pos < text.size();)
+  {
+    char c = text[pos];
+    if (static_cast<unsigned char>(c) >= 0x80)
+    {
+      // Keep whole UTF-8 characters, and drop anything that isn't valid
+      std::size_t length = 0;
+      decodeUtf8(text, pos, length);
+      if (length > 1)
+        printable.append(text, pos, length);
+      pos += length;
+      continue;
+    }
+    if (c >= 32 && c <= 126)
+      printable += c;
+    else if (c == '\t')
+      printable += ' ';
+    ++pos;
   }
-  return line;
+
+  // Insert the whole block in one go - it's shown with the rest of the batch
+  line_.insert(printable);
 }
 
-// Replace one line on the display with another
-void TestConsole::replaceLine(const std::string::size_type& old_line_size, const std::string& new_line,
-  const std::string::size_type& cur_pos) const
+// Complete the argument at the end of the line
+void TestConsole::completeArgument(const std::string& line)
 {
-  // Check if we need to clear part of the line
-  std::string spaces{ "" };
-  std::string back_spaces{ "" };
-  int diff = old_line_size - new_line.size();
-  if (diff > 0)
+  // Split the line like runCommand() does - the command name, the arguments
+  // before the one being typed, and the one being typed (after the last space)
+  std::size_t name_start = line.find_first_not_of(' ');
+  std::size_t name_end = line.find(' ', name_start);
+  std::string name = line.substr(name_start, name_end - name_start);
+  std::size_t word_start = line.rfind(' ') + 1;
+  std::string word = line.substr(word_start);
+  std::size_t position = 0;
+  for (std::size_t pos = line.find_first_not_of(' ', name_end); pos < word_start;
+    pos = line.find_first_not_of(' ', line.find(' ', pos)))
+  {
+    ++position;
+  }
+
+  // Values from a provider might not be here yet
+  std::shared_ptr<ArgumentValues> values = registry_->argument(name, position);
+  std::shared_ptr<const CommandTrie> trie = values ? values->trie() : nullptr;
+  if (trie)
   {
-    spaces = std::string(diff, ' ');
-    back_spaces = std::string(diff, '\b');
+    auto completion_start = ConsoleStats::now();
+    trie->find(word, argument_matches_);
+    stats_.record(ConsoleStats::Stage::completion, completion_start);
   }
 
-  // Move to the start of the line, and then overwrite the line,
-  // then move the cursor back over any spaces
-  std::cout << std::string(cur_pos, '\b') << new_line << spaces << back_spaces;
+  // A double tab shows the next page of values. Nothing records which values are used, so they're listed in order
+  if (tab_pressed_)
+  {
+    std::string no_matches;
+    if (!values)
+      no_matches = "There are no values to complete for argument " + std::to_string(position + 1) + " of '" + name + "'";
+    else if (!trie && !values->error().empty())
+      no_matches = "Couldn't get the values for '" + name + "': " + values->error();
+    else if (!trie)
+      no_matches = "Still getting the values for '" + name + "' - press <Tab> again in a moment";
+    else
+      no_matches = "No values match '" + word + "' for tab completion";
+
+    argument_matches_.clear();
+    if (trie)
+      trie->find(word, argument_matches_, true, n_listed_, COMPLETION_PAGE_SIZE);
+    listMatches(argument_matches_, no_matches);
+  }
+  else if (trie && argument_matches_.paths() > 0 &&
+    completeUtf8Length(argument_matches_.completion()) > word.size())
+  {
+    const std::string& completion = argument_matches_.completion();
+    line_.assign(line.substr(0, word_start) + completion.substr(0, completeUtf8Length(completion)));
+  }
+  else
+  {
+    out_ << '\a';
+    tab_pressed_ = true;
+  }
 }
 
+// List a page of matches under the line
+template <typename Matches>
+void TestConsole::listMatches(const Matches& matches, const std::string& no_matches)
+{
+  // Finish showing the line before we list under it
+  renderer_.render(line_, out_);
+  renderer_.finishLine(out_);
+  if (matches.total() == 0)
+    out_ << no_matches << "\r\n";
+  else
+  {
+    for (std::size_t i = 0; i < matches.size(); ++i)
+      out_ << matches[i] << "\r\n";
+  }
+
+  // If there are more to show, further tab presses show the next page
+  n_listed_ += matches.size();
+  if (n_listed_ < matches.total())
+    out_ << (matches.total() - n_listed_) << " more, press <Tab> again to see them\r\n";
+  else
+  {
+    tab_pressed_ = false;
+    n_listed_ = 0;
+  }
+
+  // Show the prompt again - the line is shown after it as a change from an empty line
+  out_ << prompt_ << " ";
+  resetRenderer(displayWidth(prompt_) + 1);
+}
@@ -29,28 +29,35 @@
 
 // Test console includes
 #include <console-platform.h>
-#include <trie.h>
+#include <command-registry.h>
+#include <output.h>
+#include <renderer.h>
+#include <line-buffer.h>
+#include <history.h>
+#include <history-index.h>
+#include <message-queue.h>
+#include <key-buffer.h>
+#include <key-trace.h>
+#include <stats.h>
+#include <session-io.h>
 
 // STL includes
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <vector>
-#include <map>
+#include <functional>
+#include <atomic>
+#include <future>
+#include <chrono>
+#include <memory>
+#include <mutex>
 
-//! Indicate the type of key press
-enum class KeyPressed
+//! How <Tab> completes commands
+enum class CompletionMode
 {
-  alphanum,    /*!< A printable character was typed */
-  enter,       /*!< Enter (or related key) was pressed */
-  backspace,   /*!< Backspace was pressed */
-  del,         /*!< The Delete (or Del) key was pressed */
-  tab,         /*!< The Tab key was pressed */
-  leftarrow,   /*!< The left arrow key was pressed */
-  rightarrow,  /*!< The right arrow key was pressed */
-  uparrow,     /*!< The up arrow key was pressed */
-  downarrow,   /*!< The down arrow key was pressed */
-  undefined,   /*!< The key press was not something we handle */
-  error        /*!< If there is a problem with the key reader */
+  prefix,  /*!< Only complete commands that start with what's been typed */
+  fuzzy    /*!< If no commands start with what's been typed, match it as a subsequence (e.g. 'cdrain' finds 'cluster-node-drain') */
 };
 
 class TestConsole
@@ -58,14 +65,32 @@ class TestConsole
 public:
 
   /*!The test console constructor
+   * \brief The console uses the process's own terminal, with its own set of commands
    * \param prompt takes the string to show as the console prompt
    */
   TestConsole(const std::string& prompt);
 
+  /*! Create a console for a session, which doesn't use the process's terminal
+   * \brief Whoever runs the session hands over what arrives on its connection with receive(), calls
+   *        processPendingInput(), and sends what's in output(). The commands are shared with
+   *        the other sessions, so one that's added or removed is added or removed for all of them
+   * \param prompt The string to show as the console prompt
+   * \param commands The commands (e.g. from makeCommands())
+   * \param wake Called (from any thread) when a message is posted, so processPendingInput() gets called to show it
+   */
+  TestConsole(const std::string& prompt, std::shared_ptr<CommandRegistry> commands, std::function<void()> wake);
+
+  /*! Make a registry with the console's commands, for sessions to share
+   * \brief These are the built-in commands (e.g. 'history' and 'stats', which work on the console they're
+   *        typed in) and the example ones, with the values for completing their arguments
+   * \return The commands
+   */
+  static std::shared_ptr<CommandRegistry> makeCommands();
+
   /*! The test console destructor
    * \brief Calls the platform dependent code to clean up 
    */
-  ~TestConsole() { cleanUpConsole(); };
+  ~TestConsole();
 
   /*! Start the console
    * \brief Starts the console, shows the prompt and waits for user input
@@ -73,6 +98,155 @@ public:
    */
   int start();
 
+  /*! Handle whatever input is ready, without waiting for more
+   * \brief For driving the console from another event loop instead of calling start(). Call this
+   *        when inputHandle() is readable (and after inputTimeout() if that isn't negative). The
+   *        prompt is shown on the first call
+   * \return The lines finished by the input, each of which has already been run as a command
+   */
+  std::vector<std::string> processPendingInput();
+
+  /*! Hand over what arrived on a session's connection
+   * \brief Call processPendingInput() afterwards to handle it
+   * \param data The bytes, which are decoded as terminal input
+   * \param n_bytes The number of bytes
+   * \note This is only for a console created for a session
+   */
+  void receive(const char* data, std::size_t n_bytes);
+
+  /*! Get what a session's console has to send on its connection
+   * \return The bytes. Whoever runs the session removes what it's sent from the start
+   * \note This is only for a console created for a session
+   */
+  std::string& output();
+
+  /*! Get the console's input, to wait on in another event loop
+   * \return The file descriptor (Linux) or handle (Windows) that becomes readable when there's input
+   * \note A session's console has no input of its own to wait on - see receive()
+   */
+  InputHandle inputHandle() const;
+
+  /*! Get what another event loop should wait on for messages posted from other threads
+   * \brief When this is readable (or signalled on Windows), call processPendingInput() to show the messages
+   * \return The file descriptor (Linux) or handle (Windows)
+   */
+  InputHandle messageHandle() const;
+
+  /*! Check if any commands are still running in the background
+   * \return True if a background command hasn't finished (and posted its result) yet
+   */
+  bool hasBackgroundCommands() const;
+
+  /*! Show a message above the line being edited
+   * \brief This can be called from any thread, and never waits for the console. The console shows
+   *        all the messages posted since it last looked in one go, then redraws the prompt and line
+   * \param message The message. A new line is added at the end if it doesn't have one
+   */
+  void post(std::string message);
+
+  /*! Get how long another event loop can wait before calling processPendingInput() with no new input
+   * \brief This isn't negative when we've got part of a key press (e.g. the <Esc> that starts an escape
+   *        sequence) and need to decide what it is if nothing else arrives
+   * \return The longest wait in milliseconds, or a negative value to wait only for input
+   */
+  int inputTimeout() const;
+
+  /*! Add a command
+   * \brief Commands can be added (or replaced) at any time, from any thread, and are available for <Tab>
+   *        completion straight away (in every console sharing the commands)
+   * \param name The command name, which can only use letters, digits, '-', '_' and non-ASCII UTF-8 characters
+   * \param handler The function to call when the command is entered
+   * \throws std::out_of_range The name includes invalid characters (or isn't valid UTF-8)
+   */
+  void addCommand(const std::string& name, CommandHandler handler);
+
+  /*! Add a command that needs the console it's typed in
+   * \brief The handler is given the console, which matters when the commands are shared by sessions
+   * \param name The command name, which can only use letters, digits, '-', '_' and non-ASCII UTF-8 characters
+   * \param handler The function to call when the command is entered
+   * \throws std::out_of_range The name includes invalid characters (or isn't valid UTF-8)
+   */
+  void addCommand(const std::string& name, ConsoleCommandHandler handler);
+
+  /*! Add a command that runs in the background
+   * \brief The handler should start the work (e.g. with std::async) and return straight away, so the
+   *        user can carry on typing. Several commands can run at once, and each one's output is shown
+   *        above the prompt when it's ready. A handler can also post() progress messages as it goes.
+   *        Closing the console doesn't wait for commands that are still running: their results are
+   *        dropped when they arrive, so work the handler started must not post() to the console itself
+   *        once it might have gone
+   * \param name The command name, which can only use letters, digits, '-', '_' and non-ASCII UTF-8 characters
+   * \param handler The function to call when the command is entered
+   * \throws std::out_of_range The name includes invalid characters
+   */
+  void addAsyncCommand(const std::string& name, AsyncCommandHandler handler);
+
+  /*! Remove a command
+   * \param name The command name
+   * \return True if there was a command with that name
+   */
+  bool removeCommand(const std::string& name);
+
+  /*! Set the values one of a command's arguments can take, for <Tab> completion
+   * \param command The command name
+   * \param position Which argument it is (0 for the first after the command name)
+   * \param values The values. Any that include spaces or characters that can't be shown are left out
+   * \throws std::out_of_range There's no such command
+   */
+  void setArgumentValues(const std::string& command, std::size_t position, const std::vector<std::string>& values);
+
+  /*! Set the values one of a command's arguments can take from a trie image, for <Tab> completion
+   * \brief The image is mapped and searched in place, so even a big catalogue of values is ready
+   *        straight away. Images are made with CommandTrie::saveImage() (see make-trie-image)
+   * \param command The command name
+   * \param position Which argument it is (0 for the first after the command name)
+   * \param path The path of the image
+   * \throws std::out_of_range There's no such command
+   * \throws std::runtime_error The image couldn't be opened
+   */
+  void setArgumentImage(const std::string& command, std::size_t position, const std::string& path);
+
+  /*! Get the values one of a command's arguments can take from a provider, for <Tab> completion
+   * \brief The provider isn't called until the argument is first completed, and runs in the background so
+   *        typing never waits for it. Its values are kept for the time to live, then fetched again the
+   *        next time they're needed (the old values are used until the new ones are ready)
+   * \param command The command name
+   * \param position Which argument it is (0 for the first after the command name)
+   * \param provider The function that gets the values
+   * \param ttl How long to keep the values before getting them again
+   * \throws std::out_of_range There's no such command
+   */
+  void setArgumentProvider(const std::string& command, std::size_t position, ValueProvider provider,
+    std::chrono::milliseconds ttl);
+
+  /*! Keep the command history in a file
+   * \brief The history in the file is available straight away, and new commands are added to it.
+   *        The file is mapped rather than read, so a big history doesn't slow down starting the console
+   * \param path The path of the history file, which is created if it doesn't exist
+   * \param max_entries The most commands to keep in the history (the oldest are dropped first)
+   */
+  void openHistory(const std::string& path, std::size_t max_entries = CommandHistory::DEFAULT_MAX_ENTRIES);
+
+  /*! Record every key read from now on to a trace file, so the session can be replayed later
+   * \brief The trace can be replayed by the replay platform (see the README)
+   * \param path The path of the trace file, which is replaced if it already exists
+   * \throws std::runtime_error The file couldn't be created
+   */
+  void recordKeys(const std::string& path);
+
+  /*! Set a function to call while the console is waiting for input
+   * \brief Allows the embedding program to do other work between key presses
+   * \param timeout_ms How long (in milliseconds) to wait for a key press before calling the handler.
+   *                   A negative value waits forever (the default)
+   * \param handler The function to call each time the timeout expires with no input
+   */
+  void setIdleHandler(int timeout_ms, std::function<void()> handler);
+
+  /*! Choose how <Tab> completes commands
+   * \param mode The completion mode (the default is CompletionMode::prefix)
+   */
+  void setCompletionMode(CompletionMode mode);
+
 private:
   /*! Initialise the platform specific variables for this class
    * /throws std::runtime_error There was a problem initialising the platform's console 
@@ -84,22 +258,125 @@ private:
    * \return The line entered by the user at the command line
    * \throws std::runtime_error If there is a problem with the input processing
    */
-  std::string getUserInputLine() const;
+  std::string getUserInputLine();
+
+  /*! Run a line as a command, and add it to the history
+   * \param input The line
+   * \return The name of the command (which may not exist)
+   */
+  std::string runCommand(const std::string& input);
+
+  /*! Get ready to edit a new line, after the prompt has been shown
+   */
+  void beginLine();
+
+  /*! Forget what the renderer has shown, as a prompt has just been written
+   * \param prompt_width The number of columns the prompt takes up (including any space after it)
+   */
+  void resetRenderer(std::size_t prompt_width);
+
+  /*! Apply a batch of key presses to the line being edited
+   * \param keys The key presses. The ones used are removed, so any left are for the next line
+   * \retval completed_line Set to the line if it was finished
+   * \return True if <Enter> finished the line - any keys after it are kept for the next line
+   */
+  bool processKeys(KeyBuffer& keys, std::string& completed_line);
+
+  /*! Make the handler for a command that runs in the background
+   * \param name The command name, for reporting errors
+   * \param handler The function that starts the command
+   * \return The handler, which waits for the result in the console the command was typed in
+   */
+  static ConsoleCommandHandler backgroundCommand(const std::string& name, AsyncCommandHandler handler);
+
+  /*! Write out what's in the output buffer, to the terminal or the session
+   */
+  void writeOutput();
 
-  /*! Show a new line on the display
-   * \param old_line_size The length of the line we're replacing
-   * \param new_line The line to replace the existing line
-   * \param cur_pos The current position of the cursor in the line
+  /*! Wait for a command's result in the background, and post it when it arrives
+   * \param name The command name, for reporting errors
+   * \param result The command's result
    */
-  void replaceLine(const std::string::size_type& old_line, const std::string& new_line,
-    const std::string::size_type& cur_pos) const;
+  void runInBackground(const std::string& name, std::future<std::string> result);
 
-  /*! Get the next keypress
-   * \returns A vector containing the key types and a char. If the key isn't alphanumeric, the char will be '\0'
+  /*! Show any posted messages, moving the line being edited below them
+   * \return True if there were any messages
+   */
+  bool showMessages();
+
+  /*! Wake the console if it's waiting for input, so it shows the posted messages
+   * \note This is called from other threads, so it mustn't touch anything but the wake up mechanism
+   */
+  void wakeConsole();
+
+  /*! Get how long the platform code can wait for the rest of a partial key press
+   * \return The longest wait in milliseconds, or a negative value if there's nothing partial
+   */
+  int inputWaitLimit() const;
+
+  /*! Get the width of the terminal, so the renderer can follow a line onto the rows it wraps onto
+   * \return The number of columns, or 0 if it isn't known
+   */
+  std::size_t terminalWidth() const;
+
+  /*! Insert pasted text into the line being edited, at the cursor
+   * \param text The text that was pasted. Characters that can't be shown on the line are dropped
+   */
+  void pasteText(std::string_view text);
+
+  /*! Complete the argument being typed at the end of the line, for <Tab>
+   * \param line The line, which has a command name followed by a space
+   */
+  void completeArgument(const std::string& line);
+
+  /*! List a page of matches under the line, for a double <Tab>, then show the prompt again
+   * \param matches The matches (a page of them from a TrieMatches or FuzzyMatches)
+   * \param no_matches What to show if nothing matches
+   */
+  template <typename Matches>
+  void listMatches(const Matches& matches, const std::string& no_matches);
+
+  /*! Handle a key press while searching the history
+   * \param k The key press
+   * \return True if the search used the key. Otherwise the search has ended, with the
+   *         match copied to the line, and the key should be handled as normal
+   */
+  bool searchHistory(const KeyEvent& k);
+
+  /*! Show the history search and its current match in place of the prompt and line
+   */
+  void showHistorySearch();
+
+  /*! Clear the line and show the prompt with nothing after it
+   */
+  void redrawPrompt();
+
+  /*! Read the next keypresses into keys_, recording them if there's a trace open
+   * \param timeout_ms How long (in milliseconds) to wait for input. A negative value blocks until input arrives
+   */
+  void readKeys(int timeout_ms);
+
+  /*! Write out what handling the keys added to the output buffer, timing it for the statistics
+   * \throws std::runtime_error There was a problem writing to the console
+   */
+  void flushKeys();
+
+  /*! Get the next keypresses
+   * \retval keys Every key read is added to the end of this (in order), with repeated presses of the same key
+   *         joined into one. If the key isn't alphanumeric, the char will be '\0'. Nothing is added if the
+   *         timeout expired before any input arrived
+   * \param timeout_ms How long (in milliseconds) to wait for input. A negative value blocks until input arrives
    * \throws std::runtime_error There is a problem processing key presses
-   * \note This is implemented specific to the platform
+   * \note This is implemented specific to the platform. It sleeps until input is
+   *       available rather than polling
+   */
+  void getKeyPresses(KeyBuffer& keys, int timeout_ms = -1);
+
+  /*! Write everything in the output buffer to the console, and empty the buffer
+   * \throws std::runtime_error There was a problem writing to the console
+   * \note This is implemented specific to the platform, using a single write where possible
    */
-  std::vector<std::tuple<KeyPressed, char>> getKeyPresses() const;
+  void flushOutput();
 
   /*! Clean up the platform specific console
    * \note This is implemented specific to the platform
@@ -109,19 +386,101 @@ private:
   //! The prompt to display
   std::string prompt_;
 
+  //! Everything to show on the console for the current batch of key presses
+  OutputBuffer out_;
+
+  //! The line being edited
+  LineBuffer line_;
+
+  //! Whether we're part way through editing a line
+  bool editing_ = false;
+
+  //! The position we are in the history
+  std::size_t history_pos_ = 0;
+
+  //! The line being edited before moving through the history
+  std::string current_line_;
+
+  //! Whether the last key was <Tab>, so a second <Tab> lists the commands
+  bool tab_pressed_ = false;
+
+  //! How many commands we've listed so far, if there were too many to show at once
+  std::size_t n_listed_ = 0;
+
+  //! Keeps track of what's on the input line, so we only send changes
+  LineRenderer renderer_;
+
   //! Variables needed by the platform specific code
   PlatformVariables platform_vars_;
 
-  //! The key mapping to help with key inputs
-  std::map<KeyMapping, KeyPressed> key_map_;
+  //! Keys read but not handled yet, including any after the user pressed <Enter>. This is
+  //! reused for every read, so it doesn't allocate once it's grown to fit the input
+  KeyBuffer keys_;
+
+  //! The trace of the keys read, if they're being recorded
+  KeyTraceWriter key_trace_;
+
+  //! The keys from the last read, while they're being recorded
+  KeyBuffer recorded_keys_;
+
+  //! Timing of each stage of handling keys
+  ConsoleStats stats_;
 
   //! The history
-  std::vector<std::string> history_;
+  CommandHistory history_;
+
+  //! An index for searching the history
+  HistoryIndex history_index_;
+
+  //! The search of the history, if there is one
+  HistorySearch history_search_;
+
+  //! The match shown while searching the history
+  LineBuffer search_line_;
+
+  //! The commands, with their names for <Tab> completion (shared by all the sessions of a server)
+  std::shared_ptr<CommandRegistry> registry_;
+
+  //! The input and output of a session, or null if the console uses the process's terminal
+  std::unique_ptr<SessionIo> session_;
+
+  //! The results of the last <Tab> completion search (kept to reuse the storage)
+  TrieMatches completion_matches_;
+
+  //! Where the line got to in the command trie, so <Tab> only walks what's changed since the last one
+  TrieCursor completion_cursor_;
+
+  //! The matches when completing an argument
+  TrieMatches argument_matches_;
+
+  //! How <Tab> completes commands
+  CompletionMode completion_mode_;
+
+  //! The results of the last fuzzy completion search
+  FuzzyMatches fuzzy_matches_;
+
+  //! How long to wait for a key press before calling the idle handler (negative is forever)
+  int idle_timeout_ms_;
+
+  //! Called when no key is pressed within idle_timeout_ms_
+  std::function<void()> idle_handler_;
+
+  //! Messages posted by other threads
+  MessageQueue messages_;
+
+  //! Whether the console has been woken for the messages it hasn't shown yet
+  std::atomic<bool> wake_pending_{ false };
+
+  //! What the threads waiting for background commands share with the console
+  struct BackgroundLink
+  {
+    explicit BackgroundLink(TestConsole* c) : console{ c } {}
 
-  //! Our command trie for <Tab> completion
-  CommandTrie completion_trie_;
+    std::mutex mutex;         /*!< Guards the rest, and is held while a result is posted */
+    TestConsole* console;     /*!< The console to post results to, or null once it's gone */
+    std::size_t running = 0;  /*!< The number of background commands that haven't finished */
+  };
 
-  //! Some commands - each command just prints a message 
-  //! (this isn't really the way to represent commands!)
-  std::map<std::string, std::string> commands_;
+  //! The link to the background commands' threads, which they keep if they outlive the console
+  std::shared_ptr<BackgroundLink> background_;
 };
@@ -0,0 +1,174 @@
+/*
+ * File: fuzzy.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// test-console includes
+#include <fuzzy.h>
+
+// STL includes
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+
+namespace
+{
+  //! The score for each matched character
+  const int MATCH_SCORE = 1;
+
+  //! The extra score for a character straight after the previous match
+  const int CONSECUTIVE_BONUS = 4;
+
+  //! The extra score for a character at the start of the command or of a word in it
+  const int WORD_START_BONUS = 3;
+
+  // Lower case a letter (and leave anything else alone)
+  inline char toLower(char c)
+  {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+  }
+}
+
+// Add a command
+void FuzzyMatcher::insert(const std::string& str)
+{
+  if (commands_.size() + str.size() > std::numeric_limits<std::uint32_t>::max())
+    throw std::length_error("The fuzzy matcher has run out of space for commands");
+
+  std::uint64_t mask = 0;
+  for (auto c : str)
+    mask |= charBit(c);
+
+  masks_.push_back(mask);
+  commands_ += str;
+  starts_.push_back(static_cast<std::uint32_t>(commands_.size()));
+}
+
+// Remove a command
+bool FuzzyMatcher::remove(const std::string& str)
+{
+  // The mask rules out most commands without comparing them
+  std::uint64_t mask = 0;
+  for (auto c : str)
+    mask |= charBit(c);
+
+  for (std::uint32_t i = 0; i < masks_.size(); ++i)
+  {
+    if (masks_[i] != mask || command(i) != str)
+      continue;
+
+    commands_.erase(starts_[i], str.size());
+    for (std::size_t j = i + 1; j < starts_.size(); ++j)
+      starts_[j] -= static_cast<std::uint32_t>(str.size());
+    starts_.erase(starts_.begin() + i + 1);
+    masks_.erase(masks_.begin() + i);
+    return true;
+  }
+  return false;
+}
+
+// Copy the commands returned
+void FuzzyMatches::keepCommands()
+{
+  // Copy them all first, as adding to the text can move it
+  text_.clear();
+  for (auto command : commands_)
+    text_.append(command);
+  std::size_t pos = 0;
+  for (auto& command : commands_)
+  {
+    command = std::string_view(text_).substr(pos, command.size());
+    pos += command.size();
+  }
+}
+
+// Find the commands matching a pattern
+void FuzzyMatcher::find(const std::string& pattern, FuzzyMatches& matches, std::size_t first,
+  std::size_t max_commands) const
+{
+  matches.candidates_.clear();
+  matches.commands_.clear();
+
+  std::uint64_t pattern_mask = 0;
+  for (auto c : pattern)
+    pattern_mask |= charBit(c);
+
+  // Only score the commands that have all the pattern's characters
+  for (std::uint32_t i = 0; i < masks_.size(); ++i)
+  {
+    if ((masks_[i] & pattern_mask) != pattern_mask)
+      continue;
+    int s = score(pattern, command(i));
+    if (s >= 0)
+      matches.candidates_.emplace_back(s, i);
+  }
+
+  // Only the commands up to the end of the page need sorting
+  auto better = [this](const std::pair<int, std::uint32_t>& a, const std::pair<int, std::uint32_t>& b)
+  {
+    if (a.first != b.first)
+      return a.first > b.first;
+    std::size_t length_a = starts_[a.second + 1] - starts_[a.second];
+    std::size_t length_b = starts_[b.second + 1] - starts_[b.second];
+    if (length_a != length_b)
+      return length_a < length_b;
+    return a.second < b.second;
+  };
+  std::size_t n_wanted = std::min(matches.candidates_.size(),
+    first + std::min(max_commands, matches.candidates_.size()));
+  std::partial_sort(matches.candidates_.begin(), matches.candidates_.begin() + n_wanted,
+    matches.candidates_.end(), better);
+
+  for (std::size_t i = first; i < n_wanted; ++i)
+    matches.commands_.push_back(command(matches.candidates_[i].second));
+}
+
+// Get the mask bit for a char
+std::uint64_t FuzzyMatcher::charBit(char c)
+{
+  return std::uint64_t(1) << (static_cast<unsigned char>(toLower(c)) % 64);
+}
+
+// Score a command
+int FuzzyMatcher::score(const std::string& pattern, std::string_view command)
+{
+  int total = 0;
+  std::string::size_type p = 0;
+  std::string_view::size_type last_match = std::string_view::npos;
+  for (std::string_view::size_type i = 0; i < command.size() && p < pattern.size(); ++i)
+  {
+    if (toLower(command[i]) != toLower(pattern[p]))
+      continue;
+
+    total += MATCH_SCORE;
+    if (last_match != std::string_view::npos && last_match + 1 == i)
+      total += CONSECUTIVE_BONUS;
+    if (i == 0 || command[i - 1] == '-' || command[i - 1] == '_')
+      total += WORD_START_BONUS;
+    last_match = i;
+    ++p;
+  }
+  return p == pattern.size() ? total : -1;
+}
@@ -0,0 +1,168 @@
+/*
+ * File: fuzzy.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// STL includes
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <utility>
+
+/*!
+ * For fuzzy command completion we match the user's input as a subsequence
+ * of each command (so 'cdrain' matches 'cluster-node-drain').
+ *
+ * To keep this fast with a large number of commands, each command has a
+ * 64-bit mask of the characters it contains, and the masks are kept
+ * together in one vector. A command can only match if it has every
+ * character of the input, so a quick scan of the masks rules out most
+ * commands before we score the rest.
+ */
+
+class FuzzyMatcher;
+
+/*!
+ * The results of a fuzzy search. Keep one of these and pass it to each
+ * search so its storage is reused
+ */
+class FuzzyMatches
+{
+public:
+
+  /*!
+   * Get the number of matching commands returned
+   * \return The number of commands
+   */
+  std::size_t size() const { return commands_.size(); }
+
+  /*!
+   * Get the total number of commands that match, whether they were returned or not
+   * \return The number of matching commands
+   */
+  std::size_t total() const { return candidates_.size(); }
+
+  /*!
+   * Get one of the matching commands (the best match is first)
+   * \param i The index of the command
+   * \return A view of the command, valid until the matcher is changed (or until the next search,
+   *         after keepCommands())
+   */
+  std::string_view operator[](std::size_t i) const { return commands_[i]; }
+
+  /*!
+   * Copy the commands returned into the results, so they stay valid if the matcher is changed
+   * \note Only the commands returned are copied, into storage that's reused by later searches
+   */
+  void keepCommands();
+
+private:
+  friend class FuzzyMatcher;
+
+  //! The score and command index of every match
+  std::vector<std::pair<int, std::uint32_t>> candidates_;
+
+  //! The commands returned
+  std::vector<std::string_view> commands_;
+
+  //! The text of the commands returned, once keepCommands() has copied them
+  std::string text_;
+};
+
+/*!
+ * Match commands by subsequence, ranking the best matches first
+ */
+class FuzzyMatcher
+{
+public:
+
+  /*!
+   * Add a command to match against
+   * \param str The command to add
+   * \throws std::length_error There is no more space for commands
+   * \note Each command should only be added once (the CommandTrie it's used with already
+   *       knows which commands exist, so we don't check again here)
+   */
+  void insert(const std::string& str);
+
+  /*!
+   * Stop matching against a command
+   * \param str The command to remove
+   * \return True if the command was there
+   * \note This moves the commands after it down, so it's slower than adding a command
+   */
+  bool remove(const std::string& str);
+
+  /*!
+   * Find the commands that contain a pattern as a subsequence
+   * \param pattern The characters to look for, in order (letters match either case)
+   * \retval matches The results of the search (anything already there is cleared first)
+   * \param first The number of the best matching commands to skip before the ones returned
+   * \param max_commands The most matching commands to return
+   * \note Matches score more for consecutive characters and for characters at the start of
+   *       the command or of a word in it (after '-' or '_'). Equal scores put the shorter
+   *       command first
+   */
+  void find(const std::string& pattern, FuzzyMatches& matches, std::size_t first, std::size_t max_commands) const;
+
+private:
+
+  /*!
+   * Get the mask bit for a character
+   * \param c The character
+   * \return The bit for the character (letters share a bit for both cases)
+   */
+  static std::uint64_t charBit(char c);
+
+  /*!
+   * Score a command against a pattern
+   * \param pattern The pattern to match
+   * \param command The command to score
+   * \return The score, or -1 if the pattern isn't a subsequence of the command
+   */
+  static int score(const std::string& pattern, std::string_view command);
+
+  /*!
+   * Get a command
+   * \param i The index of the command
+   * \return A view of the command
+   */
+  std::string_view command(std::uint32_t i) const
+  {
+    return std::string_view(commands_).substr(starts_[i], starts_[i + 1] - starts_[i]);
+  }
+
+  //! The character mask of each command
+  std::vector<std::uint64_t> masks_;
+
+  //! All the commands, one after another
+  std::string commands_;
+
+  //! Where each command starts in commands_ (with an extra entry for the end of the last one)
+  std::vector<std::uint32_t> starts_ = { 0 };
+};
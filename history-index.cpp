@@ -0,0 +1,223 @@
+/*
+ * File: history-index.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <history-index.h>
+#include <utf8.h>
+
+// STL includes
+#include <algorithm>
+
+namespace
+{
+  //! The longest n-gram we index
+  const std::size_t MAX_GRAM = 3;
+
+  //! How many dropped entries we let the index keep before building it again
+  const std::size_t REBUILD_SLACK = 1024;
+
+  /*!
+   * Get the key for an n-gram
+   * \param gram The n-gram, of one to MAX_GRAM characters
+   * \return The n-gram packed with its length, so different lengths don't clash
+   */
+  std::uint32_t gramKey(std::string_view gram)
+  {
+    std::uint32_t key = static_cast<std::uint32_t>(gram.size()) << 24;
+    for (std::size_t i = 0; i < gram.size(); ++i)
+      key |= static_cast<std::uint32_t>(static_cast<unsigned char>(gram[i])) << (16 - 8 * i);
+    return key;
+  }
+}
+
+// Index new entries
+void HistoryIndex::update(const CommandHistory& history)
+{
+  if (!built_)
+    return;
+
+  // If most of what we've indexed has dropped out of the history, start again
+  std::size_t begin_id = history.id(history.begin());
+  if (n_indexed_ > 2 * history.size() + REBUILD_SLACK)
+  {
+    postings_.clear();
+    n_indexed_ = 0;
+    end_id_ = begin_id;
+  }
+
+  std::size_t pos = end_id_ > begin_id ? history.position(end_id_) : history.begin();
+  for (; pos != history.end(); pos = history.next(pos))
+    add(history.id(pos), history[pos]);
+  end_id_ = history.id(history.end());
+}
+
+// Forget everything
+void HistoryIndex::clear()
+{
+  postings_.clear();
+  end_id_ = 0;
+  n_indexed_ = 0;
+  built_ = false;
+}
+
+// Find the entries containing the text
+void HistoryIndex::find(const CommandHistory& history, std::string_view text, std::vector<std::size_t>& ids)
+{
+  ids.clear();
+
+  // Build the index the first time it's used
+  if (!built_)
+  {
+    built_ = true;
+    end_id_ = history.id(history.begin());
+  }
+  update(history);
+
+  // Every entry containing the text contains all its n-grams, so we only
+  // need to check the entries with the least common one
+  std::size_t n = std::min(text.size(), MAX_GRAM);
+  const std::vector<std::size_t>* candidates = nullptr;
+  for (std::size_t i = 0; i + n <= text.size(); ++i)
+  {
+    auto it = postings_.find(gramKey(text.substr(i, n)));
+    if (it == postings_.end())
+      return;
+    if (candidates == nullptr || it->second.size() < candidates->size())
+      candidates = &it->second;
+  }
+  if (candidates == nullptr)
+    return;
+
+  // The lists are oldest first, and anything before the start of the history has been dropped
+  std::size_t begin_id = history.id(history.begin());
+  for (auto it = candidates->rbegin(); it != candidates->rend() && *it >= begin_id; ++it)
+  {
+    if (history[history.position(*it)].find(text) != std::string_view::npos)
+      ids.push_back(*it);
+  }
+}
+
+// Add an entry's n-grams
+void HistoryIndex::add(std::size_t id, std::string_view entry)
+{
+  // An n-gram can appear more than once in an entry, but we only list the entry once
+  grams_.clear();
+  for (std::size_t n = 1; n <= MAX_GRAM; ++n)
+    for (std::size_t i = 0; i + n <= entry.size(); ++i)
+      grams_.push_back(gramKey(entry.substr(i, n)));
+  std::sort(grams_.begin(), grams_.end());
+  grams_.erase(std::unique(grams_.begin(), grams_.end()), grams_.end());
+
+  for (auto key : grams_)
+    postings_[key].push_back(id);
+  ++n_indexed_;
+}
+
+// Start a new search
+void HistorySearch::start()
+{
+  active_ = true;
+  text_.clear();
+  matches_.clear();
+  current_.clear();
+  has_shown_ = false;
+}
+
+// End the search
+void HistorySearch::stop()
+{
+  active_ = false;
+}
+
+// Add a character to the search
+void HistorySearch::push(char c, const CommandHistory& history, HistoryIndex& index)
+{
+  text_.push_back(c);
+  matches_.emplace_back();
+  current_.push_back(0);
+  std::vector<std::size_t>& matches = matches_.back();
+
+  if (matches_.size() == 1)
+  {
+    index.find(history, text_, matches);
+  }
+  else
+  {
+    // Only the entries that matched without the new character can match with it
+    for (auto id : matches_[matches_.size() - 2])
+      if (history[history.position(id)].find(text_) != std::string_view::npos)
+        matches.push_back(id);
+  }
+
+  if (!matches.empty())
+  {
+    shown_id_ = matches.front();
+    has_shown_ = true;
+  }
+}
+
+// Remove the last character of the search (all of its bytes)
+bool HistorySearch::pop()
+{
+  if (text_.empty())
+    return false;
+
+  // A character may have been pushed as several UTF-8 bytes, so take them all
+  bool continuation = false;
+  do
+  {
+    continuation = isUtf8Continuation(static_cast<unsigned char>(text_.back()));
+    text_.pop_back();
+    matches_.pop_back();
+    current_.pop_back();
+  } while (continuation && !text_.empty());
+  if (found())
+    shown_id_ = matches_.back()[current_.back()];
+  return true;
+}
+
+// Move to the next older match
+bool HistorySearch::older()
+{
+  if (!found() || current_.back() + 1 >= matches_.back().size())
+    return false;
+
+  ++current_.back();
+  shown_id_ = matches_.back()[current_.back()];
+  return true;
+}
+
+// Get the match to show
+std::string_view HistorySearch::match(const CommandHistory& history) const
+{
+  if (found())
+    return history[history.position(matches_.back()[current_.back()])];
+  if (has_shown_)
+    return history[history.position(shown_id_)];
+  return std::string_view();
+}
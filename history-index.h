@@ -0,0 +1,184 @@
+/*
+ * File: history-index.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// test-console includes
+#include <history.h>
+
+// STL includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * An index for searching the history for entries containing some text.
+ * For every run of one, two and three characters (n-gram) in an entry, we
+ * keep a list of the ids of the entries containing it. A search only has to
+ * check the entries in the shortest list for the n-grams in the text.
+ *
+ * The index isn't built until the first search, so opening a big history
+ * stays cheap. After that, update() adds any new entries as they're added
+ * to the history.
+ */
+class HistoryIndex
+{
+public:
+
+  /*!
+   * Add the entries that have been added to the history since the last update.
+   * Does nothing until the index has been used for a search
+   * \param history The history being indexed
+   */
+  void update(const CommandHistory& history);
+
+  /*!
+   * Forget everything in the index (e.g. because the history has been opened again)
+   */
+  void clear();
+
+  /*!
+   * Find the entries containing some text
+   * \param history The history being indexed
+   * \param text The text to look for, which mustn't be empty
+   * \param ids Set to the ids of the entries containing the text, newest first
+   */
+  void find(const CommandHistory& history, std::string_view text, std::vector<std::size_t>& ids);
+
+private:
+
+  /*!
+   * Add an entry to the index
+   * \param id The id of the entry
+   * \param entry The entry
+   */
+  void add(std::size_t id, std::string_view entry);
+
+  //! The lists of entries containing each n-gram
+  std::unordered_map<std::uint32_t, std::vector<std::size_t>> postings_;
+
+  //! The id just past the newest entry we've indexed
+  std::size_t end_id_ = 0;
+
+  //! The number of entries we've indexed, including ones no longer in the history
+  std::size_t n_indexed_ = 0;
+
+  //! Whether the index has been built
+  bool built_ = false;
+
+  //! Space for collecting an entry's n-grams
+  std::vector<std::uint32_t> grams_;
+};
+
+/*!
+ * The state of an incremental search of the history (e.g. for <Ctrl-R>).
+ * Each character added to the search only has to check the entries that
+ * matched without it, and removing the character goes back to them.
+ */
+class HistorySearch
+{
+public:
+
+  /*!
+   * Start a new search
+   */
+  void start();
+
+  /*!
+   * End the search
+   */
+  void stop();
+
+  /*!
+   * Check if there's a search going on
+   * \return True if we're searching
+   */
+  bool active() const { return active_; }
+
+  /*!
+   * Get what's being searched for
+   * \return The search text
+   */
+  const std::string& text() const { return text_; }
+
+  /*!
+   * Check if the current search text matches anything
+   * \return False if nothing matches (or there's no search text yet)
+   */
+  bool found() const { return !matches_.empty() && !matches_.back().empty(); }
+
+  /*!
+   * Add a character to what's being searched for
+   * \param c The character to add (or one byte of a UTF-8 character)
+   * \param history The history being searched
+   * \param index The index of the history
+   */
+  void push(char c, const CommandHistory& history, HistoryIndex& index);
+
+  /*!
+   * Remove the last character from what's being searched for, with all of its UTF-8 bytes
+   * \return False if there was nothing to remove
+   */
+  bool pop();
+
+  /*!
+   * Move to the next older match
+   * \return False if there's no older match
+   */
+  bool older();
+
+  /*!
+   * Get the current match, or the last match if nothing matches the search text
+   * \param history The history being searched
+   * \return The matching entry, or an empty view if nothing has matched yet
+   */
+  std::string_view match(const CommandHistory& history) const;
+
+private:
+
+  //! Whether there's a search going on
+  bool active_ = false;
+
+  //! What's being searched for
+  std::string text_;
+
+  //! The ids of the entries matching the search text as each character was added, newest first
+  std::vector<std::vector<std::size_t>> matches_;
+
+  //! Which of the entries matching the whole search text we're showing, for each character
+  std::vector<std::size_t> current_;
+
+  //! The id of the last match we showed
+  std::size_t shown_id_ = 0;
+
+  //! Whether we've shown a match
+  bool has_shown_ = false;
+};
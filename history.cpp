@@ -0,0 +1,321 @@
+/*
+ * File: history.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <history.h>
+
+// STL includes
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstring>
+
+namespace
+{
+  //! Marks the start of a history file (and the version of its layout)
+  const char HISTORY_MAGIC[8] = { 'T', 'C', 'H', 'I', 'S', 'T', '\0', '\1' };
+
+  //! Where each of the log's positions is kept in the header
+  const std::size_t FIRST_OFFSET = 8;
+  const std::size_t END_OFFSET = 16;
+  const std::size_t COUNT_OFFSET = 24;
+
+  //! The smallest amount of storage we allocate for the log
+  const std::size_t MIN_CAPACITY = 4096;
+
+  //! Don't bother moving entries down to free less than this
+  const std::size_t MIN_COMPACT = 4096;
+
+  /*!
+   * Read a position from the header
+   * \param header The start of the log
+   * \param offset Where the position is in the header
+   * \return The position
+   */
+  std::size_t loadPosition(const char* header, std::size_t offset)
+  {
+    std::uint64_t pos;
+    std::memcpy(&pos, header + offset, sizeof(pos));
+    return static_cast<std::size_t>(pos);
+  }
+
+  /*!
+   * Write a position to the header
+   * \param header The start of the log
+   * \param offset Where the position goes in the header
+   * \param pos The position
+   */
+  void storePosition(char* header, std::size_t offset, std::size_t pos)
+  {
+    std::uint64_t value = pos;
+    std::memcpy(header + offset, &value, sizeof(value));
+  }
+}
+
+// Create an empty history in memory
+CommandHistory::CommandHistory(std::size_t max_entries)
+  : max_entries_{ std::max<std::size_t>(max_entries, 1) }
+{
+  initialise();
+}
+
+// Keep the history in a file
+void CommandHistory::open(const std::string& path)
+{
+  file_.open(path);
+
+  // A new file just needs a header
+  if (file_.size() == 0)
+  {
+    initialise();
+  }
+  else
+  {
+    // Check the file is one of ours before we trust the positions in it. Only the
+    // header is checked here, so opening a big history doesn't read it: each entry
+    // is checked when it's visited instead
+    const char* header = file_.data();
+    std::size_t first = 0, end = 0, count = 0;
+    bool valid = file_.size() >= HEADER_SIZE && std::memcmp(header, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) == 0;
+    if (valid)
+    {
+      first = loadPosition(header, FIRST_OFFSET);
+      end = loadPosition(header, END_OFFSET);
+      count = loadPosition(header, COUNT_OFFSET);
+      valid = first >= HEADER_SIZE && end >= HEADER_SIZE && end <= file_.size();
+
+      // If a compaction was cut short, the end has been moved down but the start hasn't
+      if (first > end)
+        first = HEADER_SIZE;
+    }
+    if (!valid)
+    {
+      file_.close();
+      throw std::runtime_error("'" + path + "' is not a history file");
+    }
+
+    // The count is saved after the end, so if we stopped in between it's one short.
+    // It's only used to limit the number of entries, so it's just kept in range here
+    first_ = first;
+    end_ = end;
+    count_ = count;
+    repairCount();
+    if (first != loadPosition(header, FIRST_OFFSET) || count_ != count)
+      storeHeader();
+  }
+
+  // Entries from the file get new ids, starting from their positions
+  moved_ = 0;
+
+  // We don't need the in memory history any more
+  std::vector<char>().swap(memory_);
+
+  // The file may have been written with a bigger limit
+  setMaxEntries(max_entries_);
+}
+
+// Get the position of the entry before another
+std::size_t CommandHistory::previous(std::size_t pos) const
+{
+  // The entry must fit between the start of the log and pos, with matching lengths
+  if (pos > end_ || pos < first_ + 2 * LENGTH_SIZE)
+    return cutBefore(pos);
+  std::size_t length = loadLength(pos - LENGTH_SIZE);
+  if (length > pos - first_ - 2 * LENGTH_SIZE)
+    return cutBefore(pos);
+  std::size_t start = pos - 2 * LENGTH_SIZE - length;
+  if (loadLength(start) != length)
+    return cutBefore(pos);
+  return start;
+}
+
+// Get the position of the entry after another
+std::size_t CommandHistory::next(std::size_t pos) const
+{
+  std::size_t length = entryLength(pos);
+  return length == DAMAGED ? end_ : pos + 2 * LENGTH_SIZE + length;
+}
+
+// Get an entry
+std::string_view CommandHistory::operator[](std::size_t pos) const
+{
+  std::size_t length = entryLength(pos);
+  if (length == DAMAGED)
+    return {};
+  return std::string_view(storage() + pos + LENGTH_SIZE, length);
+}
+
+// Change the most entries to keep
+void CommandHistory::setMaxEntries(std::size_t max_entries)
+{
+  max_entries_ = std::max<std::size_t>(max_entries, 1);
+  if (count_ <= max_entries_)
+    return;
+
+  while (count_ > max_entries_)
+    dropOldest();
+  compact();
+  storeHeader();
+}
+
+// Add an entry to the history
+void CommandHistory::add(std::string_view entry)
+{
+  if (entry.empty() || (count_ != 0 && (*this)[previous(end_)] == entry))
+    return;
+
+  if (entry.size() > std::numeric_limits<Length>::max())
+    throw std::length_error("The history entry is too long");
+
+  // Make room by dropping the oldest entry if we're full
+  if (count_ >= max_entries_)
+  {
+    dropOldest();
+    compact();
+  }
+
+  // Write the entry before the header, so the header always describes complete entries
+  reserve(end_ + entry.size() + 2 * LENGTH_SIZE);
+  Length length = static_cast<Length>(entry.size());
+  storeLength(end_, length);
+  std::memcpy(storage() + end_ + LENGTH_SIZE, entry.data(), entry.size());
+  storeLength(end_ + LENGTH_SIZE + entry.size(), length);
+  end_ += entry.size() + 2 * LENGTH_SIZE;
+  ++count_;
+  storeHeader();
+}
+
+// Make sure there's room for the log to grow
+void CommandHistory::reserve(std::size_t size)
+{
+  if (size <= capacity())
+    return;
+
+  // Grow by at least double, so adding entries doesn't keep remapping the file
+  std::size_t new_capacity = std::max({ size, 2 * capacity(), MIN_CAPACITY });
+  if (file_.isOpen())
+    file_.resize(new_capacity);
+  else
+    memory_.resize(new_capacity);
+}
+
+// Set up an empty log
+void CommandHistory::initialise()
+{
+  reserve(HEADER_SIZE);
+  std::memcpy(storage(), HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+  first_ = HEADER_SIZE;
+  end_ = HEADER_SIZE;
+  count_ = 0;
+  storeHeader();
+}
+
+// Drop the oldest entry
+void CommandHistory::dropOldest()
+{
+  first_ = next(first_);
+  if (first_ == end_)
+    count_ = 0;
+  else if (count_ > 1)
+    --count_;
+}
+
+// Move the live entries down over the dropped ones
+void CommandHistory::compact()
+{
+  // Only do it when it more than halves the log, so each entry is moved a bounded number of times
+  std::size_t dropped = first_ - HEADER_SIZE;
+  std::size_t live = end_ - first_;
+  if (dropped < MIN_COMPACT || dropped <= live)
+    return;
+
+  // As we've dropped more than is live, the copy doesn't overlap the live entries,
+  // and the header describes them where they were until it's updated. The end goes
+  // first, and as it ends up before the old start, if we stop before the start is
+  // moved too, open() can tell (the start is past the end) and finish the job
+  std::memcpy(storage() + HEADER_SIZE, storage() + first_, live);
+  moved_ += first_ - HEADER_SIZE;
+  first_ = HEADER_SIZE;
+  end_ = HEADER_SIZE + live;
+  storePosition(storage(), END_OFFSET, end_);
+  storePosition(storage(), FIRST_OFFSET, first_);
+}
+
+// Save the log's positions
+void CommandHistory::storeHeader()
+{
+  char* header = storage();
+  storePosition(header, FIRST_OFFSET, first_);
+  storePosition(header, END_OFFSET, end_);
+  storePosition(header, COUNT_OFFSET, count_);
+}
+
+// Get the length of an entry, checking it's whole
+std::size_t CommandHistory::entryLength(std::size_t pos) const
+{
+  if (pos < first_ || pos >= end_ || end_ - pos < 2 * LENGTH_SIZE)
+    return DAMAGED;
+  std::size_t length = loadLength(pos);
+  if (length > end_ - pos - 2 * LENGTH_SIZE || loadLength(pos + LENGTH_SIZE + length) != length)
+    return DAMAGED;
+  return length;
+}
+
+// Drop the entries before a damaged one
+std::size_t CommandHistory::cutBefore(std::size_t pos) const
+{
+  if (pos >= first_ && pos <= end_)
+  {
+    first_ = pos;
+    repairCount();
+  }
+  return pos;
+}
+
+// Keep the count in the range the log allows
+void CommandHistory::repairCount() const
+{
+  if (first_ == end_)
+    count_ = 0;
+  else
+    count_ = std::clamp<std::size_t>(count_, 1, (end_ - first_) / (2 * LENGTH_SIZE));
+}
+
+// Read a length from the log
+CommandHistory::Length CommandHistory::loadLength(std::size_t pos) const
+{
+  Length length;
+  std::memcpy(&length, storage() + pos, LENGTH_SIZE);
+  return length;
+}
+
+// Write a length to the log
+void CommandHistory::storeLength(std::size_t pos, Length length)
+{
+  std::memcpy(storage() + pos, &length, LENGTH_SIZE);
+}
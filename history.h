@@ -0,0 +1,249 @@
+/*
+ * File: history.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// test-console includes
+#include <mapped-file.h>
+
+// STL includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * The command history. Entries are appended to a log, each one stored as its
+ * length, its text and its length again, so we can walk the log in either
+ * direction without an index. The log can be kept in a memory-mapped file,
+ * so the history survives between runs and opening it doesn't read it.
+ * As a file may have been damaged, each entry's lengths are checked when it's
+ * visited, and a damaged entry ends the history in that direction.
+ *
+ * Only the newest max_entries entries are kept: once we have that many, adding
+ * an entry drops the oldest one by moving the start of the log past it (so the
+ * log is used as a ring). The dropped entries are only removed, by moving the
+ * live ones down, when they take up more space than the live ones do.
+ *
+ * Entries are found by a position in the log. begin() is the oldest entry,
+ * end() is just past the newest, and positions stay valid until add() is called.
+ * An entry also has an id, which doesn't change when entries are moved down,
+ * and which is bigger for newer entries.
+ */
+class CommandHistory
+{
+public:
+
+  //! The default number of entries to keep
+  static constexpr std::size_t DEFAULT_MAX_ENTRIES = 10000;
+
+  /*!
+   * Create an empty history, kept in memory
+   * \param max_entries The most entries to keep
+   */
+  explicit CommandHistory(std::size_t max_entries = DEFAULT_MAX_ENTRIES);
+
+  /*!
+   * Keep the history in a file, replacing what's in memory with what's in the
+   * file. The file is created if it doesn't exist. Only the header is checked, so
+   * this doesn't depend on the size of the file
+   * \param path The path of the history file
+   * \throws std::runtime_error The file isn't a history file (the history in memory is kept)
+   */
+  void open(const std::string& path);
+
+  /*!
+   * Change the most entries to keep, dropping the oldest if there are too many
+   * \param max_entries The most entries to keep (at least one is always kept)
+   */
+  void setMaxEntries(std::size_t max_entries);
+
+  /*!
+   * Add an entry to the end of the history, unless it's empty or the same as the newest entry
+   * \param entry The entry to add
+   */
+  void add(std::string_view entry);
+
+  /*!
+   * Get the number of entries
+   * \return The number of entries in the history (if the file was damaged, this may
+   *         be out until the oldest entries have been dropped)
+   */
+  std::size_t size() const { return count_; }
+
+  /*!
+   * Check if there is any history
+   * \return True if there are no entries
+   */
+  bool empty() const { return count_ == 0; }
+
+  /*!
+   * Get the position of the oldest entry
+   * \return The position of the oldest entry (end() if there are none)
+   */
+  std::size_t begin() const { return first_; }
+
+  /*!
+   * Get the position just past the newest entry
+   * \return The end position
+   */
+  std::size_t end() const { return end_; }
+
+  /*!
+   * Get the position of the entry before another
+   * \param pos The position of an entry (or end()), which mustn't be begin()
+   * \return The position of the entry before it. If that entry is damaged, the
+   *         entries before pos are dropped, and pos (now begin()) is returned
+   */
+  std::size_t previous(std::size_t pos) const;
+
+  /*!
+   * Get the position of the entry after another
+   * \param pos The position of an entry, which mustn't be end()
+   * \return The position of the entry after it, or end() if the entry is damaged
+   */
+  std::size_t next(std::size_t pos) const;
+
+  /*!
+   * Get an entry
+   * \param pos The position of the entry, which mustn't be end()
+   * \return A view of the entry, valid until add() is called (empty if the entry is damaged)
+   */
+  std::string_view operator[](std::size_t pos) const;
+
+  /*!
+   * Get the id of an entry
+   * \param pos The position of the entry (or end())
+   * \return The id of the entry, which stays the same until the history is opened again
+   */
+  std::size_t id(std::size_t pos) const { return pos + moved_; }
+
+  /*!
+   * Get the current position of an entry
+   * \param id The id of the entry, which must still be in the history
+   * \return The position of the entry
+   */
+  std::size_t position(std::size_t id) const { return id - moved_; }
+
+private:
+
+  //! The type used to store the length of an entry
+  using Length = std::uint32_t;
+
+  //! The size of a stored length
+  static constexpr std::size_t LENGTH_SIZE = sizeof(Length);
+
+  //! The size of the header at the start of the log, where the log's positions are kept
+  static constexpr std::size_t HEADER_SIZE = 32;
+
+  //! The length given for an entry that's damaged
+  static constexpr std::size_t DAMAGED = static_cast<std::size_t>(-1);
+
+  /*!
+   * Get the start of the log
+   * \return The start of the log, in the file if there is one
+   */
+  char* storage() const { return file_.isOpen() ? file_.data() : const_cast<char*>(memory_.data()); }
+
+  /*!
+   * Get the space we have for the log
+   * \return The size of the storage
+   */
+  std::size_t capacity() const { return file_.isOpen() ? file_.size() : memory_.size(); }
+
+  /*!
+   * Make sure there's room for the log to grow
+   * \param size The size the log needs to be
+   */
+  void reserve(std::size_t size);
+
+  //! Write an empty header to the start of the storage
+  void initialise();
+
+  //! Drop the oldest entry
+  void dropOldest();
+
+  //! Move the entries down over the ones that have been dropped, if it's worth doing
+  void compact();
+
+  //! Save the log's positions in the header
+  void storeHeader();
+
+  /*!
+   * Get the length of an entry, checking that it's inside the log and its two lengths match
+   * \param pos The position of the entry
+   * \return The length of the entry, or DAMAGED
+   */
+  std::size_t entryLength(std::size_t pos) const;
+
+  /*!
+   * Drop the entries before a damaged one, so the history starts after it
+   * \param pos The position just after the damaged entry
+   * \return pos
+   */
+  std::size_t cutBefore(std::size_t pos) const;
+
+  //! Keep the count within what fits between the start and the end of the log
+  void repairCount() const;
+
+  /*!
+   * Read a length from the log
+   * \param pos Where the length is
+   * \return The length
+   */
+  Length loadLength(std::size_t pos) const;
+
+  /*!
+   * Write a length to the log
+   * \param pos Where the length goes
+   * \param length The length
+   */
+  void storeLength(std::size_t pos, Length length);
+
+  //! The history file, if we have one
+  MappedFile file_;
+
+  //! The storage, if we don't have a file
+  std::vector<char> memory_;
+
+  //! The most entries to keep
+  std::size_t max_entries_;
+
+  //! The position of the oldest entry (moved on if an older entry turns out to be damaged)
+  mutable std::size_t first_;
+
+  //! The position just past the newest entry
+  std::size_t end_;
+
+  //! The number of entries
+  mutable std::size_t count_;
+
+  //! How far entries have been moved down, so ids can be turned into positions
+  std::size_t moved_ = 0;
+};
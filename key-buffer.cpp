@@ -0,0 +1,128 @@
+/*
+ * File: key-buffer.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <key-buffer.h>
+
+// STL includes
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+  // Check if a key can be treated as one key with a repeat count.
+  // <Tab> and <Enter> can't, as how each press is handled depends on the one before
+  bool canRepeat(KeyPressed key)
+  {
+    switch (key)
+    {
+    case KeyPressed::alphanum:
+    case KeyPressed::backspace:
+    case KeyPressed::del:
+    case KeyPressed::leftarrow:
+    case KeyPressed::rightarrow:
+    case KeyPressed::uparrow:
+    case KeyPressed::downarrow:
+    case KeyPressed::wordleft:
+    case KeyPressed::wordright:
+      return true;
+    default:
+      return false;
+    }
+  }
+}
+
+// Add a key press
+void KeyBuffer::push(KeyPressed key, char c, std::uint32_t repeat /*= 1*/)
+{
+  if (repeat == 0)
+    return;
+
+  if (!canRepeat(key))
+  {
+    for (std::uint32_t i = 0; i < repeat; ++i)
+      events_.push_back(KeyEvent{ key, c, 1, 0, 0 });
+    return;
+  }
+
+  // Join it on to the last key press if that was the same key
+  if (!empty())
+  {
+    KeyEvent& last = events_.back();
+    if (last.key == key && last.c == c && last.repeat <= std::numeric_limits<std::uint32_t>::max() - repeat)
+    {
+      last.repeat += repeat;
+      return;
+    }
+  }
+  events_.push_back(KeyEvent{ key, c, repeat, 0, 0 });
+}
+
+// Add a paste
+void KeyBuffer::pushPaste(std::string_view text)
+{
+  events_.push_back(KeyEvent{ KeyPressed::paste, '\0', 1, static_cast<std::uint32_t>(text_.size()),
+    static_cast<std::uint32_t>(text.size()) });
+  text_.append(text);
+}
+
+// Remove the oldest key press
+void KeyBuffer::pop()
+{
+  ++next_;
+
+  // Start again at the beginning once everything's been handled
+  if (next_ == events_.size())
+  {
+    events_.clear();
+    text_.clear();
+    next_ = 0;
+  }
+}
+
+// Remove the start of a paste
+void KeyBuffer::consumeText(std::size_t length)
+{
+  KeyEvent& k = events_[next_];
+  length = std::min<std::size_t>(length, k.text_length);
+  k.text_start += static_cast<std::uint32_t>(length);
+  k.text_length -= static_cast<std::uint32_t>(length);
+}
+
+// Take the key presses from another buffer
+void KeyBuffer::append(KeyBuffer& other)
+{
+  for (; !other.empty(); other.pop())
+  {
+    const KeyEvent& k = other.front();
+    if (k.key == KeyPressed::paste)
+      pushPaste(other.text(k));
+    else
+      push(k.key, k.c, k.repeat);
+  }
+}
@@ -0,0 +1,160 @@
+/*
+ * File: key-buffer.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// STL includes
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+//! Indicate the type of key press
+enum class KeyPressed
+{
+  alphanum,    /*!< A printable character was typed */
+  enter,       /*!< Enter (or related key) was pressed */
+  backspace,   /*!< Backspace was pressed */
+  del,         /*!< The Delete (or Del) key was pressed */
+  tab,         /*!< The Tab key was pressed */
+  leftarrow,   /*!< The left arrow key was pressed */
+  rightarrow,  /*!< The right arrow key was pressed */
+  uparrow,     /*!< The up arrow key was pressed */
+  downarrow,   /*!< The down arrow key was pressed */
+  home,        /*!< The Home key was pressed */
+  end,         /*!< The End key was pressed */
+  pageup,      /*!< The Page Up key was pressed */
+  pagedown,    /*!< The Page Down key was pressed */
+  wordleft,    /*!< Ctrl (or Alt) and the left arrow were pressed */
+  wordright,   /*!< Ctrl (or Alt) and the right arrow were pressed */
+  function,    /*!< A function key was pressed. The char is its number (1 for F1) */
+  paste,       /*!< A block of text was pasted (bracketed paste) */
+  search,      /*!< Ctrl-R was pressed to search the history */
+  cancel,      /*!< Esc or Ctrl-G was pressed to cancel a search */
+  undefined,   /*!< The key press was not something we handle */
+  error        /*!< If there is a problem with the key reader */
+};
+
+/*!
+ * A key press read from the console. A key held down (or typed again
+ * quickly) is one event with a repeat count, so the line editor can apply
+ * it in one go. Pasted text is kept in the KeyBuffer the event is in
+ */
+struct KeyEvent
+{
+  KeyPressed key;            /*!< The type of key press */
+  char c;                    /*!< The character for KeyPressed::alphanum, the number for KeyPressed::function, otherwise '\0' */
+  std::uint32_t repeat;      /*!< How many times the key was pressed */
+  std::uint32_t text_start;  /*!< Where the pasted text for KeyPressed::paste starts in the buffer */
+  std::uint32_t text_length; /*!< The length of the pasted text */
+};
+
+/*!
+ * The key presses read from the console and not yet handled. The platform
+ * code adds to the end and the line editor takes from the front. Once
+ * everything has been taken, the storage is reused from the start, so
+ * reading keys doesn't allocate once the buffer has grown to fit
+ */
+class KeyBuffer
+{
+public:
+
+  /*!
+   * Add a key press, merging it with the last one if it's the same editing key
+   * \param key The type of key press
+   * \param c The character for KeyPressed::alphanum, otherwise '\0'
+   * \param repeat How many times the key was pressed (default is 1)
+   */
+  void push(KeyPressed key, char c, std::uint32_t repeat = 1);
+
+  /*!
+   * Add a paste
+   * \param text The pasted text
+   */
+  void pushPaste(std::string_view text);
+
+  /*!
+   * Check if there are any key presses left
+   * \return True if everything has been taken
+   */
+  bool empty() const { return next_ == events_.size(); }
+
+  /*!
+   * Get the oldest key press left
+   * \return The key press (the buffer mustn't be empty)
+   */
+  KeyEvent& front() { return events_[next_]; }
+
+  /*!
+   * Get the number of key presses left
+   * \return The number of key events (each of which may be a repeated key)
+   */
+  std::size_t size() const { return events_.size() - next_; }
+
+  /*!
+   * Get one of the key presses left, without taking it
+   * \param i The index of the key press, from the oldest left
+   * \return The key press
+   */
+  const KeyEvent& operator[](std::size_t i) const { return events_[next_ + i]; }
+
+  /*!
+   * Remove the oldest key press
+   */
+  void pop();
+
+  /*!
+   * Get the pasted text for a key press
+   * \param k The key press, which must be in this buffer
+   * \return A view of the text, valid until more is added
+   */
+  std::string_view text(const KeyEvent& k) const { return std::string_view(text_).substr(k.text_start, k.text_length); }
+
+  /*!
+   * Remove the start of the pasted text of the oldest key press, leaving the rest of the paste to handle
+   * \param length How much of the text to remove
+   */
+  void consumeText(std::size_t length);
+
+  /*!
+   * Move all the key presses left in another buffer to the end of this one
+   * \param other The buffer to take the key presses from, which is left empty
+   */
+  void append(KeyBuffer& other);
+
+private:
+
+  //! The key presses, the handled ones first
+  std::vector<KeyEvent> events_;
+
+  //! The pasted text for all the key presses
+  std::string text_;
+
+  //! The oldest key press still to handle
+  std::size_t next_ = 0;
+};
@@ -0,0 +1,162 @@
+/*
+ * File: key-trace.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <key-trace.h>
+
+// STL includes
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+
+namespace
+{
+  //! The magic number at the start of every trace, with the format version in the last byte
+  const char TRACE_MAGIC[8] = { 'T', 'C', 'K', 'E', 'Y', 'S', '\0', '\1' };
+
+  //! The size of the count at the start of a batch
+  const std::size_t BATCH_HEADER_SIZE = sizeof(std::uint32_t);
+
+  //! The size of a record before its text
+  const std::size_t RECORD_HEADER_SIZE = 1 + 1 + sizeof(std::uint32_t) + sizeof(std::uint32_t);
+
+  // Append a 32-bit value to a record
+  void appendValue(std::string& record, std::uint32_t value)
+  {
+    char bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    record.append(bytes, sizeof(bytes));
+  }
+
+  // Read a 32-bit value from a record
+  std::uint32_t loadValue(const char* data)
+  {
+    std::uint32_t value{ 0 };
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+}
+
+// Start a new trace
+void KeyTraceWriter::open(const std::string& path)
+{
+  file_.close();
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open())
+    throw std::runtime_error("Unable to create the key trace " + path);
+  file_.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  n_keys_ = 0;
+}
+
+// Add key presses to the trace
+void KeyTraceWriter::write(const KeyBuffer& keys)
+{
+  if (keys.empty())
+    return;
+
+  record_.clear();
+  appendValue(record_, static_cast<std::uint32_t>(keys.size()));
+  for (std::size_t i = 0; i < keys.size(); ++i)
+  {
+    const KeyEvent& k = keys[i];
+    std::string_view text = k.key == KeyPressed::paste ? keys.text(k) : std::string_view();
+    record_ += static_cast<char>(k.key);
+    record_ += k.c;
+    appendValue(record_, k.repeat);
+    appendValue(record_, static_cast<std::uint32_t>(text.size()));
+    record_.append(text);
+    n_keys_ += k.repeat;
+  }
+
+  file_.write(record_.data(), record_.size());
+  file_.flush();
+  if (!file_)
+    throw std::runtime_error("Unable to write to the key trace");
+}
+
+// Open a trace
+void KeyTraceReader::open(const std::string& path)
+{
+  // Don't let the mapping create a file that isn't there
+  if (!std::ifstream(path).is_open())
+    throw std::runtime_error("Unable to open the key trace " + path);
+
+  file_.open(path);
+  if (file_.size() < sizeof(TRACE_MAGIC) || std::memcmp(file_.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0)
+  {
+    file_.close();
+    throw std::runtime_error(path + " isn't a key trace");
+  }
+  pos_ = sizeof(TRACE_MAGIC);
+}
+
+// Close the trace
+void KeyTraceReader::close()
+{
+  file_.close();
+  pos_ = 0;
+  n_keys_ = 0;
+}
+
+// Read the next batch of key presses
+std::size_t KeyTraceReader::read(KeyBuffer& keys)
+{
+  if (atEnd())
+    return 0;
+
+  const char* data = file_.data();
+  if (file_.size() - pos_ < BATCH_HEADER_SIZE)
+    throw std::runtime_error("The key trace has been cut off");
+  std::uint32_t n_events = loadValue(data + pos_);
+  pos_ += BATCH_HEADER_SIZE;
+
+  for (std::uint32_t i = 0; i < n_events; ++i)
+  {
+    if (file_.size() - pos_ < RECORD_HEADER_SIZE)
+      throw std::runtime_error("The key trace has been cut off");
+
+    auto key = static_cast<unsigned char>(data[pos_]);
+    char c = data[pos_ + 1];
+    std::uint32_t repeat = loadValue(data + pos_ + 2);
+    std::uint32_t text_length = loadValue(data + pos_ + 2 + sizeof(std::uint32_t));
+    pos_ += RECORD_HEADER_SIZE;
+
+    if (key > static_cast<unsigned char>(KeyPressed::error))
+      throw std::runtime_error("The key trace has an unknown key in it");
+    if (file_.size() - pos_ < text_length)
+      throw std::runtime_error("The key trace has been cut off");
+
+    if (static_cast<KeyPressed>(key) == KeyPressed::paste)
+      keys.pushPaste(std::string_view(data + pos_, text_length));
+    else
+      keys.push(static_cast<KeyPressed>(key), c, repeat);
+    pos_ += text_length;
+    n_keys_ += repeat;
+  }
+  return n_events;
+}
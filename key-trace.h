@@ -0,0 +1,155 @@
+/*
+ * File: key-trace.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// test-console includes
+#include <key-buffer.h>
+#include <mapped-file.h>
+
+// STL includes
+#include <string>
+#include <fstream>
+#include <cstddef>
+
+/*
+ * A key trace is a recording of the key presses read from the console, so a
+ * session can be replayed later without anyone at the keyboard. The keys are
+ * stored after decoding, so a trace recorded on one platform replays on any
+ * other.
+ *
+ * The keys are kept in the batches they were read in, so a replay hands the
+ * console the same batches and does the same work. The file starts with an
+ * 8 byte magic number. Each batch is the number of key events in it (4 bytes),
+ * then one record per key event: the key type (1 byte), the char (1 byte), the
+ * repeat count (4 bytes), the length of any pasted text (4 bytes) and then the
+ * text itself.
+ */
+
+/*!
+ * Record key presses to a trace file
+ */
+class KeyTraceWriter
+{
+public:
+
+  /*!
+   * Start a new trace file, replacing any file that's already there
+   * \param path The path of the file
+   * \throws std::runtime_error The file couldn't be created
+   */
+  void open(const std::string& path);
+
+  /*!
+   * Check if a trace is being recorded
+   * \return True if there's a file open
+   */
+  bool isOpen() const { return file_.is_open(); }
+
+  /*!
+   * Add a batch of key presses to the trace. Each batch is written out straight
+   * away, so the trace is complete up to the last keys read even if the program stops
+   * \param keys The key presses to add (all those not yet taken from the buffer). Nothing
+   *             is written if there aren't any
+   * \throws std::runtime_error There was a problem writing to the file
+   */
+  void write(const KeyBuffer& keys);
+
+  /*!
+   * Get the number of key presses recorded
+   * \return The number of key presses, counting each repeat
+   */
+  std::size_t keyCount() const { return n_keys_; }
+
+private:
+
+  //! The trace file
+  std::ofstream file_;
+
+  //! The record being written
+  std::string record_;
+
+  //! The number of key presses recorded
+  std::size_t n_keys_ = 0;
+};
+
+/*!
+ * Read key presses back from a trace file. The file is mapped into memory
+ * rather than read, so even a very long trace opens straight away
+ */
+class KeyTraceReader
+{
+public:
+
+  /*!
+   * Open a trace file
+   * \param path The path of the file
+   * \throws std::runtime_error The file doesn't exist or isn't a key trace
+   */
+  void open(const std::string& path);
+
+  /*!
+   * Check if the trace is open
+   * \return True if there's a file open
+   */
+  bool isOpen() const { return file_.isOpen(); }
+
+  /*!
+   * Check if every key press has been read
+   * \return True if there's nothing more to read
+   */
+  bool atEnd() const { return pos_ >= file_.size(); }
+
+  /*!
+   * Read the next batch of key presses
+   * \retval keys The key presses are added to the end of this
+   * \return The number of key events read, which is 0 at the end of the trace
+   * \throws std::runtime_error The trace has been cut off or has something other than keys in it
+   */
+  std::size_t read(KeyBuffer& keys);
+
+  //! Close the trace, if one is open
+  void close();
+
+  /*!
+   * Get the number of key presses read
+   * \return The number of key presses, counting each repeat
+   */
+  std::size_t keyCount() const { return n_keys_; }
+
+private:
+
+  //! The mapped trace file
+  MappedFile file_;
+
+  //! Where the next batch starts
+  std::size_t pos_ = 0;
+
+  //! The number of key presses read
+  std::size_t n_keys_ = 0;
+};
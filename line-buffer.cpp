@@ -0,0 +1,181 @@
+/*
+ * File: line-buffer.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// test-console includes
+#include <line-buffer.h>
+#include <utf8.h>
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  //! The smallest gap we make when the buffer has to grow
+  const std::size_t MIN_GAP = 64;
+}
+
+// Copy out the line
+std::string LineBuffer::str() const
+{
+  std::string line;
+  line.reserve(size());
+  line.append(before());
+  line.append(after());
+  return line;
+}
+
+// Find the start of the character before pos
+std::size_t LineBuffer::previousChar(std::size_t pos) const
+{
+  pos = std::min(pos, size());
+  if (pos > 0)
+    --pos;
+  while (pos > 0 && isUtf8Continuation(static_cast<unsigned char>((*this)[pos])))
+    --pos;
+  return pos;
+}
+
+// Find the end of the character at pos
+std::size_t LineBuffer::nextChar(std::size_t pos) const
+{
+  std::size_t n = size();
+  if (pos < n)
+    ++pos;
+  while (pos < n && isUtf8Continuation(static_cast<unsigned char>((*this)[pos])))
+    ++pos;
+  return pos;
+}
+
+// Find the start of the word before pos
+std::size_t LineBuffer::previousWord(std::size_t pos) const
+{
+  pos = std::min(pos, size());
+  while (pos > 0 && (*this)[pos - 1] == ' ')
+    --pos;
+  while (pos > 0 && (*this)[pos - 1] != ' ')
+    --pos;
+  return pos;
+}
+
+// Find the end of the word after pos
+std::size_t LineBuffer::nextWord(std::size_t pos) const
+{
+  std::size_t n = size();
+  while (pos < n && (*this)[pos] == ' ')
+    ++pos;
+  while (pos < n && (*this)[pos] != ' ')
+    ++pos;
+  return pos;
+}
+
+// Insert a char (possibly more than once)
+void LineBuffer::insert(char c, std::size_t count /*= 1*/)
+{
+  reserveGap(count);
+  std::fill_n(buffer_.begin() + gap_start_, count, c);
+  gap_start_ += count;
+}
+
+// Insert some text
+void LineBuffer::insert(std::string_view text)
+{
+  reserveGap(text.size());
+  std::copy(text.begin(), text.end(), buffer_.begin() + gap_start_);
+  gap_start_ += text.size();
+}
+
+// Delete the chars before the cursor
+std::size_t LineBuffer::eraseBefore(std::size_t count /*= 1*/)
+{
+  std::size_t n = 0;
+  std::size_t pos = gap_start_;
+  for (; n < count && pos > 0; ++n)
+    pos = previousChar(pos);
+  gap_start_ = pos;
+  return n;
+}
+
+// Delete the chars after the cursor
+std::size_t LineBuffer::eraseAfter(std::size_t count /*= 1*/)
+{
+  std::size_t n = 0;
+  std::size_t pos = gap_start_;
+  for (; n < count && pos < size(); ++n)
+    pos = nextChar(pos);
+  gap_end_ += pos - gap_start_;
+  return n;
+}
+
+// Move the cursor, moving the text it passes to the other side of the gap
+void LineBuffer::moveCursor(std::size_t pos)
+{
+  pos = std::min(pos, size());
+  if (pos < gap_start_)
+  {
+    std::size_t n = gap_start_ - pos;
+    std::memmove(buffer_.data() + gap_end_ - n, buffer_.data() + pos, n);
+    gap_start_ -= n;
+    gap_end_ -= n;
+  }
+  else if (pos > gap_start_)
+  {
+    std::size_t n = pos - gap_start_;
+    std::memmove(buffer_.data() + gap_start_, buffer_.data() + gap_end_, n);
+    gap_start_ += n;
+    gap_end_ += n;
+  }
+}
+
+// Replace the line
+void LineBuffer::assign(std::string_view text)
+{
+  clear();
+  insert(text);
+}
+
+// Empty the line
+void LineBuffer::clear()
+{
+  gap_start_ = 0;
+  gap_end_ = buffer_.size();
+}
+
+// Grow the gap if it's too small
+void LineBuffer::reserveGap(std::size_t n)
+{
+  if (gap_end_ - gap_start_ >= n)
+    return;
+
+  // Grow by at least double, so inserting is O(1) amortised, and move the
+  // text after the gap to the new end
+  std::size_t after_size = buffer_.size() - gap_end_;
+  std::size_t new_size = std::max(buffer_.size() * 2, size() + n + MIN_GAP);
+  buffer_.resize(new_size);
+  std::memmove(buffer_.data() + new_size - after_size, buffer_.data() + gap_end_, after_size);
+  gap_end_ = new_size - after_size;
+}
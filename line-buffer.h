@@ -0,0 +1,184 @@
+/*
+ * File: line-buffer.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// STL includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+/*!
+ * The line being edited, kept as a gap buffer: the text before the cursor is
+ * at the start of the storage, the text after the cursor is at the end, and
+ * the space between them (the gap) is where new text goes. Inserting or
+ * deleting at the cursor doesn't move any other text, and moving the cursor
+ * only moves the text it passes over.
+ *
+ * The text is UTF-8, and positions are in bytes. Moving and deleting goes a
+ * whole character at a time, so the cursor is never part way through one.
+ */
+class LineBuffer
+{
+public:
+
+  /*!
+   * Get the length of the line
+   * \return The number of bytes in the line
+   */
+  std::size_t size() const { return buffer_.size() - (gap_end_ - gap_start_); }
+
+  /*!
+   * Check if the line is empty
+   * \return True if there are no characters in the line
+   */
+  bool empty() const { return size() == 0; }
+
+  /*!
+   * Get the position of the cursor
+   * \return The number of bytes before the cursor
+   */
+  std::size_t cursor() const { return gap_start_; }
+
+  /*!
+   * Get the text before the cursor
+   * \return A view of the text, valid until the line is changed
+   */
+  std::string_view before() const { return std::string_view(buffer_.data(), gap_start_); }
+
+  /*!
+   * Get the text after the cursor
+   * \return A view of the text, valid until the line is changed
+   */
+  std::string_view after() const
+  {
+    return std::string_view(buffer_.data() + gap_end_, buffer_.size() - gap_end_);
+  }
+
+  /*!
+   * Get a character from the line
+   * \param i The position of the character
+   * \return The character
+   */
+  char operator[](std::size_t i) const { return i < gap_start_ ? buffer_[i] : buffer_[i + gap_end_ - gap_start_]; }
+
+  /*!
+   * Get a copy of the whole line
+   * \return The line
+   */
+  std::string str() const;
+
+  /*!
+   * Find where the character before a position starts
+   * \param pos The position to search back from
+   * \return The position of the character, or 0 if there isn't one
+   */
+  std::size_t previousChar(std::size_t pos) const;
+
+  /*!
+   * Find where the character after a position ends
+   * \param pos The position of the character
+   * \return The position just after it, or size() if there isn't one
+   */
+  std::size_t nextChar(std::size_t pos) const;
+
+  /*!
+   * Find where the word before a position starts, skipping any spaces first
+   * \param pos The position to search back from
+   * \return The position of the first character of the word, or 0 if there isn't one
+   */
+  std::size_t previousWord(std::size_t pos) const;
+
+  /*!
+   * Find where the word after a position ends, skipping any spaces first
+   * \param pos The position to search forward from
+   * \return The position just after the last character of the word, or size() if there isn't one
+   */
+  std::size_t nextWord(std::size_t pos) const;
+
+  /*!
+   * Insert a byte at the cursor, leaving the cursor after it
+   * \param c The byte to insert (a character, or part of a UTF-8 sequence inserted a byte at a time)
+   * \param count How many copies of the character to insert (default is 1)
+   */
+  void insert(char c, std::size_t count = 1);
+
+  /*!
+   * Insert some text at the cursor, leaving the cursor after it
+   * \param text The text to insert
+   */
+  void insert(std::string_view text);
+
+  /*!
+   * Delete characters before the cursor (like <Backspace>)
+   * \param count How many characters to delete (default is 1)
+   * \return The number deleted, which is less than count if we reached the start of the line
+   */
+  std::size_t eraseBefore(std::size_t count = 1);
+
+  /*!
+   * Delete characters after the cursor (like <Delete>)
+   * \param count How many characters to delete (default is 1)
+   * \return The number deleted, which is less than count if we reached the end of the line
+   */
+  std::size_t eraseAfter(std::size_t count = 1);
+
+  /*!
+   * Move the cursor
+   * \param pos The new position of the cursor (past the end moves it to the end)
+   */
+  void moveCursor(std::size_t pos);
+
+  /*!
+   * Replace the whole line, leaving the cursor at the end
+   * \param text The new line
+   */
+  void assign(std::string_view text);
+
+  /*!
+   * Empty the line, keeping the storage
+   */
+  void clear();
+
+private:
+
+  /*!
+   * Make sure the gap can hold some more text
+   * \param n The number of characters we need to fit in the gap
+   */
+  void reserveGap(std::size_t n);
+
+  //! The storage for the text and the gap
+  std::vector<char> buffer_;
+
+  //! Where the gap starts (which is where the cursor is)
+  std::size_t gap_start_ = 0;
+
+  //! Where the gap ends (the text after the cursor starts here)
+  std::size_t gap_end_ = 0;
+};
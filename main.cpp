@@ -31,6 +31,7 @@
 // STL includes
 #include <iostream>
 #include <exception>
+#include <string>
 
 // The main program
 int main(int argc, char** argv)
@@ -40,6 +41,21 @@ int main(int argc, char** argv)
   try
   {
     TestConsole cons("test-console ->");
+
+    // An optional argument gives a file to keep the history in,
+    // --record <file> records the keys pressed so the session can be replayed,
+    // and --nodes <image> completes 'ping' from a trie image (see make-trie-image)
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg == "--record" && i + 1 < argc)
+        cons.recordKeys(argv[++i]);
+      else if (arg == "--nodes" && i + 1 < argc)
+        cons.setArgumentImage("ping", 0, argv[++i]);
+      else
+        cons.openHistory(arg);
+    }
+
     ret_val = cons.start();
   }
   catch (std::exception& e)
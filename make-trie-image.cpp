@@ -0,0 +1,94 @@
+/*
+ * File: make-trie-image.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Build a trie image from a list of commands (or argument values), one per
+ * line, for the console to map in with CommandTrie::openImage(). Making the
+ * image when a catalogue is built means the console doesn't insert every
+ * entry each time it starts.
+ *
+ *   make-trie-image <list file> <image file>
+ */
+
+// test-console includes
+#include <trie.h>
+#include <argument-values.h>
+#include <utf8.h>
+
+// STL includes
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <exception>
+
+// The main program
+int main(int argc, char** argv)
+{
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <list file> <image file>\n";
+    return 1;
+  }
+
+  try
+  {
+    std::ifstream list(argv[1]);
+    if (!list.is_open())
+      throw std::runtime_error(std::string("Unable to open ") + argv[1]);
+
+    // Leave out anything that can't be completed, rather than failing the build
+    CommandTrie trie(ArgumentValues::VALID_CHARS);
+    std::size_t n_added = 0;
+    std::size_t n_skipped = 0;
+    for (std::string line; std::getline(list, line);)
+    {
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      if (line.empty() || line.find_first_not_of(ArgumentValues::VALID_CHARS) != std::string::npos ||
+        !isValidUtf8(line))
+      {
+        n_skipped += !line.empty();
+        continue;
+      }
+      trie.insert(line);
+      ++n_added;
+    }
+
+    trie.saveImage(argv[2]);
+    std::cout << "Wrote " << n_added << " entries to " << argv[2];
+    if (n_skipped > 0)
+      std::cout <<  " (left out " << n_skipped << " with spaces, characters that can't be shown or bad UTF-8)";
+    std::cout << "\n";
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
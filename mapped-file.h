@@ -0,0 +1,116 @@
+/*
+ * File: mapped-file.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// Platform specific includes
+#include <console-platform.h>
+
+// STL includes
+#include <string>
+#include <cstddef>
+
+/*!
+ * A file mapped into memory for reading and writing. Changes made through
+ * data() go straight to the file, and the file's size (and the mapping) only
+ * changes when resize() is called. A file can also be opened just for reading,
+ * in which case it must already exist and mustn't be changed through data().
+ * The platform code provides the mapping.
+ */
+class MappedFile
+{
+public:
+
+  //! Create a mapping with no file behind it
+  MappedFile() = default;
+
+  //! Unmap and close the file
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /*!
+   * Open a file (creating it if it doesn't exist) and map all of it
+   * \param path The path of the file
+   * \param read_only True to only read the file, which must already exist (it can't be resized)
+   * \throws std::runtime_error The file couldn't be opened or mapped
+   */
+  void open(const std::string& path, bool read_only = false);
+
+  /*!
+   * Change the size of the file, and map all of it again.
+   * Anything obtained from data() before this is no longer valid
+   * \param size The new size of the file in bytes
+   */
+  void resize(std::size_t size);
+
+  //! Unmap and close the file, if one is open
+  void close();
+
+  /*!
+   * Check if there's a file open
+   * \return True if there's a file open
+   */
+  bool isOpen() const { return is_open_; }
+
+  /*!
+   * Get the mapped contents of the file
+   * \return A pointer to the start of the file, or nullptr if the file is empty
+   */
+  char* data() const { return data_; }
+
+  /*!
+   * Get the size of the file
+   * \return The size of the file (and the mapping) in bytes
+   */
+  std::size_t size() const { return size_; }
+
+private:
+
+  //! Map the whole file (if it isn't empty)
+  void map();
+
+  //! Remove the mapping of the file (if there is one)
+  void unmap();
+
+  //! The open file and anything else the platform needs
+  PlatformFile file_;
+
+  //! Whether a file is open
+  bool is_open_ = false;
+
+  //! Whether the file is only being read
+  bool read_only_ = false;
+
+  //! Where the file is mapped
+  char* data_ = nullptr;
+
+  //! The size of the file
+  std::size_t size_ = 0;
+};
@@ -0,0 +1,77 @@
+/*
+ * File: message-queue.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <message-queue.h>
+
+// STL includes
+#include <utility>
+
+// Create an empty queue
+MessageQueue::MessageQueue() :
+  head_{ &stub_ },
+  tail_{ &stub_ }
+{
+}
+
+// Free anything left in the queue
+MessageQueue::~MessageQueue()
+{
+  std::string message;
+  while (pop(message))
+    ;
+  if (tail_ != &stub_)
+    delete tail_;
+}
+
+// Add a message
+void MessageQueue::push(std::string message)
+{
+  Node* node = new Node;
+  node->message = std::move(message);
+
+  // Becoming the head is the only step producers contend on. The old head
+  // is then linked to us, which is when the consumer can see the message
+  Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+  prev->next.store(node, std::memory_order_release);
+}
+
+// Take the oldest message
+bool MessageQueue::pop(std::string& message)
+{
+  Node* next = tail_->next.load(std::memory_order_acquire);
+  if (next == nullptr)
+    return false;
+
+  // The node holding the message becomes the new tail, and the old tail goes
+  message = std::move(next->message);
+  if (tail_ != &stub_)
+    delete tail_;
+  tail_ = next;
+  return true;
+}
@@ -0,0 +1,91 @@
+/*
+ * File: message-queue.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// STL includes
+#include <atomic>
+#include <string>
+
+/*!
+ * A queue of messages that any number of threads can post to, and one
+ * thread (the console's) takes them from. Posting never takes a lock or
+ * waits for the consumer - the new node is swapped in as the head of a
+ * linked list, and the consumer follows the list from the tail.
+ *
+ * This is Dmitry Vyukov's intrusive MPSC queue. For more info, see:
+ *   https://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+ *
+ * A message is only seen by the consumer once the post that added it has
+ * finished, so a post that's part way through when the consumer looks is
+ * picked up next time.
+ */
+class MessageQueue
+{
+public:
+
+  //! Create an empty queue
+  MessageQueue();
+
+  //! Free any messages that weren't taken
+  ~MessageQueue();
+
+  MessageQueue(const MessageQueue&) = delete;
+  MessageQueue& operator=(const MessageQueue&) = delete;
+
+  /*!
+   * Add a message to the queue (from any thread)
+   * \param message The message
+   */
+  void push(std::string message);
+
+  /*!
+   * Take the oldest message from the queue (only from the consumer thread)
+   * \retval message Set to the message, if there is one
+   * \return False if there were no messages
+   */
+  bool pop(std::string& message);
+
+private:
+
+  //! A message in the queue
+  struct Node
+  {
+    std::atomic<Node*> next{ nullptr };  /*!< The next newer message */
+    std::string message;                 /*!< The message */
+  };
+
+  //! The newest node, which producers add after
+  std::atomic<Node*> head_;
+
+  //! The node before the oldest message, which only the consumer uses
+  Node* tail_;
+
+  //! The node the queue starts with, so it's never empty of nodes
+  Node stub_;
+};
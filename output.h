@@ -0,0 +1,113 @@
+/*
+ * File: output.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// STL includes
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/*!
+ * Small writes to the terminal are slow, especially over a remote link, so
+ * the console collects everything it wants to show for a batch of key presses
+ * in one of these, and the platform code sends it with a single write.
+ * The buffer is cleared, but keeps its storage, after each write.
+ */
+class OutputBuffer
+{
+public:
+
+  /*!
+   * Add text to the buffer
+   * \param text The text to add
+   * \return This buffer, so additions can be chained
+   */
+  OutputBuffer& operator<<(std::string_view text)
+  {
+    buffer_.append(text);
+    return *this;
+  }
+
+  /*!
+   * Add a character to the buffer
+   * \param c The character to add
+   * \return This buffer, so additions can be chained
+   */
+  OutputBuffer& operator<<(char c)
+  {
+    buffer_.push_back(c);
+    return *this;
+  }
+
+  /*!
+   * Add a number to the buffer as text
+   * \param n The number to add
+   * \return This buffer, so additions can be chained
+   */
+  OutputBuffer& operator<<(std::size_t n);
+
+  /*!
+   * Add a character to the buffer a number of times
+   * \param c The character to add
+   * \param n The number of times to add it
+   * \return This buffer, so additions can be chained
+   */
+  OutputBuffer& repeat(char c, std::size_t n)
+  {
+    buffer_.append(n, c);
+    return *this;
+  }
+
+  /*!
+   * Get the text collected
+   * \return A pointer to the text (not null terminated)
+   */
+  const char* data() const { return buffer_.data(); }
+
+  /*!
+   * Get the amount of text collected
+   * \return The number of bytes in the buffer
+   */
+  std::size_t size() const { return buffer_.size(); }
+
+  /*!
+   * Check if there's anything to write
+   * \return True if the buffer is empty
+   */
+  bool empty() const { return buffer_.empty(); }
+
+  /*!
+   * Empty the buffer, keeping its storage for the next batch
+   */
+  void clear() { buffer_.clear(); }
+
+private:
+
+  //! The text to write
+  std::string buffer_;
+};
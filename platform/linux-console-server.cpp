@@ -0,0 +1,769 @@
+/*
+ * File: platform/linux-console-server.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The server waits on epoll rather than poll(), so a worker with hundreds of
+ * sessions only hears about the ones with something to do. See:
+ *   https://man7.org/linux/man-pages/man7/epoll.7.html
+ *
+ * Every worker has the listening sockets in its epoll set with EPOLLEXCLUSIVE,
+ * so a new connection wakes one worker instead of all of them, and that worker
+ * keeps the session. Other threads wake a worker through an eventfd:
+ *   https://man7.org/linux/man-pages/man2/eventfd.2.html
+ *
+ * Telnet clients start in line mode with a local echo, so a telnet session
+ * begins by offering to echo and to suppress go-ahead, which puts the client
+ * in character mode. Commands from the client are taken out of what it sends
+ * before the console sees it. See:
+ *   https://www.rfc-editor.org/rfc/rfc854 and https://www.rfc-editor.org/rfc/rfc857
+ */
+
+// test-console includes
+#include <console-server.h>
+
+// POSIX includes
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <termios.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// STL includes
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace
+{
+  //! The epoll tag of a worker's eventfd
+  constexpr std::uint64_t WAKE_TAG = 0;
+
+  //! The epoll tags of listening sockets have this bit set, with the file descriptor in the low bits
+  constexpr std::uint64_t LISTENER_TAG = std::uint64_t(1) << 63;
+
+  //! Set in a listening socket's tag if its clients use telnet
+  constexpr std::uint64_t USES_TELNET_TAG = std::uint64_t(1) << 62;
+
+  //! The most events to take from epoll at once
+  constexpr int MAX_EVENTS = 64;
+
+  //! The most connections a worker accepts each time it's woken for them
+  constexpr int MAX_ACCEPTS = 8;
+
+  //! Sent to a new session: turn on bracketed paste, as we do for our own terminal
+  const std::string SESSION_START = "\x1b[?2004h";
+
+  //! Sent when a session ends: clear the prompt shown after 'quit' and turn bracketed paste off
+  const std::string SESSION_END = "\r\x1b[K\x1b[?2004l";
+
+  //! The telnet bytes we use (RFC 854)
+  constexpr unsigned char TELNET_SE = 240;    // End of a subnegotiation
+  constexpr unsigned char TELNET_SB = 250;    // Start of a subnegotiation
+  constexpr unsigned char TELNET_WILL = 251;  // WILL, WONT, DO and DONT are followed by an option
+  constexpr unsigned char TELNET_DO = 253;
+  constexpr unsigned char TELNET_DONT = 254;
+  constexpr unsigned char TELNET_IAC = 255;   // Starts a command
+  constexpr unsigned char TELNET_ECHO = 1;    // The echo option
+  constexpr unsigned char TELNET_SGA = 3;     // The suppress go-ahead option
+
+  //! Sent to a telnet client: we'll echo, and neither of us sends go-aheads (i.e. character mode)
+  const std::string TELNET_START = {
+    static_cast<char>(TELNET_IAC), static_cast<char>(TELNET_WILL), static_cast<char>(TELNET_ECHO),
+    static_cast<char>(TELNET_IAC), static_cast<char>(TELNET_WILL), static_cast<char>(TELNET_SGA),
+    static_cast<char>(TELNET_IAC), static_cast<char>(TELNET_DO), static_cast<char>(TELNET_SGA) };
+
+  /*
+   * Takes the telnet commands out of what a client sends, leaving the keys.
+   * Telnet also sends <Enter> as CR LF or CR NUL, and the console would
+   * take the LF as a second <Enter>, so the byte after a CR is dropped too
+   */
+  class TelnetInput
+  {
+  public:
+
+    // Filter the bytes in place, returning how many are left
+    std::size_t filter(char* data, std::size_t n_bytes)
+    {
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < n_bytes; ++i)
+      {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        switch (state_)
+        {
+        case State::data:
+          if (c == TELNET_IAC)
+            state_ = State::command;
+          else if (after_cr_ && (c == '\n' || c == '\0'))
+            after_cr_ = false;
+          else
+          {
+            after_cr_ = c == '\r';
+            data[kept++] = data[i];
+          }
+          break;
+        case State::command:
+          if (c == TELNET_IAC) // An escaped 255, which is never part of UTF-8, so it's dropped
+            state_ = State::data;
+          else if (c >= TELNET_WILL && c <= TELNET_DONT)
+            state_ = State::option;
+          else
+            state_ = c == TELNET_SB ? State::subnegotiation : State::data;
+          break;
+        case State::option:
+          state_ = State::data;
+          break;
+        case State::subnegotiation:
+          if (c == TELNET_IAC)
+            state_ = State::subnegotiation_iac;
+          break;
+        case State::subnegotiation_iac:
+          state_ = c == TELNET_SE ? State::data : State::subnegotiation;
+          break;
+        }
+      }
+      return kept;
+    }
+
+  private:
+
+    //! Where we are in a command
+    enum class State { data, command, option, subnegotiation, subnegotiation_iac };
+
+    State state_ = State::data;
+
+    //! Whether the last key was a CR
+    bool after_cr_ = false;
+  };
+
+  // Check if a line is the 'quit' command
+  bool isQuit(const std::string& line)
+  {
+    auto start = line.find_first_not_of(' ');
+    return start != std::string::npos && line.compare(start, 4, "quit") == 0 &&
+      (start + 4 == line.size() || line[start + 4] == ' ');
+  }
+
+  // Throw the last error, with what we were doing
+  [[noreturn]] void throwError(const std::string& what)
+  {
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+  }
+}
+
+//! One operator's session
+struct ConsoleServer::Session
+{
+  Session(std::uint64_t session_id, int connection, int slave, bool is_socket, bool uses_telnet,
+    const std::string& prompt, std::shared_ptr<CommandRegistry> commands, std::function<void()> wake) :
+    id{ session_id },
+    fd{ connection },
+    pty_slave{ slave },
+    socket{ is_socket },
+    telnet{ uses_telnet },
+    console(prompt, std::move(commands), std::move(wake))
+  {
+  }
+
+  ~Session()
+  {
+    close(fd);
+    if (pty_slave >= 0)
+      close(pty_slave);
+  }
+
+  //! The session's tag in its worker's epoll set
+  std::uint64_t id;
+
+  //! The connection: a socket, or the master side of a pty
+  int fd;
+
+  //! The slave side of a pty, kept open so the pty stays up when the operator detaches (-1 for a socket)
+  int pty_slave;
+
+  //! Whether the connection is a socket
+  bool socket;
+
+  //! Whether the client uses telnet
+  bool telnet;
+
+  //! Takes the telnet commands out of what the client sends
+  TelnetInput telnet_input;
+
+  //! Whether we're waiting for the connection to take more output
+  bool writing = false;
+
+  //! Whether the session ends once its output has been sent
+  bool closing = false;
+
+  //! The console
+  TestConsole console;
+};
+
+//! A worker thread and the sessions it runs
+struct ConsoleServer::Worker
+{
+  explicit Worker(ConsoleServer& owner) : server{ owner }
+  {
+    // The destructor won't run if we throw, so close anything we've opened first
+    try
+    {
+      epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+      if (epoll_fd < 0)
+        throwError("Unable to create an epoll set for a server worker");
+      wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (wake_fd < 0)
+        throwError("Unable to create the wake up eventfd for a server worker");
+      struct epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.u64 = WAKE_TAG;
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) != 0)
+        throwError("Unable to add the wake up eventfd to a server worker");
+    }
+    catch (...)
+    {
+      closeHandles();
+      throw;
+    }
+  }
+
+  ~Worker()
+  {
+    closeHandles();
+  }
+
+  // Close the epoll set and the eventfd
+  void closeHandles()
+  {
+    if (wake_fd >= 0)
+      close(wake_fd);
+    if (epoll_fd >= 0)
+      close(epoll_fd);
+    wake_fd = -1;
+    epoll_fd = -1;
+  }
+
+  // Wake the worker from another thread, to show the messages posted to a session
+  void wake(std::uint64_t id)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      woken.push_back(id);
+    }
+    signal();
+  }
+
+  // Hand the worker a pty session from another thread
+  void adopt(int master, int slave)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      arriving.emplace_back(master, slave);
+    }
+    signal();
+  }
+
+  // Write to the eventfd, which wakes the worker's epoll_wait()
+  void signal()
+  {
+    std::uint64_t one = 1;
+    ssize_t res{ 0 };
+    do
+    {
+      res = write(wake_fd, &one, sizeof(one));
+    } while (res < 0 && errno == EINTR);
+  }
+
+  // Run the sessions until the server stops
+  void run();
+
+  // Start a session on a connection
+  void addSession(int fd, int pty_slave, bool socket, bool telnet);
+
+  // Take everything other threads have handed over since we last looked
+  void takeWoken();
+
+  // Accept a connection on a listening socket
+  void accept(std::uint64_t tag);
+
+  // Handle epoll events for a session
+  void handle(std::uint64_t id, std::uint32_t events);
+
+  // Let a session's console handle what's arrived (and any posted messages), then send what it wrote
+  void run(Session& session);
+
+  // Send what a session's console has written, as far as the connection will take it
+  void send(Session& session);
+
+  // Close a session
+  void remove(std::uint64_t id);
+
+  // Get how long epoll_wait() can wait before a session's partial key needs deciding
+  int nextTimeout() const;
+
+  //! The server the worker is for
+  ConsoleServer& server;
+
+  //! What the worker waits on: its sessions, the listeners and wake_fd
+  int epoll_fd = -1;
+
+  //! Written by other threads to wake the worker
+  int wake_fd = -1;
+
+  //! The thread
+  std::thread thread;
+
+  //! The sessions, by their tags (only touched by the worker's thread)
+  std::unordered_map<std::uint64_t, std::unique_ptr<Session>> sessions;
+
+  //! The sessions holding part of a key, which need a timeout
+  std::unordered_set<std::uint64_t> waiting;
+
+  //! The tag of the next session (tags below this are for the eventfd)
+  std::uint64_t next_id = WAKE_TAG + 1;
+
+  //! Guards woken and arriving
+  std::mutex mutex;
+
+  //! The sessions that have had messages posted
+  std::vector<std::uint64_t> woken;
+
+  //! The ptys handed to the worker (the master and slave sides)
+  std::vector<std::pair<int, int>> arriving;
+};
+
+// Run the sessions
+void ConsoleServer::Worker::run()
+{
+  struct epoll_event events[MAX_EVENTS];
+  while (!server.stopped_.load(std::memory_order_acquire))
+  {
+    int n_events = epoll_wait(epoll_fd, events, MAX_EVENTS, nextTimeout());
+    if (n_events < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      std::cerr << "The console server stopped a worker: epoll_wait failed: " << std::strerror(errno) << "\n";
+      break;
+    }
+
+    for (int i = 0; i < n_events; ++i)
+    {
+      std::uint64_t tag = events[i].data.u64;
+      if (tag == WAKE_TAG)
+        takeWoken();
+      else if (tag & LISTENER_TAG)
+        accept(tag);
+      else
+        handle(tag, events[i].events);
+    }
+
+    // Decide what any partial keys are, if the rest hasn't arrived in time
+    std::vector<std::uint64_t> due;
+    for (auto id : waiting)
+      if (sessions.at(id)->console.inputTimeout() == 0)
+        due.push_back(id);
+    for (auto id : due)
+    {
+      auto it = sessions.find(id);
+      if (it != sessions.end())
+        run(*it->second);
+    }
+  }
+
+  // Closing a session waits for its background commands, which is fine as we're stopping
+  server.n_sessions_.fetch_sub(sessions.size(), std::memory_order_relaxed);
+  sessions.clear();
+  waiting.clear();
+}
+
+// Start a session
+void ConsoleServer::Worker::addSession(int fd, int pty_slave, bool socket, bool telnet)
+{
+  std::uint64_t id = next_id++;
+  std::unique_ptr<Session> session;
+  try
+  {
+    session = std::make_unique<Session>(id, fd, pty_slave, socket, telnet, server.prompt_, server.commands_,
+      [this, id]() { wake(id); });
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "The console server couldn't start a session: " << e.what() << "\n";
+    close(fd);
+    if (pty_slave >= 0)
+      close(pty_slave);
+    return;
+  }
+
+  struct epoll_event event{};
+  event.events = EPOLLIN | EPOLLRDHUP;
+  event.data.u64 = id;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+  {
+    std::cerr << "The console server couldn't wait on a session: " << std::strerror(errno) << "\n";
+    return;
+  }
+
+  Session& s = *session;
+  sessions.emplace(id, std::move(session));
+  server.n_sessions_.fetch_add(1, std::memory_order_relaxed);
+
+  // Get the client ready, then show the prompt
+  if (telnet)
+    s.console.output() += TELNET_START;
+  s.console.output() += SESSION_START;
+  run(s);
+}
+
+// Take what other threads have handed over
+void ConsoleServer::Worker::takeWoken()
+{
+  std::uint64_t count = 0;
+  while (read(wake_fd, &count, sizeof(count)) < 0 && errno == EINTR)
+    ;
+
+  std::vector<std::uint64_t> ids;
+  std::vector<std::pair<int, int>> ptys;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ids.swap(woken);
+    ptys.swap(arriving);
+  }
+
+  for (auto [master, slave] : ptys)
+    addSession(master, slave, false, false);
+
+  // A session may have been posted to more than once, or have gone since
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  for (auto id : ids)
+  {
+    auto it = sessions.find(id);
+    if (it != sessions.end())
+      run(*it->second);
+  }
+}
+
+// Accept a connection
+void ConsoleServer::Worker::accept(std::uint64_t tag)
+{
+  // Only take a few each time, so the other workers get a share of a burst of connections
+  // (but a busy worker still keeps up with them)
+  int listener = static_cast<int>(tag & ~(LISTENER_TAG | USES_TELNET_TAG));
+  for (int n = 0; n < MAX_ACCEPTS; ++n)
+  {
+    int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+      // Another worker may have taken it, or the client gave up
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED)
+        std::cerr << "The console server couldn't accept a connection: " << std::strerror(errno) << "\n";
+      return;
+    }
+
+    // Every key is echoed straight away, so don't hold back small writes
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    addSession(fd, -1, true, (tag & USES_TELNET_TAG) != 0);
+  }
+}
+
+// Handle events for a session
+void ConsoleServer::Worker::handle(std::uint64_t id, std::uint32_t events)
+{
+  auto it = sessions.find(id);
+  if (it == sessions.end())
+    return;
+  Session& s = *it->second;
+
+  if (events & EPOLLOUT)
+  {
+    send(s);
+    if (sessions.find(id) == sessions.end())
+      return;
+  }
+
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+  {
+    // Take one read's worth each time, so a busy session doesn't hold up the others
+    char buffer[4096];
+    ssize_t n_bytes{ 0 };
+    do
+    {
+      n_bytes = read(s.fd, buffer, sizeof(buffer));
+    } while (n_bytes < 0 && errno == EINTR);
+
+    if (n_bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+    if (n_bytes <= 0)
+    {
+      remove(id); // The client has gone
+      return;
+    }
+
+    std::size_t n_keys = static_cast<std::size_t>(n_bytes);
+    if (s.telnet)
+      n_keys = s.telnet_input.filter(buffer, n_keys);
+    if (n_keys > 0)
+    {
+      s.console.receive(buffer, n_keys);
+      run(s);
+    }
+  }
+}
+
+// Handle what's arrived for a session
+void ConsoleServer::Worker::run(Session& s)
+{
+  if (s.closing)
+    return;
+
+  try
+  {
+    for (const auto& line : s.console.processPendingInput())
+    {
+      if (isQuit(line))
+        s.closing = true;
+    }
+  }
+  catch (std::exception& e)
+  {
+    s.console.output() += std::string("There was an error getting the user's input: ") + e.what() + "\r\n";
+    s.closing = true;
+  }
+
+  if (s.closing)
+  {
+    waiting.erase(s.id);
+    s.console.output() += SESSION_END;
+  }
+  else if (s.console.inputTimeout() >= 0)
+    waiting.insert(s.id);
+  else
+    waiting.erase(s.id);
+  send(s);
+}
+
+// Send a session's output
+void ConsoleServer::Worker::send(Session& s)
+{
+  std::string& output = s.console.output();
+  std::size_t sent = 0;
+  while (sent < output.size())
+  {
+    // A client that's gone mustn't kill the server with SIGPIPE
+    ssize_t n_written = s.socket ?
+      ::send(s.fd, output.data() + sent, output.size() - sent, MSG_NOSIGNAL) :
+      write(s.fd, output.data() + sent, output.size() - sent);
+    if (n_written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      remove(s.id);
+      return;
+    }
+    sent += static_cast<std::size_t>(n_written);
+  }
+  output.erase(0, sent);
+
+  // Wait for the connection to take the rest, unless the client has stopped reading altogether
+  bool want_write = !output.empty();
+  if (output.size() > MAX_PENDING_OUTPUT)
+  {
+    remove(s.id);
+    return;
+  }
+  if (!want_write && s.closing)
+  {
+    remove(s.id);
+    return;
+  }
+  if (want_write != s.writing)
+  {
+    struct epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP | (want_write ? static_cast<std::uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = s.id;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, s.fd, &event);
+    s.writing = want_write;
+  }
+}
+
+// Close a session
+void ConsoleServer::Worker::remove(std::uint64_t id)
+{
+  auto it = sessions.find(id);
+  if (it == sessions.end())
+    return;
+
+  std::unique_ptr<Session> session = std::move(it->second);
+  sessions.erase(it);
+  waiting.erase(id);
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->fd, nullptr);
+  server.n_sessions_.fetch_sub(1, std::memory_order_relaxed);
+
+  // The console doesn't wait for its background commands when it goes, so it can go straight away
+}
+
+// Get how long we can wait
+int ConsoleServer::Worker::nextTimeout() const
+{
+  int timeout = -1;
+  for (auto id : waiting)
+  {
+    int wait = sessions.at(id)->console.inputTimeout();
+    if (wait >= 0 && (timeout < 0 || wait < timeout))
+      timeout = wait;
+  }
+  return timeout;
+}
+
+// Start the workers
+ConsoleServer::ConsoleServer(const std::string& prompt, std::shared_ptr<CommandRegistry> commands,
+  unsigned int n_workers) :
+  prompt_{ prompt },
+  commands_{ std::move(commands) }
+{
+  n_workers = std::max(n_workers, 1u);
+  for (unsigned int i = 0; i < n_workers; ++i)
+    workers_.push_back(std::make_unique<Worker>(*this));
+  for (auto& worker : workers_)
+    worker->thread = std::thread([w = worker.get()]() { w->run(); });
+}
+
+// Stop the server
+ConsoleServer::~ConsoleServer()
+{
+  stop();
+}
+
+// Listen on a TCP port
+std::uint16_t ConsoleServer::listen(std::uint16_t port, const std::string& address /*= "127.0.0.1"*/,
+  bool telnet /*= true*/)
+{
+  struct sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+    throw std::runtime_error("'" + address + "' isn't an IPv4 address");
+
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    throwError("Unable to create a socket to listen on");
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  socklen_t addr_length = sizeof(addr);
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+    ::listen(fd, SOMAXCONN) != 0 ||
+    getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_length) != 0)
+  {
+    int error = errno;
+    close(fd);
+    errno = error;
+    throwError("Unable to listen on " + address + ":" + std::to_string(port));
+  }
+
+  // Every worker waits on it, and the kernel only wakes one of them for each connection
+  struct epoll_event event{};
+  event.events = EPOLLIN | EPOLLEXCLUSIVE;
+  event.data.u64 = LISTENER_TAG | (telnet ? USES_TELNET_TAG : 0) | static_cast<std::uint64_t>(fd);
+  for (auto& worker : workers_)
+  {
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+      int error = errno;
+      for (auto& w : workers_)
+        epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+      close(fd);
+      errno = error;
+      throwError("Unable to wait for connections");
+    }
+  }
+  listeners_.push_back(fd);
+  return ntohs(addr.sin_port);
+}
+
+// Open a pty session
+std::string ConsoleServer::openPty()
+{
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0)
+    throwError("Unable to open a pty");
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  fcntl(master, F_SETFD, FD_CLOEXEC);
+
+  char name[128];
+  int slave = -1;
+  if (grantpt(master) == 0 && unlockpt(master) == 0 && ptsname_r(master, name, sizeof(name)) == 0)
+    slave = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (slave < 0)
+  {
+    int error = errno;
+    close(master);
+    errno = error;
+    throwError("Unable to open the other side of a pty");
+  }
+
+  // The pty is the operator's terminal, so it passes every key straight through, as our own terminal does
+  struct termios tbuf{};
+  if (tcgetattr(slave, &tbuf) == 0)
+  {
+    cfmakeraw(&tbuf);
+    tcsetattr(slave, TCSANOW, &tbuf);
+  }
+
+  workers_[next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size()]->adopt(master, slave);
+  return name;
+}
+
+// Stop the workers
+void ConsoleServer::stop()
+{
+  if (stopped_.exchange(true, std::memory_order_acq_rel))
+    return;
+
+  for (auto& worker : workers_)
+    worker->signal();
+  for (auto& worker : workers_)
+  {
+    if (worker->thread.joinable())
+      worker->thread.join();
+  }
+  for (auto fd : listeners_)
+    close(fd);
+  listeners_.clear();
+}
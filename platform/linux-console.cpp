@@ -46,6 +46,27 @@
  * keys with multiple codes are pressed, and perform the right actions.
  * For more info, see:
  *   https://man7.org/linux/man-pages/man4/tty_ioctl.4.html
+ *
+ * Spinning on FIONREAD until a byte arrives keeps a core busy while the
+ * console is idle, so we sleep in poll() until there is something to read
+ * (or the caller's timeout expires). See:
+ *   https://man7.org/linux/man-pages/man2/poll.2.html
+ *
+ * Treating everything that's queued as one key loses input when the user
+ * pastes or types quickly, so we now take everything waiting with a single
+ * read() and split it into keys. Escape sequences follow the ECMA-48 rules
+ * (ESC [ params... final, or ESC O x), and a sequence that's cut off at the
+ * end of the buffer is kept until the next read. A lone ESC is only treated
+ * as the <Esc> key if nothing follows it within a short time.
+ *
+ * Splitting the input into keys and decoding them is done by TerminalDecoder,
+ * which works on bytes alone, so sessions a server runs over sockets decode
+ * the same way (see terminal-decoder.cpp).
+ *
+ * We also turn on bracketed paste mode, so the terminal wraps anything pasted
+ * in ESC [200~ ... ESC [201~ and we can hand the whole block over as one key
+ * press. For more info, see:
+ *   https://invisible-island.net/xterm/ctlseqs/ctlseqs.html#h2-Bracketed-Paste-Mode
  */
 
 // test-console includes
@@ -54,6 +75,9 @@
 
 // POSIX includes
 #include <termios.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <sys/ioctl.h>
 
 // STL includes
@@ -62,37 +86,26 @@
 #include <exception>
 #include <cerrno>
 #include <cstring>
-#include <vector>
-#include <tuple>
 
-namespace
+// Initilalise the platform variables
+void TestConsole::initialisePlatformVariables()
 {
-  std::tuple<KeyPressed, char> handleConsoleKeyEvent(const std::string& input,
-    const std::map<KeyMapping, KeyPressed>& key_map)
+  // Other threads wake us through a pipe. Neither end blocks: a full pipe
+  // already means the console will wake, and we just empty it when it does
+  if (pipe(platform_vars_.wake_pipe) != 0)
+    throw std::runtime_error(std::string("Unable to create the wake up pipe: ") + std::strerror(errno));
+  for (auto fd : platform_vars_.wake_pipe)
   {
-    std::tuple<KeyPressed, char> ret;
-
-    // For now, just check the first character, because we're not
-    // interested in keys that produce multiple values yet
-
-    if (input[0] >= 32 && input[0] <= 126) // ASCII printable characters
-      return std::make_tuple(KeyPressed::alphanum, input[0]);
-
-    auto km = key_map.find(input);
-    if (km != key_map.end())
-      return std::make_tuple(km->second, '\0');
-
-    for (auto c : input)
-      std::cout << "Next char: " << c << ", value: " << (int)c << "\r\n";
-
-    // Return that we don't know the code
-    return std::make_tuple(KeyPressed::undefined, '\0');
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
   }
-}
 
-// Initilalise the platform variables
-void TestConsole::initialisePlatformVariables()
-{
+  // If the input isn't a terminal (e.g. a script is piped in), there are no
+  // terminal settings to change and we read the input as it comes
+  platform_vars_.is_terminal = isatty(0) != 0;
+  if (!platform_vars_.is_terminal)
+    return;
+
   // Save the old state
   if (tcgetattr(0, &(platform_vars_.old_state)) == -1)
     throw std::runtime_error("Unable to save the old console state with tcgetattr()");
@@ -124,53 +137,157 @@ void TestConsole::initialisePlatformVariables()
   if (tcsetattr(0, TCSANOW, &tbuf) == -1)
     throw std::runtime_error("Unable to set new console state with tcsetattr()");
 
-  // Set up the key mappings
-  const std::string tab(1, 9);
-  const std::string ret(1, 13);
-  const std::string esc(1, 27);
-  const std::string bsp(1, 127);
-  
-  key_map_[tab] = KeyPressed::tab;
-  key_map_[ret] = KeyPressed::enter;
-  key_map_[esc + "[3~"] = KeyPressed::del;
-  key_map_[esc + "[A"] = KeyPressed::uparrow;
-  key_map_[esc + "[B"] = KeyPressed::downarrow;
-  key_map_[esc + "[C"] = KeyPressed::rightarrow;
-  key_map_[esc + "[D"] = KeyPressed::leftarrow;
-  key_map_[bsp] = KeyPressed::backspace;
+  // Ask the terminal to mark pasted text so we can insert it in one go
+  std::cout << "\x1b[?2004h" << std::flush;
 }
 
 // This has the linux specific code
-std::vector<std::tuple<KeyPressed, char>> TestConsole::getKeyPresses() const
+void TestConsole::getKeyPresses(KeyBuffer& keys, int timeout_ms /*= -1*/)
 {
-  // The return value
-  std::vector<std::tuple<KeyPressed, char>> ret;
+  // If we're part way through an escape sequence, only wait a short while for the rest of it
+  TerminalDecoder& decoder = platform_vars_.input;
+  int wait_limit = decoder.waitLimit();
+  if (wait_limit >= 0 && (timeout_ms < 0 || timeout_ms > wait_limit))
+    timeout_ms = wait_limit;
 
-  int n_bytes{0};
-  int res={0};
+  // Sleep until stdin is readable, another thread wakes us or we time out
+  struct pollfd pfds[2]{};
+  pfds[0].fd = 0;
+  pfds[0].events = POLLIN;
+  pfds[1].fd = platform_vars_.wake_pipe[0];
+  pfds[1].events = POLLIN;
+  struct pollfd& pfd = pfds[0];
 
-  while (!n_bytes)
+  int res{0};
+  do
   {
-    res = ioctl(0, FIONREAD, &n_bytes);
-    if (res < 0)
-      throw std::runtime_error(std::string("ioctl call failed: ") + std::strerror(errno));
+    res = poll(pfds, 2, timeout_ms);
+  } while (res < 0 && errno == EINTR);
+
+  if (res < 0)
+    throw std::runtime_error(std::string("poll call failed: ") + std::strerror(errno));
+
+  // If we were woken, empty the pipe - the caller shows the posted messages
+  if (pfds[1].revents & POLLIN)
+  {
+    char drain[64];
+    while (read(platform_vars_.wake_pipe[0], drain, sizeof(drain)) > 0)
+      ;
+    if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)))
+      return;
   }
 
-  std::string inp{ "" };
-  for (int i=0; i<n_bytes; ++i)
+  // Nothing arrived before the timeout, so whatever we were holding on to is complete
+  // (unless we've been called without waiting before the rest had time to arrive)
+  if (res == 0)
   {
-    inp += (char)getchar();
+    auto decode_start = ConsoleStats::now();
+    std::size_t n_events = keys.size();
+    decoder.expire(keys);
+    if (keys.size() != n_events)
+      stats_.decoded(decode_start);
+    return;
   }
-  ret.push_back(handleConsoleKeyEvent(inp, key_map_));
-  
-  return ret;
+
+  if (!(pfd.revents & POLLIN) && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)))
+    throw std::runtime_error("The console input has been closed");
+
+  // Take everything that's waiting in one go
+  auto decode_start = ConsoleStats::now();
+  char buffer[PlatformVariables::input_buffer_size];
+  ssize_t n_bytes{0};
+  do
+  {
+    n_bytes = read(0, buffer, sizeof(buffer));
+  } while (n_bytes < 0 && errno == EINTR);
+
+  if (n_bytes < 0)
+    throw std::runtime_error(std::string("read call failed: ") + std::strerror(errno));
+  if (n_bytes == 0)
+    throw std::runtime_error("The console input has been closed");
+
+  decoder.decode(buffer, static_cast<std::size_t>(n_bytes), keys);
+  stats_.decoded(decode_start);
+}
+
+// Get the console input for an event loop
+InputHandle TestConsole::inputHandle() const
+{
+  return 0;
+}
+
+// Get what to wait on in an event loop for posted messages
+InputHandle TestConsole::messageHandle() const
+{
+  return platform_vars_.wake_pipe[0];
+}
+
+// Wake the console from another thread
+void TestConsole::wakeConsole()
+{
+  // If the pipe is full, the console is going to wake anyway
+  char wake = 0;
+  ssize_t res{0};
+  do
+  {
+    res = write(platform_vars_.wake_pipe[1], &wake, 1);
+  } while (res < 0 && errno == EINTR);
+}
+
+// Get how long we can wait for the rest of an escape sequence
+int TestConsole::inputWaitLimit() const
+{
+  return platform_vars_.input.waitLimit();
+}
+
+// Get the width of the terminal
+std::size_t TestConsole::terminalWidth() const
+{
+  struct winsize size{};
+  if (ioctl(1, TIOCGWINSZ, &size) != 0)
+    return 0;
+  return size.ws_col;
+}
+
+// Write out anything in the output buffer
+void TestConsole::flushOutput()
+{
+  const char* data = out_.data();
+  std::size_t remaining = out_.size();
+
+  // Normally this is one write, but we may be interrupted or only get part way
+  while (remaining > 0)
+  {
+    ssize_t n_written = write(1, data, remaining);
+    if (n_written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      out_.clear();
+      throw std::runtime_error(std::string("write call failed: ") + std::strerror(errno));
+    }
+    data += n_written;
+    remaining -= n_written;
+  }
+  out_.clear();
 }
 
 // Handle any resources on closing
 void TestConsole::cleanUpConsole()
 {
-  // Restore the initial console state
-  tcsetattr(0, TCSANOW, &platform_vars_.old_state);
+  // Turn off bracketed paste and restore the initial console state
+  if (platform_vars_.is_terminal)
+  {
+    std::cout << "\x1b[?2004l" << std::flush;
+    tcsetattr(0, TCSANOW, &platform_vars_.old_state);
+  }
+
+  for (auto& fd : platform_vars_.wake_pipe)
+  {
+    if (fd >= 0)
+      close(fd);
+    fd = -1;
+  }
 }
 
 
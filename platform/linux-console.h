@@ -27,15 +27,30 @@
 
 #pragma once
 
+// test-console includes
+#include <platform/linux-file.h>
+#include <terminal-decoder.h>
+
 #include <termios.h>
-#include <string>
 
 //! Define a struct to hold variables needed by the windows console
 struct PlatformVariables
 {
   //! Save the original console mode
   struct termios old_state;
+
+  //! Whether the input is a terminal, rather than (say) a pipe, so we changed its settings
+  bool is_terminal = false;
+
+  //! Turns what we read into key presses, keeping any key that's split across reads
+  TerminalDecoder input;
+
+  //! A pipe that other threads write to, to wake the console when they post a message
+  int wake_pipe[2] = { -1, -1 };
+
+  //! Buffer size for a single read of the input
+  static const unsigned int input_buffer_size = 4096;
 };
 
-//! A key mapping type
-using KeyMapping = std::string;
+//! The console input, for waiting on in an event loop
+using InputHandle = int;
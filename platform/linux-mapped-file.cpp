@@ -0,0 +1,121 @@
+/*
+ * File: platform/linux-mapped-file.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <mapped-file.h>
+
+// Linux includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STL includes
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+// Open and map a file
+void MappedFile::open(const std::string& path, bool read_only /*= false*/)
+{
+  close();
+
+  read_only_ = read_only;
+  file_.fd = ::open(path.c_str(), read_only ? O_RDONLY | O_CLOEXEC : O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (file_.fd < 0)
+    throw std::runtime_error("Unable to open '" + path + "': " + std::strerror(errno));
+  is_open_ = true;
+
+  struct stat st;
+  if (fstat(file_.fd, &st) != 0)
+  {
+    int err = errno;
+    close();
+    throw std::runtime_error("Unable to get the size of '" + path + "': " + std::strerror(err));
+  }
+  size_ = static_cast<std::size_t>(st.st_size);
+
+  try
+  {
+    map();
+  }
+  catch (...)
+  {
+    close();
+    throw;
+  }
+}
+
+// Change the size of the file and map it again
+void MappedFile::resize(std::size_t size)
+{
+  if (!is_open_ || read_only_)
+    throw std::logic_error("Can't resize a mapped file that isn't open for writing");
+
+  unmap();
+  if (ftruncate(file_.fd, static_cast<off_t>(size)) != 0)
+  {
+    // Put back the old mapping so the caller can carry on with what it had
+    map();
+    throw std::runtime_error(std::string("Unable to resize a mapped file: ") + std::strerror(errno));
+  }
+  size_ = size;
+  map();
+}
+
+// Unmap and close the file
+void MappedFile::close()
+{
+  unmap();
+  if (file_.fd >= 0)
+    ::close(file_.fd);
+  file_.fd = -1;
+  is_open_ = false;
+  size_ = 0;
+}
+
+// Map all of the file
+void MappedFile::map()
+{
+  // mmap() won't map nothing
+  if (size_ == 0)
+    return;
+
+  void* addr = mmap(nullptr, size_, read_only_ ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, file_.fd, 0);
+  if (addr == MAP_FAILED)
+    throw std::runtime_error(std::string("Unable to map a file: ") + std::strerror(errno));
+  data_ = static_cast<char*>(addr);
+}
+
+// Remove the mapping
+void MappedFile::unmap()
+{
+  if (data_ != nullptr)
+    munmap(data_, size_);
+  data_ = nullptr;
+}
@@ -0,0 +1,127 @@
+/*
+ * File: platform/replay-console.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * A console with no terminal behind it, for timing the line editor. Instead
+ * of reading the keyboard, it replays a key trace (recorded with
+ * TestConsole::recordKeys()) as fast as the console handles it, in the same
+ * batches the keys were read in. Instead of writing to the terminal, it
+ * counts the bytes that would have been written. When the console closes,
+ * it reports how long the replay took and how much it would have sent.
+ *
+ * The trace to replay is given by the TEST_CONSOLE_TRACE environment
+ * variable, as the console is set up before the program can tell it anything.
+ */
+
+// test-console includes
+#include <console.h>
+#include <platform/replay-console.h>
+#include <key-trace.h>
+
+// STL includes
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <cstdlib>
+#include <chrono>
+
+// Initilalise the platform variables
+void TestConsole::initialisePlatformVariables()
+{
+  const char* path = std::getenv("TEST_CONSOLE_TRACE");
+  if (path == nullptr)
+    throw std::runtime_error("Set TEST_CONSOLE_TRACE to the key trace to replay");
+  platform_vars_.trace = std::make_unique<KeyTraceReader>();
+  platform_vars_.trace->open(path);
+  platform_vars_.start = std::chrono::steady_clock::now();
+}
+
+// Get the next batch of keys from the trace
+void TestConsole::getKeyPresses(KeyBuffer& keys, int /*timeout_ms = -1*/)
+{
+  auto decode_start = ConsoleStats::now();
+  if (platform_vars_.trace->read(keys) == 0)
+    throw std::runtime_error("The replay has finished");
+  stats_.decoded(decode_start);
+}
+
+// There's no input to wait on in an event loop
+InputHandle TestConsole::inputHandle() const
+{
+  return NO_INPUT_HANDLE;
+}
+
+// There's no wake up mechanism to wait on in an event loop
+InputHandle TestConsole::messageHandle() const
+{
+  return NO_INPUT_HANDLE;
+}
+
+// The replay never waits, so it sees posted messages without being woken
+void TestConsole::wakeConsole()
+{
+}
+
+// A key never arrives part way through
+int TestConsole::inputWaitLimit() const
+{
+  return -1;
+}
+
+// There's no screen, so the line is treated as one row (which keeps the byte counts comparable)
+std::size_t TestConsole::terminalWidth() const
+{
+  return 0;
+}
+
+// Count the output instead of writing it
+void TestConsole::flushOutput()
+{
+  if (out_.empty())
+    return;
+  platform_vars_.bytes_out += out_.size();
+  ++platform_vars_.n_flushes;
+  out_.clear();
+}
+
+// Report on the replay
+void TestConsole::cleanUpConsole()
+{
+  if (!platform_vars_.trace || !platform_vars_.trace->isOpen())
+    return;
+
+  auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+    platform_vars_.start).count();
+  std::size_t n_keys = platform_vars_.trace->keyCount();
+  double per_key = n_keys > 0 ? 1.0 / static_cast<double>(n_keys) : 0.0;
+  std::cerr << "Replayed " << n_keys << " keys in " << elapsed << " ms (" << elapsed * 1000.0 * per_key
+    << " us per key)\n"
+    << "Output: " << platform_vars_.bytes_out << " bytes in " << platform_vars_.n_flushes << " writes ("
+    << static_cast<double>(platform_vars_.bytes_out) * per_key << " bytes per key)\n";
+  platform_vars_.trace->close();
+}
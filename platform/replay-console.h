@@ -0,0 +1,75 @@
+/*
+ * File: platform/replay-console.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// test-console includes
+#ifdef _WIN32
+#include <platform/windows-file.h>
+#else
+#include <platform/linux-file.h>
+#endif
+
+// STL includes
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+// The trace reader maps its file, and the file mapping needs this header, so
+// it's only declared here
+class KeyTraceReader;
+
+//! Define a struct to hold variables needed by the replay console
+struct PlatformVariables
+{
+  //! The key trace being replayed
+  std::unique_ptr<KeyTraceReader> trace;
+
+  //! The number of bytes that would have gone to the terminal
+  std::size_t bytes_out = 0;
+
+  //! The number of times the output was flushed (each would be a write to the terminal)
+  std::size_t n_flushes = 0;
+
+  //! When the replay started
+  std::chrono::steady_clock::time_point start;
+};
+
+//! The console input, for waiting on in an event loop
+#ifdef _WIN32
+using InputHandle = HANDLE;
+#else
+using InputHandle = int;
+#endif
+
+//! There's nothing to wait on when replaying, as the input is always ready
+#ifdef _WIN32
+inline const InputHandle NO_INPUT_HANDLE = INVALID_HANDLE_VALUE;
+#else
+inline const InputHandle NO_INPUT_HANDLE = -1;
+#endif
@@ -35,48 +35,118 @@
 // test-console includes
 #include <console.h>
 #include <platform/windows-console.h>
+#include <utf8.h>
 
 // MS includes
 #include <Windows.h>
 
+// Older SDKs don't define the flag for escape sequence processing
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
 // STL includes
-#include <iostream>
 #include <string>
 #include <exception>
 #include <vector>
 #include <tuple>
+#include <array>
 
 // Functions to handle the events
 namespace
 {
 
+  // Build the table of what each virtual key code means, for keys that aren't printable
+  constexpr std::array<KeyPressed, 256> makeVirtualKeys()
+  {
+    std::array<KeyPressed, 256> keys{};
+    for (auto& k : keys)
+      k = KeyPressed::undefined;
+    keys[VK_BACK] = KeyPressed::backspace;
+    keys[VK_TAB] = KeyPressed::tab;
+    keys[VK_RETURN] = KeyPressed::enter;
+    keys[VK_ESCAPE] = KeyPressed::cancel;
+    keys[VK_PRIOR] = KeyPressed::pageup;
+    keys[VK_NEXT] = KeyPressed::pagedown;
+    keys[VK_END] = KeyPressed::end;
+    keys[VK_HOME] = KeyPressed::home;
+    keys[VK_LEFT] = KeyPressed::leftarrow;
+    keys[VK_UP] = KeyPressed::uparrow;
+    keys[VK_RIGHT] = KeyPressed::rightarrow;
+    keys[VK_DOWN] = KeyPressed::downarrow;
+    keys[VK_DELETE] = KeyPressed::del;
+    for (int f = VK_F1; f <= VK_F24; ++f)
+      keys[f] = KeyPressed::function;
+    // Letters only get this far when Ctrl stops them being printable
+    keys['R'] = KeyPressed::search;
+    keys['G'] = KeyPressed::cancel;
+    return keys;
+  }
+
+  //! What each virtual key code means
+  constexpr std::array<KeyPressed, 256> VIRTUAL_KEYS = makeVirtualKeys();
+
   // Handle the key press events
-  std::tuple<KeyPressed, char, unsigned int> HandleConsoleKeyEvent(KEY_EVENT_RECORD ke, 
-    const std::map<KeyMapping, KeyPressed>& key_map)
+  std::tuple<KeyPressed, char, unsigned int> HandleConsoleKeyEvent(KEY_EVENT_RECORD ke)
   {
     // Handle keys if they are down
     if (ke.bKeyDown)
     {
       // If it's in the ASCII printable range, print it (maybe multiple times
       // based on repeat count)
-      if (ke.uChar.AsciiChar >= 32 && ke.uChar.AsciiChar <= 126)
-        return std::make_tuple(KeyPressed::alphanum, ke.uChar.AsciiChar, ke.wRepeatCount);
+      if (ke.uChar.UnicodeChar >= 32 && ke.uChar.UnicodeChar <= 126)
+        return std::make_tuple(KeyPressed::alphanum, static_cast<char>(ke.uChar.UnicodeChar), ke.wRepeatCount);
       
-      auto key = key_map.find(ke.wVirtualKeyCode);
-      if (key != key_map.end())
-      {
-        return std::make_tuple(key->second, '\0', ke.wRepeatCount);
-      }
-      std::cout << "\nKey code: " << ke.wVirtualKeyCode << "\n";
+      KeyPressed key = ke.wVirtualKeyCode < VIRTUAL_KEYS.size() ? VIRTUAL_KEYS[ke.wVirtualKeyCode] :
+        KeyPressed::undefined;
+
+      // Holding Ctrl (or Alt) with the left or right arrow moves by words
+      bool ctrl = (ke.dwControlKeyState & (LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED |
+        LEFT_ALT_PRESSED | RIGHT_ALT_PRESSED)) != 0;
+      if (ctrl && key == KeyPressed::leftarrow)
+        key = KeyPressed::wordleft;
+      else if (ctrl && key == KeyPressed::rightarrow)
+        key = KeyPressed::wordright;
+
+      if (key == KeyPressed::function)
+        return std::make_tuple(key, static_cast<char>(ke.wVirtualKeyCode - VK_F1 + 1), ke.wRepeatCount);
+      if (key != KeyPressed::undefined)
+        return std::make_tuple(key, '\0', ke.wRepeatCount);
     }
    
     return std::make_tuple(KeyPressed::undefined, '\0', 0);
   }
 
-  // Handle resize events - no plans to do anything with this at the moment
-  void HandleConsoleResizeEvent(WINDOW_BUFFER_SIZE_RECORD wbs)
+  // Handle a key press for a character outside ASCII, adding it to the line as UTF-8 bytes
+  // Characters past U+FFFF come as two UTF-16 events, so the first half waits in high_surrogate
+  void HandleConsoleCharEvent(KEY_EVENT_RECORD ke, wchar_t& high_surrogate, KeyBuffer& keys)
+  {
+    wchar_t w = ke.uChar.UnicodeChar;
+    char32_t c = w;
+    if (w >= 0xD800 && w <= 0xDBFF)
+    {
+      high_surrogate = w;
+      return;
+    }
+    if (w >= 0xDC00 && w <= 0xDFFF)
+    {
+      if (high_surrogate == 0)
+        return;
+      c = 0x10000 + ((static_cast<char32_t>(high_surrogate) - 0xD800) << 10) + (w - 0xDC00);
+    }
+    high_surrogate = 0;
+
+    char bytes[UTF8_MAX_BYTES];
+    std::size_t n_bytes = encodeUtf8(c, bytes);
+    for (unsigned int r = 0; r < ke.wRepeatCount; ++r)
+      for (std::size_t i = 0; i < n_bytes; ++i)
+        keys.push(KeyPressed::alphanum, bytes[i]);
+  }
+
+  // Handle resize events - no plans to do anything with this at the moment. Nothing's
+  // written, as all the output goes through the renderer, which keeps track of the screen
+  void HandleConsoleResizeEvent(WINDOW_BUFFER_SIZE_RECORD)
   {
-    std::cout << "Resize event!\n";
   }
 }
 
@@ -90,35 +160,55 @@ void TestConsole::initialisePlatformVariables()
   if (!GetConsoleMode(platform_vars_.stdcin_handle, &platform_vars_.old_console_mode))
     throw std::runtime_error("Unable to get the console mode");
 
+  // Get a handle to stdout so we can write to it directly
+  platform_vars_.stdcout_handle = GetStdHandle(STD_OUTPUT_HANDLE);
+  if (INVALID_HANDLE_VALUE == platform_vars_.stdcout_handle)
+    throw std::runtime_error("Unable to get standard output handle for the console");
+
+  // The line renderer moves the cursor with ANSI escape sequences, so ask the
+  // console to process them (Windows 10 and later)
+  if (!GetConsoleMode(platform_vars_.stdcout_handle, &platform_vars_.old_output_mode))
+    throw std::runtime_error("Unable to get the console output mode");
+  if (!SetConsoleMode(platform_vars_.stdcout_handle,
+    platform_vars_.old_output_mode | ENABLE_PROCESSED_OUTPUT | ENABLE_VIRTUAL_TERMINAL_PROCESSING))
+    throw std::runtime_error("Unable to turn on escape sequence processing for the console");
+
+  // The line is kept as UTF-8, so have the console show it as that
+  platform_vars_.old_output_cp = GetConsoleOutputCP();
+  if (!SetConsoleOutputCP(CP_UTF8))
+    throw std::runtime_error("Unable to set the console output to UTF-8");
+
   // Set our console mode. We add the mouse in case we need it
   if (!SetConsoleMode(platform_vars_.stdcin_handle, ENABLE_WINDOW_INPUT | ENABLE_MOUSE_INPUT))
     throw std::runtime_error("Unable to set the new console mode");
 
-  // Initialise the key mapping
-  key_map_[8] = KeyPressed::backspace;
-  key_map_[9] = KeyPressed::tab;
-  key_map_[13] = KeyPressed::enter;
-  key_map_[37] = KeyPressed::leftarrow;
-  key_map_[38] = KeyPressed::uparrow;
-  key_map_[39] = KeyPressed::rightarrow;
-  key_map_[40] = KeyPressed::downarrow;
-  key_map_[46] = KeyPressed::del;
+  // Other threads wake us with an event when they post a message
+  platform_vars_.wake_event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+  if (platform_vars_.wake_event == nullptr)
+    throw std::runtime_error("Unable to create the wake up event");
 }
 
 // This handles the windows specific code
-std::vector<std::tuple<KeyPressed, char>> TestConsole::getKeyPresses() const
+void TestConsole::getKeyPresses(KeyBuffer& keys, int timeout_ms /*= -1*/)
 {
-  // The return value
-  std::vector<std::tuple<KeyPressed, char>> ret;
+  // Sleep until there are events in the input buffer, another thread wakes us, or we time out
+  HANDLE handles[2] = { platform_vars_.stdcin_handle, platform_vars_.wake_event };
+  DWORD wait_res = WaitForMultipleObjects(2, handles, FALSE,
+    timeout_ms < 0 ? INFINITE : static_cast<DWORD>(timeout_ms));
+  if (wait_res == WAIT_TIMEOUT || wait_res == WAIT_OBJECT_0 + 1)
+    return;
+  if (wait_res != WAIT_OBJECT_0)
+    throw std::runtime_error("WaitForMultipleObjects failed on the console input!");
 
   // Buffer to get events from the queue
+  auto decode_start = ConsoleStats::now();
   INPUT_RECORD event_buffer[PlatformVariables::input_buffer_size];
 
   // The number of events returned in the buffer
   DWORD n_events_read = 0;
   
-  // Get any queued events, or wait for one
-  if (!ReadConsoleInput(platform_vars_.stdcin_handle,
+  // Get the queued events
+  if (!ReadConsoleInputW(platform_vars_.stdcin_handle,
     event_buffer,
     PlatformVariables::input_buffer_size,
     &n_events_read))
@@ -131,8 +221,14 @@ std::vector<std::tuple<KeyPressed, char>> TestConsole::getKeyPresses() const
     {
     case KEY_EVENT: // Handle keyboard inputs
       {
-        auto [kp, c, rep] = HandleConsoleKeyEvent(event_buffer[i].Event.KeyEvent, key_map_);
-        ret.insert(ret.end(), rep, std::make_tuple(kp, c));
+        const KEY_EVENT_RECORD& ke = event_buffer[i].Event.KeyEvent;
+        if (ke.bKeyDown && ke.uChar.UnicodeChar >= 0x80)
+        {
+          HandleConsoleCharEvent(ke, platform_vars_.high_surrogate, keys);
+          break;
+        }
+        auto [kp, c, rep] = HandleConsoleKeyEvent(ke);
+        keys.push(kp, c, rep);
         break;
       }
     case MOUSE_EVENT: // Handle mouse inputs
@@ -150,8 +246,65 @@ std::vector<std::tuple<KeyPressed, char>> TestConsole::getKeyPresses() const
       break;
     }
   }
-  
-  return ret;
+  stats_.decoded(decode_start);
+}
+
+// Get the console input for an event loop
+InputHandle TestConsole::inputHandle() const
+{
+  return platform_vars_.stdcin_handle;
+}
+
+// Get what to wait on in an event loop for posted messages
+InputHandle TestConsole::messageHandle() const
+{
+  return platform_vars_.wake_event;
+}
+
+// Wake the console from another thread
+void TestConsole::wakeConsole()
+{
+  SetEvent(platform_vars_.wake_event);
+}
+
+// Key presses always arrive whole, so there's never anything partial to wait for
+int TestConsole::inputWaitLimit() const
+{
+  return -1;
+}
+
+// Get the width of the console's screen buffer, which is where lines wrap
+std::size_t TestConsole::terminalWidth() const
+{
+  CONSOLE_SCREEN_BUFFER_INFO info;
+  if (!GetConsoleScreenBufferInfo(platform_vars_.stdcout_handle, &info) || info.dwSize.X <= 0)
+    return 0;
+  return static_cast<std::size_t>(info.dwSize.X);
+}
+
+// Write out anything in the output buffer
+void TestConsole::flushOutput()
+{
+  const char* data = out_.data();
+  std::size_t remaining = out_.size();
+
+  // Normally this is one write, but the console may take less than we give it
+  while (remaining > 0)
+  {
+    DWORD n_written = 0;
+    DWORD n_to_write = remaining > MAXDWORD ? MAXDWORD : static_cast<DWORD>(remaining);
+
+    // WriteConsole only works for a real console, so fall back to WriteFile if the output is redirected
+    if (!WriteConsoleA(platform_vars_.stdcout_handle, data, n_to_write, &n_written, nullptr) &&
+      !WriteFile(platform_vars_.stdcout_handle, data, n_to_write, &n_written, nullptr))
+    {
+      out_.clear();
+      throw std::runtime_error("Writing to the console failed!");
+    }
+    data += n_written;
+    remaining -= n_written;
+  }
+  out_.clear();
 }
 
 // Handle any resources on closing
@@ -159,4 +312,11 @@ void TestConsole::cleanUpConsole()
 {
   // Restore the old console settings
   SetConsoleMode(platform_vars_.stdcin_handle, platform_vars_.old_console_mode);
+  SetConsoleMode(platform_vars_.stdcout_handle, platform_vars_.old_output_mode);
+  if (platform_vars_.old_output_cp != 0)
+    SetConsoleOutputCP(platform_vars_.old_output_cp);
+
+  if (platform_vars_.wake_event != nullptr)
+    CloseHandle(platform_vars_.wake_event);
+  platform_vars_.wake_event = nullptr;
 }
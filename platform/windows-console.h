@@ -27,6 +27,9 @@
 
 #pragma once
 
+// test-console includes
+#include <platform/windows-file.h>
+
 // MS includes
 #include <Windows.h>
 
@@ -38,10 +41,25 @@ struct PlatformVariables
 
   //! A handle to stdin
   HANDLE stdcin_handle;
+
+  //! A handle to stdout
+  HANDLE stdcout_handle;
+
+  //! Save the original console output mode
+  DWORD old_output_mode;
+
+  //! Save the original console output code page
+  UINT old_output_cp = 0;
+
+  //! The first half of a character past U+FFFF, until the second half is read
+  wchar_t high_surrogate = 0;
+
+  //! Set by other threads to wake the console when they post a message
+  HANDLE wake_event = nullptr;
   
   //! Buffer size for input events
   static const unsigned int input_buffer_size = 128;
 };
 
-//! Key mappings type
-using KeyMapping = WORD;
+//! The console input, for waiting on in an event loop
+using InputHandle = HANDLE;
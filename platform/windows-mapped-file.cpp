@@ -0,0 +1,127 @@
+/*
+ * File: platform/windows-mapped-file.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <mapped-file.h>
+
+// STL includes
+#include <stdexcept>
+
+// Open and map a file
+void MappedFile::open(const std::string& path, bool read_only /*= false*/)
+{
+  close();
+
+  read_only_ = read_only;
+  file_.file = CreateFileA(path.c_str(), read_only ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                           nullptr, read_only ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_.file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Unable to open '" + path + "'");
+  is_open_ = true;
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_.file, &file_size))
+  {
+    close();
+    throw std::runtime_error("Unable to get the size of '" + path + "'");
+  }
+  size_ = static_cast<std::size_t>(file_size.QuadPart);
+
+  try
+  {
+    map();
+  }
+  catch (...)
+  {
+    close();
+    throw;
+  }
+}
+
+// Change the size of the file and map it again
+void MappedFile::resize(std::size_t size)
+{
+  if (!is_open_ || read_only_)
+    throw std::logic_error("Can't resize a mapped file that isn't open for writing");
+
+  // The file can't change size while it's mapped
+  unmap();
+  LARGE_INTEGER new_size;
+  new_size.QuadPart = static_cast<LONGLONG>(size);
+  if (!SetFilePointerEx(file_.file, new_size, nullptr, FILE_BEGIN) || !SetEndOfFile(file_.file))
+  {
+    // Put back the old mapping so the caller can carry on with what it had
+    map();
+    throw std::runtime_error("Unable to resize a mapped file");
+  }
+  size_ = size;
+  map();
+}
+
+// Unmap and close the file
+void MappedFile::close()
+{
+  unmap();
+  if (file_.file != INVALID_HANDLE_VALUE)
+    CloseHandle(file_.file);
+  file_.file = INVALID_HANDLE_VALUE;
+  is_open_ = false;
+  size_ = 0;
+}
+
+// Map all of the file
+void MappedFile::map()
+{
+  // A mapping of an empty file isn't allowed
+  if (size_ == 0)
+    return;
+
+  file_.mapping = CreateFileMappingA(file_.file, nullptr, read_only_ ? PAGE_READONLY : PAGE_READWRITE, 0, 0, nullptr);
+  if (file_.mapping == nullptr)
+    throw std::runtime_error("Unable to create a file mapping");
+
+  void* addr = MapViewOfFile(file_.mapping, read_only_ ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, size_);
+  if (addr == nullptr)
+  {
+    CloseHandle(file_.mapping);
+    file_.mapping = nullptr;
+    throw std::runtime_error("Unable to map a file");
+  }
+  data_ = static_cast<char*>(addr);
+}
+
+// Remove the mapping
+void MappedFile::unmap()
+{
+  if (data_ != nullptr)
+    UnmapViewOfFile(data_);
+  data_ = nullptr;
+  if (file_.mapping != nullptr)
+    CloseHandle(file_.mapping);
+  file_.mapping = nullptr;
+}
@@ -0,0 +1,302 @@
+/*
+ * File: renderer.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// test-console includes
+#include <renderer.h>
+#include <utf8.h>
+
+// STL includes
+#include <algorithm>
+
+namespace
+{
+  //! Moves this short or shorter are cheaper with backspaces (or reprinting) than an escape sequence
+  const std::size_t SHORT_MOVE = 3;
+
+  //! Rewriting an unchanged end of the line this short or shorter is cheaper than inserting or deleting characters
+  const std::size_t SHORT_EDIT = 4;
+}
+
+// Show a line, only sending what's changed
+void LineRenderer::render(const LineBuffer& line, OutputBuffer& out)
+{
+  // Find where the new line starts to differ from what's shown, looking
+  // at the text before the cursor and then the text after it
+  std::string_view shown(shown_);
+  std::string_view before = line.before();
+  std::string_view after = line.after();
+  std::size_t same = std::mismatch(before.begin(), before.end(), shown.begin(),
+    shown.begin() + std::min(shown.size(), before.size())).first - before.begin();
+  if (same == before.size() && shown.size() > same)
+  {
+    std::string_view shown_after = shown.substr(same);
+    same += std::mismatch(after.begin(), after.begin() + std::min(after.size(), shown_after.size()),
+      shown_after.begin()).first - after.begin();
+  }
+
+  // Redraw from the start of a character, if they differ part way through one
+  while (same > 0 && ((same < shown.size() && isUtf8Continuation(static_cast<unsigned char>(shown[same]))) ||
+    (same < line.size() && isUtf8Continuation(static_cast<unsigned char>(line[same])))))
+  {
+    --same;
+  }
+
+  // If nothing's changed, we only need to move the cursor
+  std::size_t shown_size = shown_.size();
+  if (same == shown_size && same == line.size())
+  {
+    moveCursor(line.cursor(), out);
+    return;
+  }
+
+  // Find how much of the end is the same too, without overlapping the start
+  std::size_t tail = 0;
+  std::size_t tail_limit = std::min(shown_size, line.size()) - same;
+  while (tail < tail_limit && shown[shown_size - 1 - tail] == line[line.size() - 1 - tail])
+    ++tail;
+  while (tail > 0 && isUtf8Continuation(static_cast<unsigned char>(shown[shown_size - tail])))
+    --tail;
+
+  // If the end is worth keeping, and the line stays on one row, insert or delete
+  // characters (ESC[n@ / ESC[nP) to move it along the screen, and only write the
+  // text in between. Otherwise write everything after the change
+  std::size_t old_width = displayWidth(shown.substr(same, shown_size - tail - same));
+  std::size_t new_width = rangeWidth(line, same, line.size() - tail);
+  bool one_row = width_ == 0;
+  if (!one_row && tail > SHORT_EDIT)
+  {
+    // The line is widest while the text in between is changing, and mustn't reach the last column
+    std::size_t widest = displayWidth(shown.substr(0, same)) + std::max(old_width, new_width) +
+      displayWidth(shown.substr(shown_size - tail));
+    one_row = start_column_ % width_ + widest < width_;
+  }
+  if (tail > SHORT_EDIT && one_row)
+  {
+    moveCursor(same, out);
+    if (new_width > old_width)
+      out << "\x1b[" << (new_width - old_width) << '@';
+    writeRange(line, same, line.size() - tail, out);
+    if (old_width > new_width)
+      out << "\x1b[" << (old_width - new_width) << 'P';
+    shown_.erase(same, shown_size - tail - same);
+    insertRange(line, same, line.size() - tail);
+    cursor_pos_ = line.size() - tail;
+  }
+  else
+  {
+    // Clear the end of the line if the old text went further along the screen. When we
+    // know the width, everything after the change is cleared before it's written, as the
+    // old text may be on the rows below, and a wide character that doesn't fit at the end
+    // of a row goes on the next one without clearing the last column
+    moveCursor(same, out);
+    old_width = displayWidth(shown.substr(same));
+    if (width_ != 0 && old_width > 0)
+      out << "\x1b[J";
+    writeRange(line, same, line.size(), out);
+    shown_.resize(same);
+    insertRange(line, same, line.size());
+    new_width = displayWidth(std::string_view(shown_).substr(same));
+    cursor_pos_ = line.size();
+
+    if (width_ == 0)
+    {
+      if (old_width > new_width)
+        out << "\x1b[K";
+    }
+    else if (new_width > 0 && screenPosition(shown_.size()).column == 0)
+    {
+      // Filling the last column leaves the terminal's cursor there until the next
+      // character is written, so go on to the next row to be where we think we are
+      out << "\r\n";
+    }
+  }
+
+  moveCursor(line.cursor(), out);
+}
+
+// Write part of a line
+void LineRenderer::writeRange(const LineBuffer& line, std::size_t start, std::size_t end, OutputBuffer& out)
+{
+  std::string_view before = line.before();
+  std::string_view after = line.after();
+  if (start < before.size())
+    out << before.substr(start, std::min(end, before.size()) - start);
+  if (end > before.size())
+  {
+    std::size_t after_start = std::max(start, before.size()) - before.size();
+    out << after.substr(after_start, end - before.size() - after_start);
+  }
+}
+
+// Get the width of part of a line
+std::size_t LineRenderer::rangeWidth(const LineBuffer& line, std::size_t start, std::size_t end)
+{
+  // The gap is always between characters, so each side can be measured on its own
+  std::string_view before = line.before();
+  std::string_view after = line.after();
+  std::size_t width = 0;
+  if (start < before.size())
+    width += displayWidth(before.substr(start, std::min(end, before.size()) - start));
+  if (end > before.size())
+  {
+    std::size_t after_start = std::max(start, before.size()) - before.size();
+    width += displayWidth(after.substr(after_start, end - before.size() - after_start));
+  }
+  return width;
+}
+
+// Put part of a line into what's shown
+void LineRenderer::insertRange(const LineBuffer& line, std::size_t start, std::size_t end)
+{
+  std::string_view before = line.before();
+  std::string_view after = line.after();
+  std::size_t pos = start;
+  if (start < before.size())
+  {
+    std::string_view part = before.substr(start, std::min(end, before.size()) - start);
+    shown_.insert(pos, part);
+    pos += part.size();
+  }
+  if (end > before.size())
+  {
+    std::size_t after_start = std::max(start, before.size()) - before.size();
+    shown_.insert(pos, after.substr(after_start, end - before.size() - after_start));
+  }
+}
+
+// Forget what's shown
+void LineRenderer::reset(std::size_t start_column /*= 0*/, std::size_t width /*= 0*/)
+{
+  shown_.clear();
+  cursor_pos_ = 0;
+  start_column_ = start_column;
+  width_ = width;
+}
+
+// Move on to a new row after the line
+void LineRenderer::finishLine(OutputBuffer& out)
+{
+  moveCursor(shown_.size(), out);
+
+  // A line that fills its last row has already gone on to the next one
+  if (width_ == 0 || shown_.empty() || screenPosition(shown_.size()).column != 0)
+    out << "\r\n";
+  reset();
+}
+
+// Take the prompt and line off the screen
+void LineRenderer::erase(OutputBuffer& out)
+{
+  if (width_ == 0)
+    out << "\r\x1b[K";
+  else
+  {
+    std::size_t row = screenPosition(cursor_pos_).row;
+    if (row > 0)
+      out << "\x1b[" << row << 'A';
+    out << "\r\x1b[J";
+  }
+  reset();
+}
+
+// Find where a position is on the screen
+LineRenderer::ScreenPosition LineRenderer::screenPosition(std::size_t pos) const
+{
+  // Walk the characters, as one that doesn't fit at the end of a row goes on the next
+  ScreenPosition screen{ start_column_ / width_, start_column_ % width_ };
+  std::size_t i = 0;
+  while (i < pos)
+  {
+    std::size_t length = 1;
+    auto c = static_cast<unsigned char>(shown_[i]);
+    std::size_t width = c >= 0x20 && c < 0x7F ? 1 : charWidth(decodeUtf8(shown_, i, length));
+    i += length;
+    if (width == 0)
+      continue;
+    if (screen.column + width > width_)
+    {
+      ++screen.row;
+      screen.column = 0;
+    }
+    screen.column += width;
+  }
+
+  // A full row puts the next character at the start of the one below
+  if (screen.column >= width_)
+  {
+    ++screen.row;
+    screen.column = 0;
+  }
+  return screen;
+}
+
+// Move the cursor along the line
+void LineRenderer::moveCursor(std::size_t new_pos, OutputBuffer& out)
+{
+  // Positions are in bytes, but the cursor moves in columns (and rows, if we know where the line wraps)
+  std::size_t back = 0;
+  std::size_t forward = 0;
+  bool same_row = true;
+  if (width_ == 0)
+  {
+    if (new_pos < cursor_pos_)
+      back = displayWidth(std::string_view(shown_).substr(new_pos, cursor_pos_ - new_pos));
+    else
+      forward = displayWidth(std::string_view(shown_).substr(cursor_pos_, new_pos - cursor_pos_));
+  }
+  else
+  {
+    ScreenPosition from = screenPosition(cursor_pos_);
+    ScreenPosition to = screenPosition(new_pos);
+    if (to.row < from.row)
+      out << "\x1b[" << (from.row - to.row) << 'A';
+    else if (to.row > from.row)
+      out << "\x1b[" << (to.row - from.row) << 'B';
+    same_row = to.row == from.row;
+    if (to.column < from.column)
+      back = from.column - to.column;
+    else
+      forward = to.column - from.column;
+  }
+
+  if (back > 0)
+  {
+    if (back <= SHORT_MOVE)
+      out.repeat('\b', back);
+    else
+      out << "\x1b[" << back << 'D';
+  }
+  else if (forward > 0)
+  {
+    // Reprinting what's already there moves the cursor forward too, as long as it stays on the row
+    if (forward <= SHORT_MOVE && same_row)
+      out << std::string_view(shown_).substr(cursor_pos_, new_pos - cursor_pos_);
+    else
+      out << "\x1b[" << forward << 'C';
+  }
+  cursor_pos_ = new_pos;
+}
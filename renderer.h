@@ -0,0 +1,152 @@
+/*
+ * File: renderer.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// test-console includes
+#include <output.h>
+#include <line-buffer.h>
+
+// STL includes
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/*!
+ * Redrawing the whole line after the cursor for every edit (and moving back
+ * with a backspace per character) sends a lot of output for long lines, so
+ * the renderer remembers what's on the screen after the prompt and where the
+ * cursor is. Each time the line changes it only sends the part that's
+ * different, using ANSI cursor movement (ESC[nD / ESC[nC) and clearing the
+ * end of the line (ESC[K) if it got shorter. When the end of the line hasn't
+ * changed either (e.g. a character typed or deleted in the middle), it's moved
+ * along the screen by inserting or deleting characters (ESC[n@ / ESC[nP), so
+ * only the text that changed is sent.
+ *
+ * Those movements stop at the edge of the screen, so when the terminal's width
+ * is known, a line that's too long for one row is followed across the rows it
+ * wraps onto (moving up and down with ESC[nA / ESC[nB), and what's left of a
+ * longer line is cleared from the rows below too (ESC[J). Those lines are
+ * rewritten from the change to the end, as inserting and deleting characters
+ * only moves the rest of one row. Without the width, the line is treated as one row
+ */
+class LineRenderer
+{
+public:
+
+  /*!
+   * Update the display to show a line
+   * \param line The line that should be shown, with the cursor where it should be
+   * \retval out The buffer the output is added to
+   * \note The line is read where it is, in the two parts either side of its gap
+   */
+  void render(const LineBuffer& line, OutputBuffer& out);
+
+  /*!
+   * Forget what's on the screen, e.g. because a new prompt has been shown
+   * and the line after it is empty
+   * \param start_column The column the line starts in, after the prompt (default is 0)
+   * \param width The width of the terminal in columns, or 0 if it isn't known (the default)
+   */
+  void reset(std::size_t start_column = 0, std::size_t width = 0);
+
+  /*!
+   * Move the cursor past the end of the line and start a new row, so what's written
+   * next goes under the whole line. What's on the screen is forgotten
+   * \retval out The buffer the output is added to
+   */
+  void finishLine(OutputBuffer& out);
+
+  /*!
+   * Take the line and the prompt before it off the screen, leaving the cursor at the
+   * start of the row the prompt was on. What's on the screen is forgotten
+   * \retval out The buffer the output is added to
+   */
+  void erase(OutputBuffer& out);
+
+private:
+
+  //! Where a position in the line is on the screen
+  struct ScreenPosition
+  {
+    std::size_t row;     /*!< The row, counting from the one the prompt starts on */
+    std::size_t column;  /*!< The column */
+  };
+
+  /*!
+   * Write part of a line, which may be either side of its gap
+   * \param line The line
+   * \param start The position of the first character to write
+   * \param end The position just past the last character to write
+   * \retval out The buffer the output is added to
+   */
+  static void writeRange(const LineBuffer& line, std::size_t start, std::size_t end, OutputBuffer& out);
+
+  /*!
+   * Get the number of columns part of a line takes up
+   * \param line The line
+   * \param start The position of the first character
+   * \param end The position just past the last character
+   * \return The width of that part of the line
+   */
+  static std::size_t rangeWidth(const LineBuffer& line, std::size_t start, std::size_t end);
+
+  /*!
+   * Put part of a line into what's shown, where it goes in the line
+   * \param line The line
+   * \param start The position of the first character, which is where it goes in what's shown
+   * \param end The position just past the last character
+   */
+  void insertRange(const LineBuffer& line, std::size_t start, std::size_t end);
+
+  /*!
+   * Work out where a position in the shown line is on the screen, allowing for the rows it wraps onto
+   * (only when the width is known)
+   * \param pos The position in the line
+   * \return Where the position is on the screen
+   */
+  ScreenPosition screenPosition(std::size_t pos) const;
+
+  /*!
+   * Move the cursor from where it is on the screen
+   * \param new_pos The position to move to
+   * \retval out The buffer the output is added to
+   */
+  void moveCursor(std::size_t new_pos, OutputBuffer& out);
+
+  //! The line as it is on the screen
+  std::string shown_;
+
+  //! Where the cursor is on the screen
+  std::size_t cursor_pos_ = 0;
+
+  //! The column the line starts in (which can be past the first row if the prompt wraps)
+  std::size_t start_column_ = 0;
+
+  //! The width of the terminal, or 0 if it isn't known
+  std::size_t width_ = 0;
+};
@@ -0,0 +1,111 @@
+/*
+ * File: server-main.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// test-console includes
+#include "console-server.h"
+
+// POSIX includes
+#include <signal.h>
+
+// STL includes
+#include <iostream>
+#include <exception>
+#include <string>
+#include <thread>
+#include <algorithm>
+
+// Run console sessions for operators connecting over TCP (or ptys), until we're interrupted
+int main(int argc, char** argv)
+{
+  try
+  {
+    // --port <port> listens for TCP connections (the default is 2323, 0 picks a free one), --address <ip>
+    // listens elsewhere than this machine, --raw is for clients that don't use telnet, --ptys <n> opens
+    // pty sessions, --workers <n> sets the size of the thread pool and --nodes <image> completes 'ping'
+    // from a trie image (see make-trie-image)
+    unsigned long port = 2323;
+    std::string address = "127.0.0.1";
+    bool telnet = true;
+    unsigned long n_ptys = 0;
+    unsigned int n_workers = std::max(std::thread::hardware_concurrency(), 1u);
+    std::string nodes;
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg == "--port" && i + 1 < argc)
+        port = std::stoul(argv[++i]);
+      else if (arg == "--address" && i + 1 < argc)
+        address = argv[++i];
+      else if (arg == "--raw")
+        telnet = false;
+      else if (arg == "--ptys" && i + 1 < argc)
+        n_ptys = std::stoul(argv[++i]);
+      else if (arg == "--workers" && i + 1 < argc)
+        n_workers = static_cast<unsigned int>(std::stoul(argv[++i]));
+      else if (arg == "--nodes" && i + 1 < argc)
+        nodes = argv[++i];
+      else
+      {
+        std::cerr << "Usage: " << argv[0] << " [--port <port>] [--address <ip>] [--raw] [--ptys <n>]"
+          " [--workers <n>] [--nodes <image>]\n";
+        return 1;
+      }
+    }
+    if (port > 65535)
+      throw std::out_of_range("The port must be 0 to 65535");
+
+    // Every session shares the commands
+    auto commands = TestConsole::makeCommands();
+    if (!nodes.empty())
+      commands->setArgument("ping", 0, std::make_unique<ArgumentValues>(
+        std::make_unique<CommandTrie>(CommandTrie::openImage(nodes))));
+
+    // Wait for <Ctrl-C> (or a kill) on this thread - the workers never see the signals
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    ConsoleServer server("test-console ->", commands, n_workers);
+    std::uint16_t bound = server.listen(static_cast<std::uint16_t>(port), address, telnet);
+    std::cout << "Listening on " << address << ":" << bound << " with " << n_workers << " workers\n";
+    for (unsigned long i = 0; i < n_ptys; ++i)
+      std::cout << "Session on " << server.openPty() << "\n";
+    std::cout << std::flush;
+
+    int signal_number = 0;
+    sigwait(&signals, &signal_number);
+    std::cout << "Stopping with " << server.sessionCount() << " sessions\n";
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << "An error occurred in the console server: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * File: session-io.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// test-console includes
+#include <session-io.h>
+
+// STL includes
+#include <utility>
+
+// Create the session's input and output
+SessionIo::SessionIo(std::function<void()> wake) :
+  wake_{ std::move(wake) }
+{
+}
+
+// Hand over what arrived
+void SessionIo::receive(const char* data, std::size_t n_bytes)
+{
+  received_.append(data, n_bytes);
+}
+
+// Decode what's arrived
+void SessionIo::getKeyPresses(KeyBuffer& keys)
+{
+  if (received_.empty())
+  {
+    decoder_.expire(keys);
+    return;
+  }
+  decoder_.decode(received_.data(), received_.size(), keys);
+  received_.clear();
+}
+
+// Take the console's output
+void SessionIo::send(OutputBuffer& out)
+{
+  output_.append(out.data(), out.size());
+  out.clear();
+}
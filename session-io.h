@@ -0,0 +1,109 @@
+/*
+ * File: session-io.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// test-console includes
+#include <terminal-decoder.h>
+#include <key-buffer.h>
+#include <output.h>
+
+// STL includes
+#include <string>
+#include <functional>
+#include <cstddef>
+
+/*!
+ * The input and output of a console that isn't the process's own terminal,
+ * e.g. one of the sessions a ConsoleServer runs over a socket or a pty.
+ * Whoever runs the session reads its connection and hands over what arrived,
+ * then sends what the console wrote: the console never touches the connection
+ * itself, so any number of sessions can share a thread. What arrives is decoded
+ * as terminal input, whatever platform the console is built for.
+ */
+class SessionIo
+{
+public:
+
+  /*!
+   * Create the session's input and output
+   * \param wake Called (from any thread) when a message is posted to the console, so whoever runs
+   *             the session knows to call TestConsole::processPendingInput() to show it
+   */
+  explicit SessionIo(std::function<void()> wake);
+
+  /*!
+   * Hand over bytes that arrived on the connection
+   * \param data The bytes
+   * \param n_bytes The number of bytes
+   */
+  void receive(const char* data, std::size_t n_bytes);
+
+  /*!
+   * Decode what's arrived since the last call
+   * \retval keys Each key press is added to the end of this. If nothing has arrived, an incomplete key
+   *         that has waited long enough is added instead
+   */
+  void getKeyPresses(KeyBuffer& keys);
+
+  /*!
+   * Get how long to wait for the rest of an incomplete key
+   * \return The wait in milliseconds, or a negative value if there's nothing to wait for
+   */
+  int waitLimit() const { return received_.empty() ? decoder_.waitLimit() : 0; }
+
+  /*!
+   * Take what the console has written, to send on the connection
+   * \param out The console's output, which is moved to the end of output() and cleared
+   */
+  void send(OutputBuffer& out);
+
+  /*!
+   * Get what's waiting to be sent on the connection
+   * \return The bytes. Whoever runs the session removes what it's sent from the start
+   */
+  std::string& output() { return output_; }
+
+  /*!
+   * Let whoever runs the session know there's a message to show
+   */
+  void wake() const { wake_(); }
+
+private:
+
+  //! Turns what's arrived into key presses
+  TerminalDecoder decoder_;
+
+  //! What's arrived since the console last read its keys
+  std::string received_;
+
+  //! What's waiting to be sent
+  std::string output_;
+
+  //! Called when a message is posted
+  std::function<void()> wake_;
+};
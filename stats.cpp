@@ -0,0 +1,188 @@
+/*
+ * File: stats.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <stats.h>
+
+// STL includes
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+  // Get the position of the highest bit set in a value (which mustn't be 0)
+  unsigned int highestBit(std::uint64_t value)
+  {
+    unsigned int bit = 0;
+    for (unsigned int shift = 32; shift > 0; shift /= 2)
+    {
+      if (value >> shift)
+      {
+        value >>= shift;
+        bit += shift;
+      }
+    }
+    return bit;
+  }
+
+  // Add a duration in nanoseconds to the output, in microseconds
+  void printMicroseconds(OutputBuffer& out, std::uint64_t ns)
+  {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%10.1f", static_cast<double>(ns) / 1000.0);
+    out << text;
+  }
+
+  //! The names of the stages, for the report
+  const char* const STAGE_NAMES[] = { "decode", "edit", "completion", "render", "flush", "echo" };
+  static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == static_cast<std::size_t>(ConsoleStats::Stage::count),
+    "Every stage needs a name");
+}
+
+// Add values to the histogram
+void LatencyHistogram::record(std::uint64_t value, std::uint64_t count /*= 1*/)
+{
+  buckets_[bucket(value)] += count;
+  count_ += count;
+  if (value > max_)
+    max_ = value;
+}
+
+// Get a percentile
+std::uint64_t LatencyHistogram::percentile(double fraction) const
+{
+  if (count_ == 0)
+    return 0;
+
+  // The rank of the value we want, counting from 1
+  auto rank = static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(count_)));
+  if (rank == 0)
+    rank = 1;
+
+  std::uint64_t seen = 0;
+  for (unsigned int i = 0; i < N_BUCKETS; ++i)
+  {
+    seen += buckets_[i];
+    if (seen >= rank)
+      return i + 1 < N_BUCKETS ? std::min(bucketTop(i), max_) : max_;
+  }
+  return max_;
+}
+
+// Remove all the values
+void LatencyHistogram::clear()
+{
+  buckets_.fill(0);
+  count_ = 0;
+  max_ = 0;
+}
+
+// Get the bucket for a value
+unsigned int LatencyHistogram::bucket(std::uint64_t value)
+{
+  if (value < SUB_BUCKETS)
+    return static_cast<unsigned int>(value);
+
+  // The top SUB_BUCKET_BITS + 1 bits pick the bucket in the value's power of 2
+  unsigned int bit = highestBit(value);
+  unsigned int shift = bit - SUB_BUCKET_BITS;
+  auto sub_bucket = static_cast<unsigned int>((value >> shift) & (SUB_BUCKETS - 1));
+  return std::min((shift + 1) * SUB_BUCKETS + sub_bucket, N_BUCKETS - 1);
+}
+
+// Get the largest value in a bucket
+std::uint64_t LatencyHistogram::bucketTop(unsigned int index)
+{
+  if (index < SUB_BUCKETS)
+    return index;
+
+  unsigned int shift = index / SUB_BUCKETS - 1;
+  std::uint64_t sub_bucket = index % SUB_BUCKETS;
+  std::uint64_t bottom = (SUB_BUCKETS + sub_bucket) << shift;
+  return bottom + ((std::uint64_t{ 1 } << shift) - 1);
+}
+
+// Record that the waiting output has been flushed
+void ConsoleStats::echoed(std::size_t n_bytes)
+{
+  if constexpr (ENABLED)
+  {
+    if (unechoed_ == 0)
+      return;
+
+    if (arrived_)
+      histograms_[static_cast<std::size_t>(Stage::echo)].record(elapsed(arrival_), unechoed_);
+    n_keys_ += unechoed_;
+    n_bytes_ += n_bytes;
+    unechoed_ = 0;
+    arrived_ = false;
+  }
+}
+
+// Show the statistics
+void ConsoleStats::print(OutputBuffer& out) const
+{
+  if (!ENABLED)
+  {
+    out << "The console was built without statistics (TEST_CONSOLE_STATS is off)\r\n";
+    return;
+  }
+
+  out << "stage          count   p50 (us)   p99 (us)   max (us)\r\n";
+  for (std::size_t i = 0; i < histograms_.size(); ++i)
+  {
+    const LatencyHistogram& h = histograms_[i];
+    char name[32];
+    std::snprintf(name, sizeof(name), "%-10s %9llu ", STAGE_NAMES[i], static_cast<unsigned long long>(h.count()));
+    out << name;
+    printMicroseconds(out, h.percentile(0.5));
+    out << ' ';
+    printMicroseconds(out, h.percentile(0.99));
+    out << ' ';
+    printMicroseconds(out, h.max());
+    out << "\r\n";
+  }
+
+  char summary[96];
+  std::snprintf(summary, sizeof(summary), "%llu keys, %llu bytes written (%.2f bytes per key)\r\n",
+    static_cast<unsigned long long>(n_keys_), static_cast<unsigned long long>(n_bytes_),
+    n_keys_ > 0 ? static_cast<double>(n_bytes_) / static_cast<double>(n_keys_) : 0.0);
+  out << summary;
+}
+
+// Forget everything
+void ConsoleStats::clear()
+{
+  for (auto& h : histograms_)
+    h.clear();
+  arrived_ = false;
+  unechoed_ = 0;
+  n_keys_ = 0;
+  n_bytes_ = 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * File: stats.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// test-console includes
+#include <output.h>
+
+// STL includes
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// The instrumentation can be left out of the build (with the CMake option
+// TEST_CONSOLE_STATS), in which case the timing calls do nothing at all
+#ifndef TEST_CONSOLE_STATS
+#define TEST_CONSOLE_STATS 1
+#endif
+
+/*!
+ * A histogram of durations with a fixed set of buckets, in the style of an HDR
+ * histogram: values below 16 each have their own bucket, and each power of 2
+ * above that is split into 16 buckets. So any value is within 1/16 (6.25%) of
+ * where its bucket says it is, whatever its size, and recording a value is a
+ * few shifts and an increment, with no allocation. Values of 2^40 (about 18
+ * minutes in nanoseconds) and over share the top bucket, which keeps each
+ * console's statistics small when a server runs hundreds of them.
+ */
+class LatencyHistogram
+{
+public:
+
+  /*!
+   * Add values to the histogram
+   * \param value The value (a duration in nanoseconds)
+   * \param count How many times the value happened (default is 1)
+   */
+  void record(std::uint64_t value, std::uint64_t count = 1);
+
+  /*!
+   * Get the number of values recorded
+   * \return The number of values
+   */
+  std::uint64_t count() const { return count_; }
+
+  /*!
+   * Get the largest value recorded
+   * \return The largest value, or 0 if there are none
+   */
+  std::uint64_t max() const { return max_; }
+
+  /*!
+   * Get the value that a given fraction of the values are at or below
+   * \param fraction The fraction, from 0 to 1 (e.g. 0.99 for the 99th percentile)
+   * \return The top of the bucket the value is in (never more than max()), or 0 if there are no values
+   */
+  std::uint64_t percentile(double fraction) const;
+
+  //! Remove all the values
+  void clear();
+
+private:
+
+  //! The number of bits for the buckets in each power of 2
+  static constexpr unsigned int SUB_BUCKET_BITS = 4;
+
+  //! The number of buckets in each power of 2
+  static constexpr unsigned int SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+
+  //! Values with more bits than this all go in the top bucket
+  static constexpr unsigned int MAX_VALUE_BITS = 40;
+
+  //! The number of buckets
+  static constexpr unsigned int N_BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  /*!
+   * Get the bucket for a value
+   * \param value The value
+   * \return The index of its bucket
+   */
+  static unsigned int bucket(std::uint64_t value);
+
+  /*!
+   * Get the largest value in a bucket
+   * \param index The index of the bucket
+   * \return The largest value that goes in the bucket
+   */
+  static std::uint64_t bucketTop(unsigned int index);
+
+  //! The number of values in each bucket
+  std::array<std::uint64_t, N_BUCKETS> buckets_{};
+
+  //! The number of values
+  std::uint64_t count_ = 0;
+
+  //! The largest value
+  std::uint64_t max_ = 0;
+};
+
+/*!
+ * Where the time goes between a key arriving and the console showing its
+ * effect. Each stage has a histogram of how long it took per batch of keys,
+ * and the echo histogram has how long each key waited, from being read to the
+ * output it caused being flushed to the terminal.
+ */
+class ConsoleStats
+{
+public:
+
+  //! Whether the instrumentation is built in
+  static constexpr bool ENABLED = TEST_CONSOLE_STATS != 0;
+
+  //! The clock the stages are timed with
+  using Clock = std::chrono::steady_clock;
+
+  //! The stages of handling keys that are timed
+  enum class Stage
+  {
+    decode,     /*!< Turning the input read into key presses */
+    edit,       /*!< Applying the key presses to the line (including completion) */
+    completion, /*!< Searching for completions of a command */
+    render,     /*!< Working out what to send to the terminal */
+    flush,      /*!< Writing to the terminal */
+    echo,       /*!< From a key being read to its output being flushed (per key) */
+    count       /*!< The number of stages (not a stage) */
+  };
+
+  /*!
+   * Get the time now, for timing a stage
+   * \return The time, or a default time if the instrumentation isn't built in
+   */
+  static Clock::time_point now()
+  {
+    if constexpr (ENABLED)
+      return Clock::now();
+    else
+      return Clock::time_point();
+  }
+
+  /*!
+   * Record how long a stage took
+   * \param stage The stage
+   * \param start When the stage started (from now())
+   */
+  void record(Stage stage, Clock::time_point start)
+  {
+    if constexpr (ENABLED)
+      histograms_[static_cast<std::size_t>(stage)].record(elapsed(start));
+  }
+
+  /*!
+   * Record that input was read and decoded into keys. The keys are treated as
+   * arriving when the decoding started, until they're echoed
+   * \param start When the decoding started (from now())
+   */
+  void decoded(Clock::time_point start)
+  {
+    if constexpr (ENABLED)
+    {
+      record(Stage::decode, start);
+      if (!arrived_)
+      {
+        arrival_ = start;
+        arrived_ = true;
+      }
+    }
+  }
+
+  /*!
+   * Record that keys have been handled, and their output is waiting to be flushed
+   * \param n_keys The number of keys (each repeat counts)
+   */
+  void handled(std::size_t n_keys)
+  {
+    if constexpr (ENABLED)
+      unechoed_ += n_keys;
+  }
+
+  /*!
+   * Record that the output for the keys handled so far has been flushed
+   * \param n_bytes The number of bytes written
+   */
+  void echoed(std::size_t n_bytes);
+
+  /*!
+   * Show the statistics
+   * \retval out The buffer the report is added to
+   */
+  void print(OutputBuffer& out) const;
+
+  //! Forget everything recorded so far
+  void clear();
+
+private:
+
+  /*!
+   * Get the time since a start time
+   * \param start The start time
+   * \return The time in nanoseconds
+   */
+  static std::uint64_t elapsed(Clock::time_point start)
+  {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now() - start).count());
+  }
+
+  //! How long each stage took
+  std::array<LatencyHistogram, static_cast<std::size_t>(Stage::count)> histograms_;
+
+  //! When the first key not yet echoed arrived
+  Clock::time_point arrival_;
+
+  //! Whether there are keys that have arrived but not been echoed
+  bool arrived_ = false;
+
+  //! The number of keys handled but not yet echoed
+  std::size_t unechoed_ = 0;
+
+  //! The number of keys echoed
+  std::uint64_t n_keys_ = 0;
+
+  //! The number of bytes written while echoing keys
+  std::uint64_t n_bytes_ = 0;
+};
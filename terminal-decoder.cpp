@@ -0,0 +1,309 @@
+/*
+ * File: terminal-decoder.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Each complete sequence is decoded without building a string or searching
+ * a map: control characters come from a table built at compile time, and
+ * escape sequences are parsed as ECMA-48 parameters and a final byte
+ * (ESC [ params... final, or ESC O x), so modified keys (e.g. <Ctrl>+<Left>,
+ * ESC [1;5D) decode like the plain ones. The sequences are the xterm ones,
+ * which most terminals follow. See:
+ *   https://invisible-island.net/xterm/ctlseqs/ctlseqs.html#h2-PC-Style-Function-Keys
+ *
+ * Pasted text comes between the bracketed paste markers. See:
+ *   https://invisible-island.net/xterm/ctlseqs/ctlseqs.html#h2-Bracketed-Paste-Mode
+ */
+
+// test-console includes
+#include <terminal-decoder.h>
+#include <utf8.h>
+
+// STL includes
+#include <string_view>
+#include <tuple>
+#include <array>
+#include <algorithm>
+
+namespace
+{
+  //! The escape code that starts multi-byte key sequences
+  const char ESC = 27;
+
+  //! Sent by the terminal before and after pasted text in bracketed paste mode
+  const std::string PASTE_START = "\x1b[200~";
+  const std::string PASTE_END = "\x1b[201~";
+
+  //! A decoded key sequence. The char is the character for KeyPressed::alphanum,
+  //! the number for KeyPressed::function, or '\0'
+  using DecodedKey = std::tuple<KeyPressed, char>;
+
+  // Build the table of what each single byte (other than printable characters) means
+  constexpr std::array<KeyPressed, 128> makeControlKeys()
+  {
+    std::array<KeyPressed, 128> keys{};
+    for (auto& k : keys)
+      k = KeyPressed::undefined;
+    keys[9] = KeyPressed::tab;
+    keys[13] = KeyPressed::enter;
+    keys[10] = KeyPressed::enter;     // A new line, e.g. from a script piped in
+    keys[127] = KeyPressed::backspace;
+    keys[8] = KeyPressed::backspace;  // Ctrl-H, which some terminals send for <Backspace>
+    keys[18] = KeyPressed::search;    // Ctrl-R
+    keys[7] = KeyPressed::cancel;     // Ctrl-G
+    keys[ESC] = KeyPressed::cancel;   // A lone ESC
+    return keys;
+  }
+
+  //! What each single byte key means
+  constexpr std::array<KeyPressed, 128> CONTROL_KEYS = makeControlKeys();
+
+  // Decode the final byte of ESC [ ... or ESC O ... for the cursor keys
+  // The ctrl flag is set if <Ctrl> or <Alt> was held, which moves by words
+  constexpr DecodedKey decodeCursorKey(char final, bool ctrl)
+  {
+    switch (final)
+    {
+    case 'A': return { KeyPressed::uparrow, '\0' };
+    case 'B': return { KeyPressed::downarrow, '\0' };
+    case 'C': return { ctrl ? KeyPressed::wordright : KeyPressed::rightarrow, '\0' };
+    case 'D': return { ctrl ? KeyPressed::wordleft : KeyPressed::leftarrow, '\0' };
+    case 'H': return { KeyPressed::home, '\0' };
+    case 'F': return { KeyPressed::end, '\0' };
+    case 'P': return { KeyPressed::function, 1 };  // F1 to F4 are sent as ESC O P to ESC O S
+    case 'Q': return { KeyPressed::function, 2 };
+    case 'R': return { KeyPressed::function, 3 };
+    case 'S': return { KeyPressed::function, 4 };
+    default: return { KeyPressed::undefined, '\0' };
+    }
+  }
+
+  // Decode the number in ESC [ number ~ sequences
+  constexpr DecodedKey decodeTildeKey(unsigned int number)
+  {
+    switch (number)
+    {
+    case 1: case 7: return { KeyPressed::home, '\0' };
+    case 4: case 8: return { KeyPressed::end, '\0' };
+    case 3: return { KeyPressed::del, '\0' };
+    case 5: return { KeyPressed::pageup, '\0' };
+    case 6: return { KeyPressed::pagedown, '\0' };
+    default: break;
+    }
+
+    // The function keys are numbered in groups, with gaps where old terminals had other keys
+    if (number >= 11 && number <= 15)
+      return { KeyPressed::function, static_cast<char>(number - 10) };   // F1 to F5
+    if (number >= 17 && number <= 21)
+      return { KeyPressed::function, static_cast<char>(number - 11) };   // F6 to F10
+    if (number >= 23 && number <= 24)
+      return { KeyPressed::function, static_cast<char>(number - 12) };   // F11 and F12
+    return { KeyPressed::undefined, '\0' };
+  }
+
+  // Decode one complete key sequence, as split up by keySequenceLength()
+  constexpr DecodedKey decodeKeySequence(std::string_view seq)
+  {
+    unsigned char first = static_cast<unsigned char>(seq[0]);
+    if (seq.size() == 1)
+    {
+      if (first >= 32 && first <= 126) // ASCII printable characters
+        return { KeyPressed::alphanum, seq[0] };
+      return { first < CONTROL_KEYS.size() ? CONTROL_KEYS[first] : KeyPressed::undefined, '\0' };
+    }
+    if (first != ESC)
+      return { KeyPressed::undefined, '\0' };
+
+    // ESC O x
+    if (seq[1] == 'O' && seq.size() == 3)
+      return decodeCursorKey(seq[2], false);
+    if (seq[1] != '[')
+      return { KeyPressed::undefined, '\0' };
+
+    // ESC [ params final: the params are numbers split by ';'
+    // The first is the key number (for ~) and the second is 1 + the modifier flags
+    unsigned int params[2] = { 0, 0 };
+    std::size_t n_params = 0;
+    for (std::size_t i = 2; i + 1 < seq.size(); ++i)
+    {
+      if (seq[i] >= '0' && seq[i] <= '9')
+      {
+        if (n_params < 2)
+          params[n_params] = params[n_params] * 10 + (seq[i] - '0');
+      }
+      else if (seq[i] == ';')
+        ++n_params;
+      else // Private or intermediate bytes, which no key we know of uses
+        return { KeyPressed::undefined, '\0' };
+    }
+    char final = seq[seq.size() - 1];
+    unsigned int modifiers = params[1] > 0 ? params[1] - 1 : 0;
+    bool ctrl = (modifiers & (2 | 4)) != 0; // Alt is 2 and Ctrl is 4 (Shift is 1)
+
+    if (final == '~')
+      return decodeTildeKey(params[0]);
+    return decodeCursorKey(final, ctrl);
+  }
+
+  // Some checks that the decoder works, which cost nothing at run time
+  static_assert(std::get<0>(decodeKeySequence("a")) == KeyPressed::alphanum);
+  static_assert(std::get<0>(decodeKeySequence("\x7f")) == KeyPressed::backspace);
+  static_assert(std::get<0>(decodeKeySequence("\x1b[D")) == KeyPressed::leftarrow);
+  static_assert(std::get<0>(decodeKeySequence("\x1b[1;5D")) == KeyPressed::wordleft);
+  static_assert(std::get<0>(decodeKeySequence("\x1bOH")) == KeyPressed::home);
+  static_assert(std::get<0>(decodeKeySequence("\x1b[3~")) == KeyPressed::del);
+  static_assert(decodeKeySequence("\x1b[24~") == DecodedKey{ KeyPressed::function, 12 });
+  // Get the length of the key sequence starting at pos
+  // Returns 0 if the sequence is incomplete (it's cut off at the end of the input)
+  std::string::size_type keySequenceLength(const std::string& input, std::string::size_type pos)
+  {
+    if (input[pos] != ESC)
+      return 1;
+
+    // We need at least one more char to know what the ESC starts
+    if (pos + 1 == input.size())
+      return 0;
+
+    switch (input[pos + 1])
+    {
+    case '[': // Control sequence: parameter and intermediate bytes, then a final byte in 0x40-0x7E
+      for (auto i = pos + 2; i < input.size(); ++i)
+      {
+        if (input[i] >= 0x40 && input[i] <= 0x7E)
+          return i - pos + 1;
+        if (input[i] < 0x20 || input[i] > 0x3F) // Not a valid sequence, so just take the ESC
+          return 1;
+      }
+      return 0;
+    case 'O': // Single shift: exactly one more char
+      return pos + 2 < input.size() ? 3 : 0;
+    default: // Anything else (e.g. <Alt>+key) - treat the ESC as a key on its own
+      return 1;
+    }
+  }
+}
+
+// Add bytes from the terminal and decode them
+void TerminalDecoder::decode(const char* data, std::size_t n_bytes, KeyBuffer& keys)
+{
+  last_read_ = std::chrono::steady_clock::now();
+  pending_.append(data, n_bytes);
+  tokenise(keys, false);
+}
+
+// Decide what an incomplete key is
+void TerminalDecoder::expire(KeyBuffer& keys)
+{
+  // Wait the whole timeout in case we're called early, and never cut a paste short
+  if (in_paste_ || std::chrono::steady_clock::now() - last_read_ < std::chrono::milliseconds(ESCAPE_TIMEOUT_MS))
+    tokenise(keys, false);
+  else
+    tokenise(keys, true);
+}
+
+// Get how long to wait for the rest of a key
+int TerminalDecoder::waitLimit() const
+{
+  // In a paste, we always wait for the end marker
+  if (pending_.empty() || in_paste_)
+    return -1;
+
+  auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - last_read_);
+  return static_cast<int>(std::max<std::chrono::milliseconds::rep>(ESCAPE_TIMEOUT_MS - waited.count(), 0));
+}
+
+// Split the input into key presses, leaving any incomplete one at the end unless flush is set
+void TerminalDecoder::tokenise(KeyBuffer& keys, bool flush)
+{
+  std::string& input = pending_;
+  std::string::size_type pos = 0;
+  while (pos < input.size())
+  {
+    // If we're in a paste, everything up to the end marker is pasted text
+    if (in_paste_)
+    {
+      auto paste_end = input.find(PASTE_END, pos);
+      if (paste_end == std::string::npos)
+      {
+        // Keep enough back that we can't miss an end marker split across reads
+        auto keep = std::min(input.size() - pos, PASTE_END.size() - 1);
+        paste_text_.append(input, pos, input.size() - pos - keep);
+        pos = input.size() - keep;
+        break;
+      }
+      paste_text_.append(input, pos, paste_end - pos);
+      keys.pushPaste(paste_text_);
+      paste_text_.clear();
+      in_paste_ = false;
+      pos = paste_end + PASTE_END.size();
+      continue;
+    }
+
+    // A UTF-8 character goes to the line a byte at a time, but only once it's all been read
+    unsigned char first = static_cast<unsigned char>(input[pos]);
+    if (first >= 0x80)
+    {
+      std::string::size_type len = utf8SequenceLength(first);
+      if (len > 1 && pos + len > input.size() && !flush
+          && std::all_of(input.begin() + pos + 1, input.end(), [](char c) { return isUtf8Continuation(c); }))
+        break;
+      if (len > 1 && isValidUtf8(std::string_view(input).substr(pos, len)))
+      {
+        for (std::string::size_type i = 0; i < len; ++i)
+          keys.push(KeyPressed::alphanum, input[pos + i]);
+        pos += len;
+      }
+      else
+        ++pos; // Drop a byte that isn't part of a valid character
+      continue;
+    }
+
+    std::string::size_type len = keySequenceLength(input, pos);
+    if (len == 0)
+    {
+      if (!flush)
+        break;
+      len = input.size() - pos;
+    }
+
+    // Printable characters are by far the most common, so push them without decoding the sequence
+    if (len == 1 && input[pos] >= 32 && input[pos] <= 126)
+      keys.push(KeyPressed::alphanum, input[pos]);
+    else if (input.compare(pos, len, PASTE_START) == 0)
+      in_paste_ = true;
+    else
+    {
+      auto [kp, c] = decodeKeySequence(std::string_view(input).substr(pos, len));
+      keys.push(kp, c);
+    }
+    pos += len;
+  }
+
+  // Keep anything we couldn't handle yet for the next read
+  input.erase(0, pos);
+}
@@ -0,0 +1,96 @@
+/*
+ * File: terminal-decoder.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// test-console includes
+#include <key-buffer.h>
+
+// STL includes
+#include <string>
+#include <chrono>
+#include <cstddef>
+
+/*!
+ * Turns the bytes a terminal sends into key presses. Most keys are one byte,
+ * but some send an escape sequence (e.g. <Delete> sends ESC [ 3 ~), UTF-8
+ * characters take up to four bytes, and a bracketed paste comes between
+ * ESC [200~ and ESC [201~. Any of these can be split across reads, so the
+ * decoder keeps an incomplete key until the rest arrives, or until it's been
+ * waiting long enough to decide that (say) an ESC was pressed on its own.
+ *
+ * It works on bytes alone, so it's used for the process's own terminal on
+ * Linux and for any session a server runs over a socket or a pty.
+ */
+class TerminalDecoder
+{
+public:
+
+  //! How long to wait for the rest of an escape sequence before treating ESC as a key press
+  static constexpr int ESCAPE_TIMEOUT_MS = 50;
+
+  /*!
+   * Add bytes read from the terminal, and decode the key presses they finish
+   * \param data The bytes
+   * \param n_bytes The number of bytes
+   * \retval keys Each key press is added to the end of this
+   */
+  void decode(const char* data, std::size_t n_bytes, KeyBuffer& keys);
+
+  /*!
+   * Decide what an incomplete key is, if nothing else has arrived for it in time
+   * \retval keys Any key press it turned out to be is added to the end of this
+   */
+  void expire(KeyBuffer& keys);
+
+  /*!
+   * Get how long to wait for the rest of an incomplete key before calling expire()
+   * \return The wait in milliseconds (0 if it's due now), or a negative value if there's nothing to wait for
+   */
+  int waitLimit() const;
+
+private:
+
+  /*!
+   * Split the input into key presses
+   * \retval keys Each key press is added to the end of this
+   * \param flush Take an incomplete key as it is, rather than keeping it for the next read
+   */
+  void tokenise(KeyBuffer& keys, bool flush);
+
+  //! Input we've read but not yet turned into key presses (e.g. a split escape sequence)
+  std::string pending_;
+
+  //! Whether we're between the start and end markers of a bracketed paste
+  bool in_paste_ = false;
+
+  //! The text pasted so far
+  std::string paste_text_;
+
+  //! When we last read some input, to know when a partial escape sequence is complete
+  std::chrono::steady_clock::time_point last_read_;
+};
@@ -0,0 +1,103 @@
+/*
+ * File: tests/renderer-test.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Checks the renderer only sends what changed when a long line is edited in the middle.
+// It's built without a test framework, so it just returns non-zero if a check fails
+
+// test-console includes
+#include <renderer.h>
+#include <line-buffer.h>
+#include <output.h>
+
+// STL includes
+#include <iostream>
+#include <string>
+
+namespace
+{
+  //! The length of the line that's edited
+  const std::size_t LINE_LENGTH = 2000;
+
+  //! The most bytes an edit of one character should send
+  const std::size_t MAX_EDIT_BYTES = 16;
+
+  //! The number of checks that failed
+  int failures = 0;
+
+  // Check a condition, reporting it if it's false
+  void check(bool condition, const std::string& what)
+  {
+    if (!condition)
+    {
+      std::cerr << "FAILED: " << what << "\n";
+      ++failures;
+    }
+  }
+
+  // Show a long line with the cursor in the middle, and start counting the output after that
+  void showLongLine(LineRenderer& renderer, LineBuffer& line, OutputBuffer& out, std::size_t width)
+  {
+    renderer.reset(2, width);
+    // Vary the text, so the edit can't be mistaken for one at the end
+    std::string text;
+    for (std::size_t i = 0; i < LINE_LENGTH; ++i)
+      text += static_cast<char>('a' + i % 26);
+    line.assign(text);
+    line.moveCursor(LINE_LENGTH / 2);
+    renderer.render(line, out);
+    out.clear();
+  }
+}
+
+int main()
+{
+  LineRenderer renderer;
+  LineBuffer line;
+  OutputBuffer out;
+
+  // Typing a character in the middle inserts a column, rather than rewriting the rest of the line
+  showLongLine(renderer, line, out, 0);
+  line.insert('X');
+  renderer.render(line, out);
+  check(out.size() <= MAX_EDIT_BYTES, "inserting a character sent " + std::to_string(out.size()) + " bytes");
+  check(std::string(out.data(), out.size()) == "\x1b[1@X", "inserting a character sent the wrong output");
+
+  // Backspace in the middle deletes a column
+  showLongLine(renderer, line, out, 0);
+  line.eraseBefore();
+  renderer.render(line, out);
+  check(out.size() <= MAX_EDIT_BYTES, "deleting a character sent " + std::to_string(out.size()) + " bytes");
+  check(std::string(out.data(), out.size()) == "\b\x1b[1P", "deleting a character sent the wrong output");
+
+  // A line that wraps can't be shifted along one row, so it's rewritten from the change
+  showLongLine(renderer, line, out, 80);
+  line.insert('X');
+  renderer.render(line, out);
+  check(out.size() > LINE_LENGTH / 2, "inserting into a wrapped line didn't rewrite the rest of it");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -27,131 +27,740 @@
 
 // test-console includes
 #include <trie.h>
+#include <mapped-file.h>
 
 // STL includes
 #include <iostream>
 #include <exception>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <cstring>
+#include <type_traits>
 
-// The constructor
-CommandTrie::CommandTrie(const std::string& valid_chars) : 
-  trie_root_{nullptr},
-  trie_node_size_{0}
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
 {
-  buildIndex(valid_chars);
+  // What a trie image starts with
+  const char TRIE_IMAGE_MAGIC[8] = { 'T', 'C', 'T', 'R', 'I', 'E', '\0', '\2' };
+
+  // Written as a native integer, to check an image was saved with the same byte order
+  const std::uint32_t TRIE_IMAGE_BYTE_ORDER = 0x01020304;
+
+  // The start of a trie image. The arrays follow it in the order of their
+  // counts, with each array starting on an 8 byte boundary
+  struct TrieImageHeader
+  {
+    char magic[sizeof(TRIE_IMAGE_MAGIC)];
+    std::uint32_t byte_order;
+    std::uint32_t node_size;
+    std::uint32_t mode;
+    std::uint32_t n_chars;
+    std::uint64_t n_nodes;
+    std::uint64_t n_labels;
+    std::uint64_t n_slots;
+    std::uint64_t n_free_nodes;
+    std::uint64_t n_free_blocks[9];
+  };
+
+  // Round an offset in an image up to where the next array starts
+  inline std::size_t alignImage(std::size_t offset)
+  {
+    return (offset + 7) & ~std::size_t(7);
+  }
+
+  // Count the bits set in a word. This is used at every node of a search,
+  // so use the processor's instruction when the compiler's been told it has one
+  inline unsigned int popCount(std::uint64_t x)
+  {
+#if defined(__POPCNT__) || defined(__ARM_NEON) || defined(__aarch64__)
+    return static_cast<unsigned int>(__builtin_popcountll(x));
+#elif defined(_MSC_VER) && defined(_M_X64) && defined(__AVX__)
+    return static_cast<unsigned int>(__popcnt64(x));
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<unsigned int>((x * 0x0101010101010101ULL) >> 56);
+#endif
+  }
+
+  // Count the zero bits below the lowest set bit (x must not be 0)
+  inline unsigned int countTrailingZeros(std::uint64_t x)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned int>(__builtin_ctzll(x));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long pos;
+    _BitScanForward64(&pos, x);
+    return static_cast<unsigned int>(pos);
+#else
+    return popCount((x & (~x + 1)) - 1);
+#endif
+  }
+
+  // Get the size class (log2 of the block size) needed to hold n children
+  inline unsigned int sizeClass(unsigned int n)
+  {
+    unsigned int size_class = 0;
+    while ((1u << size_class) < n)
+      ++size_class;
+    return size_class;
+  }
 }
 
-// Destructor
-CommandTrie::~CommandTrie()
+// The constructor
+CommandTrie::CommandTrie(const std::string& valid_chars, TrieMode mode /*= TrieMode::radix*/) : 
+  trie_node_size_{0},
+  mode_{mode}
 {
-  axe(trie_root_);
+  buildIndex(valid_chars);
 }
 
 // Insert an item into the trie structure
-void CommandTrie::insert(const std::string& str)
+void CommandTrie::insert(const std::string& str, std::uint32_t value /*= 0*/)
 {
-  // Create the root node if it doesn't exist
-  if (trie_root_ == nullptr)
+  // Check the whole string before we change anything
+  for (auto c : str)
+    if (index(c) == 255)
+      throw std::out_of_range("Invalid character '" + std::string(1, c) + "' in command '" + str + "'");
+
+  // If it's already there, only the value changes (the counts mustn't)
+  std::uint32_t rest_of_edge = 0;
+  std::uint32_t rest_length = 0;
+  auto [found, existing] = findNode(str, rest_of_edge, rest_length);
+  if (found && rest_length == 0 && nodes_[existing].is_terminal)
   {
-    trie_root_ = createTrieNode();
+    nodes_[existing].value = value;
+    return;
   }
 
-  TrieNode* curr_node = trie_root_; // Curr node will change as we traverse
-  std::string word_to_here = "";    // It's going to be useful to have the letters that get us to each node
+  // Create the root node if it doesn't exist
+  if (nodes_.empty())
+    createTrieNode();
+  ++version_;
 
-  // Ensure we have nodes for each character in our string
-  for (auto c : str)
+  std::uint32_t curr_node = ROOT_NODE; // Curr node will change as we traverse
+  std::string::size_type pos = 0;      // How much of the string we've matched
+
+  // Ensure we have nodes for each character in our string, counting
+  // the new word in every node on the way
+  while (pos < str.size())
   {
-    curr_node->word_to_here = word_to_here; 
-    unsigned int idx = index_[c];
+    ++nodes_[curr_node].n_terminals;
+    std::uint32_t next_node = child(nodes_[curr_node], index(str[pos]));
+
+    // If there's no edge for this char, add the rest of the string as one edge
+    // (or just this char if we're not compressing paths)
+    if (next_node == ROOT_NODE)
+    {
+      std::string::size_type length = mode_ == TrieMode::radix ? str.size() - pos : 1;
+      curr_node = addChild(curr_node, str, pos, length);
+      pos += length;
+      continue;
+    }
 
-    // If the child node for this char doen't exist, create it
-    if (curr_node->children[idx] == nullptr)
-      curr_node->children[idx] = createTrieNode();
+    // Follow the edge as far as it matches, and split it if we leave it part way
+    const TrieNode& node = nodes_[next_node];
+    std::uint32_t matched = 1;
+    while (matched < node.label_length && pos + matched < str.size() &&
+      labels_[node.label + matched] == str[pos + matched])
+      ++matched;
+    if (matched < node.label_length)
+      splitNode(next_node, matched);
 
     // Move to the next node
-    curr_node = curr_node->children[idx];
-    word_to_here.push_back(c);
+    curr_node = next_node;
+    pos += matched;
   }
 
-  // Update the final node with the word so far and set it as terminal (it's a complete word)
-  curr_node->word_to_here = word_to_here;
-  curr_node->is_terminal = true;
+  // Set the final node as terminal (it's a complete word)
+  ++nodes_[curr_node].n_terminals;
+  nodes_[curr_node].is_terminal = true;
+  nodes_[curr_node].value = value;
+}
+
+// Remove an item from the trie structure
+bool CommandTrie::remove(const std::string& str)
+{
+  if (!contains(str))
+    return false;
+  ++version_;
+
+  // Note the nodes on the way to the word, taking the word out of their counts
+  std::vector<std::uint32_t> path;
+  std::uint32_t curr_node = ROOT_NODE;
+  std::string::size_type pos = 0;
+  while (true)
+  {
+    path.push_back(curr_node);
+    --nodes_[curr_node].n_terminals;
+    if (pos == str.size())
+      break;
+    curr_node = child(nodes_[curr_node], index(str[pos]));
+    pos += nodes_[curr_node].label_length;
+  }
+
+  TrieNode& word_node = nodes_[curr_node];
+  word_node.is_terminal = false;
+  word_node.score = 0;
+  word_node.value = 0;
+
+  // Anything left with no words below it was only there for this word, so it goes.
+  // Only the highest such node needs unlinking - everything below goes with it
+  std::size_t keep = path.size();
+  while (keep > 1 && nodes_[path[keep - 1]].n_terminals == 0)
+    --keep;
+  if (keep < path.size())
+  {
+    std::uint32_t dead = path[keep];
+    unlinkChild(path[keep - 1], index(labels_[nodes_[dead].label]));
+    freeSubtree(dead);
+    path.resize(keep);
+  }
+
+  // The best scores on the way may have come from this word, so work them out again
+  for (auto it = path.rbegin(); it != path.rend(); ++it)
+  {
+    TrieNode& node = nodes_[*it];
+    node.best_score = node.is_terminal ? node.score : 0;
+    unsigned int n_children = countChildren(node);
+    for (unsigned int slot = 0; slot < n_children; ++slot)
+      node.best_score = std::max(node.best_score, nodes_[child_slots_[node.first_child + slot]].best_score);
+  }
+
+  // If the trie is now empty, we can start again
+  if (nodes_[ROOT_NODE].n_terminals == 0)
+  {
+    nodes_.clear();
+    labels_.clear();
+    child_slots_.clear();
+    for (auto& blocks : free_blocks_)
+      blocks.clear();
+    free_nodes_.clear();
+  }
+  return true;
+}
+
+// Find the value kept with a command
+bool CommandTrie::lookup(const std::string& str, std::uint32_t& value) const
+{
+  std::uint32_t rest_of_edge = 0;
+  std::uint32_t rest_length = 0;
+  auto [found, node] = findNode(str, rest_of_edge, rest_length);
+  if (!found || rest_length != 0 || !nodes_[node].is_terminal)
+    return false;
+  value = nodes_[node].value;
+  return true;
 }
 
 // Find any strings matching a passed in value
 std::tuple<std::size_t, std::string, std::vector<std::string>> 
 CommandTrie::find(const std::string& str, bool ret_pos /*= false*/) const
 {
-  std::tuple<unsigned int, std::string, std::vector<std::string>> blank_tuple =
-    std::make_tuple(0, "", std::vector<std::string>());
+  TrieMatches matches;
+  find(str, matches, ret_pos);
 
-  // If the trie is empty, there's nothing to match
-  if (trie_root_ == nullptr)
-    return blank_tuple;
+  std::vector<std::string> possible_commands;
+  possible_commands.reserve(matches.size());
+  for (std::size_t i = 0; i < matches.size(); ++i)
+    possible_commands.emplace_back(matches[i]);
+
+  return std::make_tuple(matches.paths(), matches.completion(), possible_commands);
+}
+
+// Find any strings matching a passed in value, using the caller's buffer
+void CommandTrie::find(const std::string& str, TrieMatches& matches, bool ret_pos /*= false*/,
+  std::size_t first /*= 0*/, std::size_t max_commands /*= ALL_COMMANDS*/) const
+{
+  matches.clear();
 
   // Check if the partial string is in the tree
-  TrieNode* curr_node = trie_root_;
-  for (auto c : str)
+  std::uint32_t rest_of_edge = 0;
+  std::uint32_t rest_length = 0;
+  auto [found, curr_node] = findNode(str, rest_of_edge, rest_length);
+  if (!found)
+    return;
+
+  std::uint32_t last_node = complete(str, curr_node, rest_of_edge, rest_length, matches);
+
+  // If the possible commands are requested, get them
+  if (ret_pos)
   {
-    unsigned int idx = index_[c];
-    if (curr_node->children[idx] == nullptr)
-      return blank_tuple;  // If we hit a nullptr, the search string isn't in the trie
-    curr_node = curr_node->children[idx];
+    std::size_t capacity = matches.word_.capacity();
+    matches.word_.assign(matches.completion_);
+    matches.noteCapacity(capacity, matches.word_.capacity());
+    getPossibleCommands(last_node, matches, first, max_commands);
   }
+}
+
+// Find the best scoring commands matching a passed in value
+void CommandTrie::findRanked(const std::string& str, TrieMatches& matches, std::size_t first,
+  std::size_t max_commands) const
+{
+  matches.clear();
 
-  // We want to auto complete from where our string stops, so we need to see if there
-  // are any unambiguous paths (single children) from here
-  auto [n_paths, longest_str, last_node] = getLongestString(curr_node);
+  std::uint32_t rest_of_edge = 0;
+  std::uint32_t rest_length = 0;
+  auto [found, curr_node] = findNode(str, rest_of_edge, rest_length);
+  if (!found)
+    return;
 
-  // If the possible commands are requested, get them
-  std::vector<std::string> possible_commands;
+  // Search from where the completion stops, rather than walking to it again
+  std::uint32_t last_node = complete(str, curr_node, rest_of_edge, rest_length, matches);
+  rankFrom(last_node, matches, first, max_commands);
+}
+
+// Move a cursor to a new prefix
+void CommandTrie::moveCursor(TrieCursor& cursor, std::string_view str) const
+{
+  // A cursor from before the trie changed may point at nodes that have moved
+  if (cursor.version_ != version_)
+  {
+    cursor.clear();
+    cursor.version_ = version_;
+  }
+
+  // Go back to where the old and new prefixes differ
+  std::size_t common = 0;
+  std::size_t limit = std::min(cursor.prefix_.size(), str.size());
+  while (common < limit && cursor.prefix_[common] == str[common])
+    ++common;
+  cursor.prefix_.resize(common);
+  cursor.matched_ = std::min(cursor.matched_, common);
+  cursor.steps_.resize(cursor.matched_);
+  cursor.prefix_.append(str.substr(common));
+
+  // Then follow the new characters, until one of them isn't in the trie
+  if (nodes_.empty())
+    return;
+  TrieCursor::Step step = cursor.steps_.empty() ? TrieCursor::Step{ ROOT_NODE, 0 } : cursor.steps_.back();
+  while (cursor.matched_ < cursor.prefix_.size())
+  {
+    char c = cursor.prefix_[cursor.matched_];
+    const TrieNode& node = nodes_[step.node];
+    if (step.edge_pos < node.label_length)
+    {
+      // Part way along an edge, the next character has to match the label
+      if (labels_[node.label + step.edge_pos] != c)
+        return;
+      ++step.edge_pos;
+    }
+    else
+    {
+      // At the end of an edge, the next character picks the child
+      unsigned int idx = index(c);
+      if (idx == 255)
+        return;
+      std::uint32_t next = child(node, idx);
+      if (next == ROOT_NODE)
+        return;
+      step = TrieCursor::Step{ next, 1 };
+    }
+    cursor.steps_.push_back(step);
+    ++cursor.matched_;
+  }
+}
+
+// Search from a cursor
+void CommandTrie::find(const TrieCursor& cursor, TrieMatches& matches, bool ret_pos /*= false*/,
+  std::size_t first /*= 0*/, std::size_t max_commands /*= ALL_COMMANDS*/) const
+{
+  matches.clear();
+
+  std::uint32_t rest_of_edge = 0;
+  std::uint32_t rest_length = 0;
+  auto [found, curr_node] = cursorNode(cursor, rest_of_edge, rest_length);
+  if (!found)
+    return;
+
+  std::uint32_t last_node = complete(cursor.prefix_, curr_node, rest_of_edge, rest_length, matches);
   if (ret_pos)
-    getPossibleCommands(last_node, possible_commands);
+  {
+    std::size_t capacity = matches.word_.capacity();
+    matches.word_.assign(matches.completion_);
+    matches.noteCapacity(capacity, matches.word_.capacity());
+    getPossibleCommands(last_node, matches, first, max_commands);
+  }
+}
+
+// Find the best scoring commands from a cursor
+void CommandTrie::findRanked(const TrieCursor& cursor, TrieMatches& matches, std::size_t first,
+  std::size_t max_commands) const
+{
+  matches.clear();
 
-  return std::make_tuple(n_paths, longest_str, possible_commands);
+  std::uint32_t rest_of_edge = 0;
+  std::uint32_t rest_length = 0;
+  auto [found, curr_node] = cursorNode(cursor, rest_of_edge, rest_length);
+  if (!found)
+    return;
+
+  std::uint32_t last_node = complete(cursor.prefix_, curr_node, rest_of_edge, rest_length, matches);
+  rankFrom(last_node, matches, first, max_commands);
 }
 
-// Print out the trie
-void CommandTrie::print()
+// Add the best scoring commands under a node to the results
+void CommandTrie::rankFrom(std::uint32_t start_node, TrieMatches& matches, std::size_t first,
+  std::size_t max_commands) const
 {
-  if (trie_root_ == nullptr)
-    std::cout << "Empty!\n";
-  else
-    print(trie_root_);
+  if (matches.total_ == 0 || max_commands == 0)
+    return;
+
+  // The best score goes first. Equal scores go in character order, which is the order of the
+  // words (a word comes before the longer words it starts)
+  auto worse = [&matches](const TrieMatches::RankedEntry& a, const TrieMatches::RankedEntry& b)
+  {
+    if (a.score != b.score)
+      return a.score < b.score;
+    std::string_view word_a = std::string_view(matches.word_).substr(a.word_start, a.word_length);
+    std::string_view word_b = std::string_view(matches.word_).substr(b.word_start, b.word_length);
+    if (word_a != word_b)
+      return word_a > word_b;
+    return a.is_word < b.is_word;
+  };
+
+  // The working word is used to hold the word for every entry in the queue
+  auto push = [&](std::uint32_t score, std::uint32_t node, bool is_word, std::size_t word_start,
+    std::size_t word_length)
+  {
+    std::size_t capacity = matches.queue_.capacity();
+    matches.queue_.push_back(TrieMatches::RankedEntry{ score, node, is_word, word_start, word_length });
+    matches.noteCapacity(capacity, matches.queue_.capacity());
+    std::push_heap(matches.queue_.begin(), matches.queue_.end(), worse);
+  };
+
+  std::size_t capacity = matches.word_.capacity();
+  matches.word_.assign(matches.completion_);
+  matches.noteCapacity(capacity, matches.word_.capacity());
+  push(nodes_[start_node].best_score, start_node, false, 0, matches.word_.size());
+
+  while (!matches.queue_.empty() && max_commands > 0)
+  {
+    std::pop_heap(matches.queue_.begin(), matches.queue_.end(), worse);
+    TrieMatches::RankedEntry entry = matches.queue_.back();
+    matches.queue_.pop_back();
+
+    // A word is better than anything left, so it's the next command
+    if (entry.is_word)
+    {
+      if (first > 0)
+      {
+        --first;
+        continue;
+      }
+      std::size_t words_capacity = matches.words_.capacity();
+      std::size_t ends_capacity = matches.ends_.capacity();
+      matches.words_.append(matches.word_, entry.word_start, entry.word_length);
+      matches.ends_.push_back(matches.words_.size());
+      matches.noteCapacity(words_capacity, matches.words_.capacity());
+      matches.noteCapacity(ends_capacity, matches.ends_.capacity());
+      --max_commands;
+      continue;
+    }
+
+    // Otherwise, queue the node's own word and its children
+    const TrieNode& node = nodes_[entry.node];
+    if (node.is_terminal)
+      push(node.score, entry.node, true, entry.word_start, entry.word_length);
+
+    unsigned int n_children = countChildren(node);
+    for (unsigned int slot = 0; slot < n_children; ++slot)
+    {
+      std::uint32_t child_index = child_slots_[node.first_child + slot];
+      const TrieNode& child_node = nodes_[child_index];
+
+      // Each child's word is its parent's word plus its label
+      std::size_t word_start = matches.word_.size();
+      capacity = matches.word_.capacity();
+      matches.word_.append(matches.word_, entry.word_start, entry.word_length);
+      matches.word_.append(labels_.data() + child_node.label, child_node.label_length);
+      matches.noteCapacity(capacity, matches.word_.capacity());
+      push(child_node.best_score, child_index, false, word_start, matches.word_.size() - word_start);
+    }
+  }
 }
 
-// Axe the trie
-void CommandTrie::axe(TrieNode *node)
+// Add to the usage score of a command
+bool CommandTrie::addScore(const std::string& str, std::uint32_t amount /*= 1*/)
 {
-  if (node == nullptr)
+  if (!contains(str))
+    return false;
+
+  std::uint32_t rest_of_edge = 0;
+  std::uint32_t rest_length = 0;
+  TrieNode& word_node = nodes_[std::get<1>(findNode(str, rest_of_edge, rest_length))];
+  word_node.score = amount > std::numeric_limits<std::uint32_t>::max() - word_node.score ?
+    std::numeric_limits<std::uint32_t>::max() : word_node.score + amount;
+
+  // Scores only go up, so every node on the way just needs to know if this is its new best
+  std::uint32_t curr_node = ROOT_NODE;
+  std::string::size_type pos = 0;
+  while (true)
+  {
+    TrieNode& node = nodes_[curr_node];
+    node.best_score = std::max(node.best_score, word_node.score);
+    if (pos == str.size())
+      break;
+    curr_node = child(node, index(str[pos]));
+    pos += nodes_[curr_node].label_length;
+  }
+  return true;
+}
+
+// Check if a command is in the trie
+bool CommandTrie::contains(const std::string& str) const
+{
+  std::uint32_t rest_of_edge = 0;
+  std::uint32_t rest_length = 0;
+  auto [found, node] = findNode(str, rest_of_edge, rest_length);
+  return found && rest_length == 0 && nodes_[node].is_terminal;
+}
+
+// Get the memory used
+std::size_t CommandTrie::memoryUsage() const
+{
+  std::size_t bytes = nodes_.capacity() * sizeof(TrieNode) + labels_.capacity() +
+    child_slots_.capacity() * sizeof(std::uint32_t) + free_nodes_.capacity() * sizeof(std::uint32_t) +
+    index_.capacity() * sizeof(unsigned int) + index_to_char_.capacity();
+  for (const auto& blocks : free_blocks_)
+    bytes += blocks.capacity() * sizeof(std::uint32_t);
+  return bytes;
+}
+
+// Save the trie as an image
+void CommandTrie::saveImage(const std::string& path) const
+{
+  static_assert(std::is_trivially_copyable<TrieNode>::value, "Trie nodes are written to images as they are");
+  static_assert(sizeof(TrieImageHeader::n_free_blocks) / sizeof(std::uint64_t) == N_BLOCK_SIZES,
+    "A trie image has a free list for each block size");
+
+  TrieImageHeader header{};
+  std::memcpy(header.magic, TRIE_IMAGE_MAGIC, sizeof(header.magic));
+  header.byte_order = TRIE_IMAGE_BYTE_ORDER;
+  header.node_size = sizeof(TrieNode);
+  header.mode = static_cast<std::uint32_t>(mode_);
+  header.n_chars = static_cast<std::uint32_t>(index_to_char_.size());
+  header.n_nodes = nodes_.size();
+  header.n_labels = labels_.size();
+  header.n_slots = child_slots_.size();
+  header.n_free_nodes = free_nodes_.size();
+  for (unsigned int i = 0; i < N_BLOCK_SIZES; ++i)
+    header.n_free_blocks[i] = free_blocks_[i].size();
+
+  // Write a new file and move it over the old one, so anything that has the
+  // old image mapped (possibly this trie) keeps reading what it mapped
+  std::string temp_path = path + ".tmp";
+  std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+    throw std::runtime_error("Unable to write the trie image " + path);
+
+  std::size_t offset = 0;
+  auto write = [&](const void* data, std::size_t bytes)
+  {
+    static const char padding[8] = {};
+    std::size_t start = alignImage(offset);
+    file.write(padding, static_cast<std::streamsize>(start - offset));
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+    offset = start + bytes;
+  };
+  write(&header, sizeof(header));
+  write(index_to_char_.data(), index_to_char_.size());
+  write(nodes_.data(), nodes_.size() * sizeof(TrieNode));
+  write(labels_.data(), labels_.size());
+  write(child_slots_.data(), child_slots_.size() * sizeof(std::uint32_t));
+  write(free_nodes_.data(), free_nodes_.size() * sizeof(std::uint32_t));
+  for (const auto& blocks : free_blocks_)
+    write(blocks.data(), blocks.size() * sizeof(std::uint32_t));
+
+  file.close();
+  std::error_code error;
+  if (!file)
+  {
+    std::filesystem::remove(temp_path, error);
+    throw std::runtime_error("Unable to write the trie image " + path);
+  }
+  std::filesystem::rename(temp_path, path, error);
+  if (error)
+  {
+    std::string reason = error.message();
+    std::filesystem::remove(temp_path, error);
+    throw std::runtime_error("Unable to replace the trie image " + path + ": " + reason);
+  }
+}
+
+// Open a trie image
+CommandTrie CommandTrie::openImage(const std::string& path)
+{
+  auto image = std::make_shared<MappedFile>();
+  image->open(path, true);
+  const char* data = image->data();
+  std::size_t size = image->size();
+
+  TrieImageHeader header;
+  if (size < sizeof(header) || std::memcmp(data, TRIE_IMAGE_MAGIC, sizeof(TRIE_IMAGE_MAGIC)) != 0)
+    throw std::runtime_error("'" + path + "' isn't a trie image");
+  std::memcpy(&header, data, sizeof(header));
+  if (header.byte_order != TRIE_IMAGE_BYTE_ORDER || header.node_size != sizeof(TrieNode) ||
+    header.mode > static_cast<std::uint32_t>(TrieMode::radix))
+  {
+    throw std::runtime_error("The trie image '" + path + "' was saved on a different kind of machine");
+  }
+
+  // Find each array, checking it's all in the file
+  std::size_t offset = sizeof(header);
+  auto next = [&](std::uint64_t count, std::size_t element_size)
+  {
+    std::size_t start = alignImage(offset);
+    if (start > size || count > (size - start) / element_size)
+      throw std::runtime_error("The trie image '" + path + "' is cut short");
+    offset = start + static_cast<std::size_t>(count) * element_size;
+    return data + start;
+  };
+  auto copy = [&](std::vector<std::uint32_t>& to, std::uint64_t count)
+  {
+    auto from = reinterpret_cast<const std::uint32_t*>(next(count, sizeof(std::uint32_t)));
+    to.assign(from, from + count);
+  };
+
+  // The big arrays are searched in place - only the free lists are copied
+  const char* chars = next(header.n_chars, 1);
+  CommandTrie trie(std::string(chars, header.n_chars), static_cast<TrieMode>(header.mode));
+  trie.nodes_.view(reinterpret_cast<const TrieNode*>(next(header.n_nodes, sizeof(TrieNode))), header.n_nodes);
+  trie.labels_.view(next(header.n_labels, 1), header.n_labels);
+  trie.child_slots_.view(reinterpret_cast<const std::uint32_t*>(next(header.n_slots, sizeof(std::uint32_t))),
+    header.n_slots);
+  copy(trie.free_nodes_, header.n_free_nodes);
+  for (unsigned int i = 0; i < N_BLOCK_SIZES; ++i)
+    copy(trie.free_blocks_[i], header.n_free_blocks[i]);
+
+  // The characters must be the ones the trie was built with, or the child bitmaps mean something else
+  if (trie.index_to_char_.size() != header.n_chars ||
+    !std::equal(trie.index_to_char_.begin(), trie.index_to_char_.end(), reinterpret_cast<const unsigned char*>(chars)))
+  {
+    throw std::runtime_error("The trie image '" + path + "' is damaged");
+  }
+  trie.checkImage(path);
+  trie.image_ = std::move(image);
+  return trie;
+}
+
+// Check the indices in a trie opened from an image
+void CommandTrie::checkImage(const std::string& path) const
+{
+  auto damaged = [&path]()
+  {
+    return std::runtime_error("The trie image '" + path + "' is damaged");
+  };
+
+  // An empty trie has no nodes, and nothing else either
+  if (nodes_.empty())
+  {
+    if (!labels_.empty() || !child_slots_.empty() || !free_nodes_.empty())
+      throw damaged();
+    for (const auto& blocks : free_blocks_)
+      if (!blocks.empty())
+        throw damaged();
     return;
+  }
 
-  for (unsigned int i = 0; i < trie_node_size_; ++i)
-    axe(node->children[i]);
+  // There are no bits in the child bitmaps past the last character
+  std::uint64_t unused_bits[TRIE_MASK_WORDS];
+  for (unsigned int w = 0; w < TRIE_MASK_WORDS; ++w)
+  {
+    unsigned int first = w * 64;
+    if (trie_node_size_ <= first)
+      unused_bits[w] = ~std::uint64_t(0);
+    else if (trie_node_size_ - first >= 64)
+      unused_bits[w] = 0;
+    else
+      unused_bits[w] = ~std::uint64_t(0) << (trie_node_size_ - first);
+  }
+
+  // Walk the tree from the root, so a child that's out of range, or a node that's
+  // reached twice (which would make the walks loop), is found before it's searched
+  std::vector<bool> reached(nodes_.size(), false);
+  std::vector<std::uint32_t> to_visit{ ROOT_NODE };
+  reached[ROOT_NODE] = true;
+  while (!to_visit.empty())
+  {
+    const TrieNode& node = nodes_[to_visit.back()];
+    to_visit.pop_back();
+
+    if (std::uint64_t(node.label) + node.label_length > labels_.size() ||
+      *reinterpret_cast<const unsigned char*>(&node.is_terminal) > 1)
+    {
+      throw damaged();
+    }
+    for (unsigned int w = 0; w < TRIE_MASK_WORDS; ++w)
+      if (node.child_mask[w] & unused_bits[w])
+        throw damaged();
 
-  delete[] node->children;
-  delete node;
+    unsigned int n_children = countChildren(node);
+    if (n_children == 0)
+      continue;
+    if (std::uint64_t(node.first_child) + (std::uint64_t(1) << sizeClass(n_children)) > child_slots_.size())
+      throw damaged();
+    for (unsigned int slot = 0; slot < n_children; ++slot)
+    {
+      std::uint32_t child_index = child_slots_[node.first_child + slot];
+      if (child_index >= nodes_.size() || reached[child_index])
+        throw damaged();
+      reached[child_index] = true;
+      to_visit.push_back(child_index);
+    }
+  }
+
+  // The free lists must only hold what the tree isn't using, as they're reused by inserts
+  for (auto node : free_nodes_)
+  {
+    if (node >= nodes_.size() || reached[node])
+      throw damaged();
+    reached[node] = true;
+  }
+  for (unsigned int size_class = 0; size_class < N_BLOCK_SIZES; ++size_class)
+    for (auto block : free_blocks_[size_class])
+      if (std::uint64_t(block) + (std::uint64_t(1) << size_class) > child_slots_.size())
+        throw damaged();
+}
+
+// Print out the trie
+void CommandTrie::print()
+{
+  if (nodes_.empty())
+    std::cout << "Empty!\n";
+  else
+  {
+    std::string word;
+    print(ROOT_NODE, word);
+  }
 }
 
 // Build the index from a set of valid chars
 void CommandTrie::buildIndex(const std::string& valid_chars)
 {
-  // We're going to build a vector of 126 chars for the valid
-  // ASCII set. Any that aren't in valid_chars get set to 255 (invalid)
-  // and any that are get an increasing index
+  // We're going to build a vector with an entry for every byte. Any that
+  // aren't in valid_chars get set to 255 (invalid) and any that are get an
+  // increasing index. Bytes from 128 up are allowed, so commands can be UTF-8
   unsigned int idx = 0;
 
-  // The first 32 characters (0-31) are invalid, so put 32 invalid values in
-  // the vector
+  // The first 32 characters (0-31) are control characters, so put 32 invalid
+  // values in the vector
   index_.insert(index_.begin(), 32, 255);
 
-  // Do the rest of the characters from 32-126
-  for (unsigned char c = 32; c < 127; ++c)
+  // Do the rest of the bytes from 32-255
+  for (unsigned int c = 32; c < 256; ++c)
   {
-    if (valid_chars.find(c) != std::string::npos)
+    if (valid_chars.find(static_cast<char>(c)) != std::string::npos)
     {
       index_.push_back(idx++);
-      index_to_char_.push_back(c);
+      index_to_char_.push_back(static_cast<unsigned char>(c));
     }
     else
       index_.push_back(255);
@@ -160,82 +769,372 @@ void CommandTrie::buildIndex(const std::string& valid_chars)
 }
 
 // Create a new node
-TrieNode* CommandTrie::createTrieNode()
-{
-  TrieNode* new_node = new TrieNode;
-  new_node->children = new TrieNode*[trie_node_size_];
-  for (unsigned int i = 0; i < trie_node_size_; ++i) 
-    new_node->children[i] = nullptr;
-  new_node->is_terminal = false;
-  new_node->word_to_here = "";
+std::uint32_t CommandTrie::createTrieNode()
+{
+  if (!free_nodes_.empty())
+  {
+    std::uint32_t node = free_nodes_.back();
+    free_nodes_.pop_back();
+    nodes_[node] = TrieNode{};
+    return node;
+  }
+
+  if (nodes_.size() >= std::numeric_limits<std::uint32_t>::max())
+    throw std::length_error("The command trie has too many nodes");
+
+  nodes_.emplace_back();
+  return static_cast<std::uint32_t>(nodes_.size() - 1);
+}
+
+// Get the child of a node
+std::uint32_t CommandTrie::child(const TrieNode& node, unsigned int idx) const
+{
+  unsigned int word = idx / 64;
+  std::uint64_t bit = std::uint64_t(1) << (idx % 64);
+  if (!(node.child_mask[word] & bit))
+    return ROOT_NODE;
+
+  // The child's position in the block is the number of children before it
+  unsigned int rank = popCount(node.child_mask[word] & (bit - 1));
+  for (unsigned int w = 0; w < word; ++w)
+    rank += popCount(node.child_mask[w]);
+  return child_slots_[node.first_child + rank];
+}
+
+// Add a new child to a node
+std::uint32_t CommandTrie::addChild(std::uint32_t node, const std::string& str, std::string::size_type pos,
+  std::string::size_type length)
+{
+  if (labels_.size() + length > std::numeric_limits<std::uint32_t>::max())
+    throw std::length_error("The command trie has run out of space for labels");
+
+  std::uint32_t new_node = createTrieNode();
+  nodes_[new_node].label = static_cast<std::uint32_t>(labels_.size());
+  nodes_[new_node].label_length = static_cast<std::uint32_t>(length);
+  labels_.append(str.data() + pos, length);
+
+  linkChild(node, index(str[pos]), new_node);
   return new_node;
 }
 
-// Get the longest unambiguous string from the current node
-std::tuple<std::size_t, std::string, TrieNode*> CommandTrie::getLongestString(TrieNode* node) const
+// Link a node in as a child
+void CommandTrie::linkChild(std::uint32_t node, unsigned int idx, std::uint32_t child_node)
 {
-  // If this is a terminal node, return this as the suggestion, or we could
-  // make the user have to delete our completion
-  if (node->is_terminal)
-    return std::make_tuple(1, node->word_to_here, node);
+  TrieNode& parent = nodes_[node];
 
-  // See how many children the node has. 
-  // - if there's zero, the tree is wrong - it should be a terminal node and caught above
-  // - if there's one, we can continue to follow as it's a unique path
-  // - if it's more than one, we can't got any further, so retuen the number of paths and
-  //   this node's word_to_here
-  std::vector<unsigned int> live_children = getLiveChildren(node);
-  if (live_children.empty())
-    throw std::runtime_error("The triw is incorrectly formatted - node should be terminal");
-  else if (live_children.size() == 1)
-    return getLongestString(node->children[live_children[0]]);
+  unsigned int word = idx / 64;
+  std::uint64_t bit = std::uint64_t(1) << (idx % 64);
+  unsigned int n_children = countChildren(parent);
+  unsigned int rank = popCount(parent.child_mask[word] & (bit - 1));
+  for (unsigned int w = 0; w < word; ++w)
+    rank += popCount(parent.child_mask[w]);
 
-  // Number of live children must be > 1 to get here
-  return std::make_tuple(live_children.size(), node->word_to_here, node);
+  // Blocks are sized to powers of 2, so if the number of children is 0 or a
+  // power of 2 the block is full and we need to move to a bigger one
+  if ((n_children & (n_children - 1)) == 0)
+  {
+    unsigned int old_class = sizeClass(n_children);
+    std::uint32_t new_block = allocateChildBlock(sizeClass(n_children + 1));
+    for (unsigned int i = 0; i < rank; ++i)
+      child_slots_[new_block + i] = child_slots_[parent.first_child + i];
+    for (unsigned int i = rank; i < n_children; ++i)
+      child_slots_[new_block + i + 1] = child_slots_[parent.first_child + i];
+    if (n_children > 0)
+      free_blocks_[old_class].push_back(parent.first_child);
+    parent.first_child = new_block;
+  }
+  else
+  {
+    // Shift the later children up to make room
+    for (unsigned int i = n_children; i > rank; --i)
+      child_slots_[parent.first_child + i] = child_slots_[parent.first_child + i - 1];
+  }
+
+  child_slots_[parent.first_child + rank] = child_node;
+  parent.child_mask[word] |= bit;
+}
+
+// Unlink a child from a node
+void CommandTrie::unlinkChild(std::uint32_t node, unsigned int idx)
+{
+  TrieNode& parent = nodes_[node];
+
+  unsigned int word = idx / 64;
+  std::uint64_t bit = std::uint64_t(1) << (idx % 64);
+  unsigned int n_children = countChildren(parent);
+  unsigned int rank = popCount(parent.child_mask[word] & (bit - 1));
+  for (unsigned int w = 0; w < word; ++w)
+    rank += popCount(parent.child_mask[w]);
+  parent.child_mask[word] &= ~bit;
+
+  // Keep each block the smallest power of 2 that fits, as linkChild() expects
+  unsigned int n_left = n_children - 1;
+  if (n_left == 0)
+  {
+    free_blocks_[0].push_back(parent.first_child);
+    parent.first_child = 0;
+  }
+  else if ((n_left & (n_left - 1)) == 0)
+  {
+    std::uint32_t new_block = allocateChildBlock(sizeClass(n_left));
+    for (unsigned int i = 0; i < rank; ++i)
+      child_slots_[new_block + i] = child_slots_[parent.first_child + i];
+    for (unsigned int i = rank + 1; i < n_children; ++i)
+      child_slots_[new_block + i - 1] = child_slots_[parent.first_child + i];
+    free_blocks_[sizeClass(n_children)].push_back(parent.first_child);
+    parent.first_child = new_block;
+  }
+  else
+  {
+    // Shift the later children down over the gap
+    for (unsigned int i = rank; i + 1 < n_children; ++i)
+      child_slots_[parent.first_child + i] = child_slots_[parent.first_child + i + 1];
+  }
+}
+
+// Free a node and everything below it
+void CommandTrie::freeSubtree(std::uint32_t node)
+{
+  const TrieNode& curr_node = nodes_[node];
+  unsigned int n_children = countChildren(curr_node);
+  for (unsigned int slot = 0; slot < n_children; ++slot)
+    freeSubtree(child_slots_[curr_node.first_child + slot]);
+  if (n_children > 0)
+    free_blocks_[sizeClass(n_children)].push_back(curr_node.first_child);
+  free_nodes_.push_back(node);
+}
+
+// Split a node part way along its edge
+void CommandTrie::splitNode(std::uint32_t node, std::uint32_t length)
+{
+  // The new node takes over everything below the split. The labels are
+  // shared, so the old label's storage is just divided between the two
+  std::uint32_t tail = createTrieNode();
+  TrieNode& old_node = nodes_[node];
+  TrieNode& tail_node = nodes_[tail];
+  tail_node = old_node;
+  tail_node.label = old_node.label + length;
+  tail_node.label_length = old_node.label_length - length;
+
+  // The old node keeps its place in its parent (and its word count), but now just leads to the tail
+  old_node = TrieNode{};
+  old_node.label = tail_node.label - length;
+  old_node.label_length = length;
+  old_node.n_terminals = tail_node.n_terminals;
+  old_node.best_score = tail_node.best_score;
+  linkChild(node, index(labels_[tail_node.label]), tail);
+}
+
+// Get a block to hold children
+std::uint32_t CommandTrie::allocateChildBlock(unsigned int size_class)
+{
+  if (!free_blocks_[size_class].empty())
+  {
+    std::uint32_t block = free_blocks_[size_class].back();
+    free_blocks_[size_class].pop_back();
+    return block;
+  }
+
+  std::size_t block = child_slots_.size();
+  if (block + (std::size_t(1) << size_class) > std::numeric_limits<std::uint32_t>::max())
+    throw std::length_error("The command trie has too many child slots");
+  child_slots_.resize(block + (std::size_t(1) << size_class), ROOT_NODE);
+  return static_cast<std::uint32_t>(block);
+}
+
+// Count the children of a node
+unsigned int CommandTrie::countChildren(const TrieNode& node) const
+{
+  unsigned int n_children = 0;
+  for (auto m : node.child_mask)
+    n_children += popCount(m);
+  return n_children;
+}
+
+// Get the next live child of a node
+unsigned int CommandTrie::nextChild(const TrieNode& node, unsigned int from) const
+{
+  for (unsigned int word = from / 64; word < TRIE_MASK_WORDS; ++word)
+  {
+    // Mask off the bits before where we're starting from
+    std::uint64_t mask = node.child_mask[word];
+    if (word == from / 64)
+      mask &= ~std::uint64_t(0) << (from % 64);
+    if (mask)
+      return word * 64 + countTrailingZeros(mask);
+  }
+  return trie_node_size_;
 }
 
-// Get a list of live children of the current node
-std::vector<unsigned int> CommandTrie::getLiveChildren(TrieNode* node) const
+// Find the node where a string ends
+std::tuple<bool, std::uint32_t> CommandTrie::findNode(const std::string& str, std::uint32_t& rest_of_edge,
+  std::uint32_t& rest_length) const
 {
-  std::vector<unsigned int> live_children;
-  for (unsigned int i = 0; i < trie_node_size_; ++i)
-    if (node->children[i] != nullptr)
-      live_children.push_back(i);
-  return live_children;
+  // If the trie is empty, there's nothing to match
+  if (nodes_.empty())
+    return std::make_tuple(false, ROOT_NODE);
+
+  std::uint32_t curr_node = ROOT_NODE;
+  std::string::size_type pos = 0;
+  rest_of_edge = 0;
+  rest_length = 0;
+  while (pos < str.size())
+  {
+    unsigned int idx = index(str[pos]);
+    if (idx == 255)
+      return std::make_tuple(false, ROOT_NODE);  // The character can't be in any command
+    curr_node = child(nodes_[curr_node], idx);
+    if (curr_node == ROOT_NODE)
+      return std::make_tuple(false, ROOT_NODE);  // If we hit a missing child, the search string isn't in the trie
+
+    // The rest of the string has to match the edge label, as far as either goes
+    const TrieNode& node = nodes_[curr_node];
+    std::uint32_t n_compare = static_cast<std::uint32_t>(
+      std::min<std::string::size_type>(node.label_length, str.size() - pos));
+    if (str.compare(pos, n_compare, labels_.data() + node.label, n_compare) != 0)
+      return std::make_tuple(false, ROOT_NODE);
+    rest_of_edge = node.label + n_compare;
+    rest_length = node.label_length - n_compare;
+    pos += n_compare;
+  }
+  return std::make_tuple(true, curr_node);
+}
+
+// Get the position a cursor is at
+std::tuple<bool, std::uint32_t> CommandTrie::cursorNode(const TrieCursor& cursor, std::uint32_t& rest_of_edge,
+  std::uint32_t& rest_length) const
+{
+  rest_of_edge = 0;
+  rest_length = 0;
+  if (nodes_.empty() || !cursor.found() || cursor.version_ != version_)
+    return std::make_tuple(false, ROOT_NODE);
+  if (cursor.steps_.empty())
+    return std::make_tuple(true, ROOT_NODE);
+
+  const TrieCursor::Step& step = cursor.steps_.back();
+  const TrieNode& node = nodes_[step.node];
+  rest_of_edge = node.label + step.edge_pos;
+  rest_length = node.label_length - step.edge_pos;
+  return std::make_tuple(true, step.node);
+}
+
+// Fill in the completion of a string that's in the trie
+std::uint32_t CommandTrie::complete(std::string_view str, std::uint32_t node, std::uint32_t rest_of_edge,
+  std::uint32_t rest_length, TrieMatches& matches) const
+{
+  // If the string stops part way along an edge, the rest of the edge is unambiguous.
+  // Then we want to auto complete from where our string stops, so we need to see if
+  // there are any unambiguous paths (single children) from here
+  std::size_t capacity = matches.completion_.capacity();
+  matches.completion_.assign(str);
+  matches.completion_.append(labels_.data() + rest_of_edge, rest_length);
+  auto [n_paths, last_node] = getLongestString(node, matches.completion_);
+  matches.noteCapacity(capacity, matches.completion_.capacity());
+  matches.n_paths_ = n_paths;
+  matches.total_ = nodes_[last_node].n_terminals;
+  return last_node;
+}
+
+// Get the longest unambiguous string from the current node
+std::tuple<std::size_t, std::uint32_t> CommandTrie::getLongestString(std::uint32_t node, std::string& word) const
+{
+  while (true)
+  {
+    const TrieNode& curr_node = nodes_[node];
+
+    // If this is a terminal node, return this as the suggestion, or we could
+    // make the user have to delete our completion
+    if (curr_node.is_terminal)
+      return std::make_tuple(1, node);
+
+    // See how many children the node has. 
+    // - if there's zero, the tree is wrong - it should be a terminal node and caught above
+    // - if there's one, we can continue to follow as it's a unique path
+    // - if it's more than one, we can't got any further, so retuen the number of paths and
+    //   this node
+    unsigned int n_children = countChildren(curr_node);
+    if (n_children == 0)
+      throw std::runtime_error("The trie is incorrectly formatted - node should be terminal");
+    else if (n_children > 1)
+      return std::make_tuple(n_children, node);
+
+    // Follow the only child, taking its whole label in one go
+    node = child_slots_[curr_node.first_child];
+    word.append(labels_.data() + nodes_[node].label, nodes_[node].label_length);
+  }
 }
 
 // Get a list of possible commands
-void CommandTrie::getPossibleCommands(TrieNode* node, std::vector<std::string>& poss_cmds) const
+void CommandTrie::getPossibleCommands(std::uint32_t node, TrieMatches& matches, std::size_t& skip,
+  std::size_t& remaining) const
 {
-  if (node->is_terminal)
-    poss_cmds.push_back(node->word_to_here);
+  const TrieNode& curr_node = nodes_[node];
+
+  // We can skip a whole subtree without walking it if it's all before the first command wanted
+  if (skip >= curr_node.n_terminals)
+  {
+    skip -= curr_node.n_terminals;
+    return;
+  }
+
+  if (curr_node.is_terminal)
+  {
+    if (skip > 0)
+      --skip;
+    else if (remaining > 0)
+    {
+      std::size_t words_capacity = matches.words_.capacity();
+      std::size_t ends_capacity = matches.ends_.capacity();
+      matches.words_.append(matches.word_);
+      matches.ends_.push_back(matches.words_.size());
+      matches.noteCapacity(words_capacity, matches.words_.capacity());
+      matches.noteCapacity(ends_capacity, matches.ends_.capacity());
+      --remaining;
+    }
+  }
 
-  std::vector<unsigned int> live_children = getLiveChildren(node);
-  for (auto c : live_children)
-    getPossibleCommands(node->children[c], poss_cmds);
+  // The children are kept in character order
+  unsigned int n_children = countChildren(curr_node);
+  for (unsigned int slot = 0; slot < n_children && remaining > 0; ++slot)
+  {
+    const TrieNode& child_node = nodes_[child_slots_[curr_node.first_child + slot]];
+    std::size_t capacity = matches.word_.capacity();
+    matches.word_.append(labels_.data() + child_node.label, child_node.label_length);
+    matches.noteCapacity(capacity, matches.word_.capacity());
+    getPossibleCommands(child_slots_[curr_node.first_child + slot], matches, skip, remaining);
+    matches.word_.resize(matches.word_.size() - child_node.label_length);
+  }
 }
 
 // Recursively print out each node of the trie
-void CommandTrie::print(TrieNode* node)
+void CommandTrie::print(std::uint32_t node, std::string& word)
 {
+  const TrieNode& curr_node = nodes_[node];
   std::cout << "----- Begin Node -----\n";
   std::cout << "Node: " << node << "\n";
-  std::cout << "Word to here: " << node->word_to_here << "\n";
+  std::cout << "Edge label: " << std::string_view(labels_.data() + curr_node.label, curr_node.label_length) << "\n";
+  std::cout << "Word to here: " << word << "\n";
   std::cout << "Live children: ";
-  std::vector<unsigned int> live_children = getLiveChildren(node);
-  if (live_children.empty())
+  if (countChildren(curr_node) == 0)
     std::cout << "None";
   else
   {
-    for (auto c : live_children)
+    for (unsigned int c = nextChild(curr_node, 0); c < trie_node_size_; c = nextChild(curr_node, c + 1))
       std::cout << "[" << index_to_char_[c] << "] ";
   }
   std::cout << "\n";
-  std::cout << "Is terminal: " << (node->is_terminal ? "true" : "false") << "\n";
+  std::cout << "Is terminal: " << (curr_node.is_terminal ? "true" : "false") << "\n";
+  std::cout << "Words below: " << curr_node.n_terminals << "\n";
+  std::cout << "Score: " << curr_node.score << " (best below: " << curr_node.best_score << ")\n";
   std::cout << "----- End Node -----\n";
 
-  for (auto c : live_children)
+  unsigned int n_children = countChildren(curr_node);
+  for (unsigned int slot = 0; slot < n_children; ++slot)
   {
-    print(node->children[c]);
+    std::uint32_t child_node = child_slots_[curr_node.first_child + slot];
+    std::uint32_t label_length = nodes_[child_node].label_length;
+    word.append(labels_.data() + nodes_[child_node].label, label_length);
+    print(child_node, word);
+    word.resize(word.size() - label_length);
   }
 }
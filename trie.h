@@ -31,20 +31,322 @@
 #include <vector>
 #include <string>
 #include <tuple>
+#include <cstdint>
+#include <string_view>
+#include <limits>
+#include <memory>
+
+class MappedFile;
 
 /*!
  * For handling the command completion we need to create a trie
  * data structure to allow fast search for matching commands. 
+ *
+ * The nodes are all kept in one vector and refer to each other by 32-bit
+ * index rather than by pointer. Each node has a bitmap with one bit per valid
+ * character saying which children exist, and the children themselves are kept
+ * (in character order) in a small block of a shared slot vector, so the
+ * position of a child in the block is the number of bits set below its bit.
+ * This means a node only pays for the children it actually has.
+ *
+ * In radix mode, chains of nodes with a single child are collapsed into one
+ * node, and each node holds the label of the edge leading to it (kept in a
+ * shared label string). Children are indexed by the first character of their
+ * label. In simple mode every label is one character long.
  */
 
+//! How the trie lays out its nodes
+enum class TrieMode
+{
+  simple,  /*!< One node per character */
+  radix    /*!< Chains with no branches are compressed into one node (path compression) */
+};
+
+//! The number of 64-bit words in a node's child bitmap (enough for every byte, so UTF-8 can be used)
+const unsigned int TRIE_MASK_WORDS = 4;
+
 /*! 
  * The node for the trie class to use
  */
 struct TrieNode
 {
-  TrieNode** children = nullptr; /*!< An array of TrieNode pointers, one per valid character */
-  bool is_terminal = false;;     /*!< Whether this node is the end of a word */
-  std::string word_to_here;      /*!< The letters from the nodes traversed to here (to save backwards checks) */
+  std::uint64_t child_mask[TRIE_MASK_WORDS] = {}; /*!< Which children exist, one bit per valid character */
+  std::uint32_t first_child = 0;                  /*!< Offset of this node's child block in the slot vector */
+  std::uint32_t label = 0;                        /*!< Offset of the label of the edge to this node */
+  std::uint32_t label_length = 0;                 /*!< The length of the edge label */
+  std::uint32_t n_terminals = 0;                  /*!< The number of words that end in this node's subtree */
+  std::uint32_t score = 0;                        /*!< How often the word ending here has been used */
+  std::uint32_t best_score = 0;                   /*!< The highest score of any word in this node's subtree */
+  std::uint32_t value = 0;                        /*!< A value kept with the word ending here (e.g. a handler's slot) */
+  bool is_terminal = false;                       /*!< Whether this node is the end of a word */
+};
+
+/*!
+ * The results of a search of the trie. Keep one of these and pass it to
+ * each search so its storage is reused - once it has grown to fit, searches
+ * don't need to allocate at all
+ */
+class TrieMatches
+{
+public:
+
+  /*!
+   * Get the number of paths at the last unambiguous point
+   * \return The number of paths (1 means the completion is a whole command, 0 means no match)
+   */
+  std::size_t paths() const { return n_paths_; }
+
+  /*!
+   * Get the search string extended to the last unambiguous point
+   * \return The completion
+   */
+  const std::string& completion() const { return completion_; }
+
+  /*!
+   * Get the number of matching commands found (if they were requested)
+   * \return The number of commands
+   */
+  std::size_t size() const { return ends_.size(); }
+
+  /*!
+   * Get the total number of commands that match, whether they were returned or not
+   * \return The number of matching commands
+   */
+  std::size_t total() const { return total_; }
+
+  /*!
+   * Get one of the matching commands
+   * \param i The index of the command, in character order
+   * \return A view of the command, valid until the next search with these results
+   */
+  std::string_view operator[](std::size_t i) const
+  {
+    std::size_t start = i == 0 ? 0 : ends_[i - 1];
+    return std::string_view(words_).substr(start, ends_[i] - start);
+  }
+
+  /*!
+   * Get the number of times the storage had to grow during the last search
+   * \return The number of allocations
+   */
+  std::size_t allocations() const { return allocations_; }
+
+  /*!
+   * Clear the results, but keep the storage for the next search
+   */
+  void clear()
+  {
+    n_paths_ = 0;
+    total_ = 0;
+    completion_.clear();
+    words_.clear();
+    ends_.clear();
+    word_.clear();
+    queue_.clear();
+    allocations_ = 0;
+  }
+
+private:
+  friend class CommandTrie;
+
+  /*!
+   * Count an allocation if a buffer's capacity changed
+   * \param before The capacity before changing the buffer
+   * \param after The capacity after changing the buffer
+   */
+  void noteCapacity(std::size_t before, std::size_t after)
+  {
+    if (after != before)
+      ++allocations_;
+  }
+
+  //! The number of paths at the last unambiguous point
+  std::size_t n_paths_ = 0;
+
+  //! The search string extended to the last unambiguous point
+  std::string completion_;
+
+  //! The total number of matching commands
+  std::size_t total_ = 0;
+
+  //! All the matching commands, one after another
+  std::string words_;
+
+  //! Where each command in words_ ends
+  std::vector<std::size_t> ends_;
+
+  //! Working space for building the commands
+  std::string word_;
+
+  //! An entry in the queue for a ranked search
+  struct RankedEntry
+  {
+    std::uint32_t score;     /*!< The best score we can get from this entry */
+    std::uint32_t node;      /*!< The node for the entry */
+    bool is_word;            /*!< True for the word ending at node, rather than the node's subtree */
+    std::size_t word_start;  /*!< Where the word to the node starts in word_ */
+    std::size_t word_length; /*!< The length of the word to the node */
+  };
+
+  //! The heap of entries to visit for a ranked search
+  std::vector<RankedEntry> queue_;
+
+  //! The number of allocations during the last search
+  std::size_t allocations_ = 0;
+};
+
+/*!
+ * A position in a trie, reached by following a prefix one character at a time.
+ * Keep one of these for a line that's being typed and move it with
+ * CommandTrie::moveCursor() - only the characters that changed since it last
+ * moved are walked, so searching from it doesn't depend on the line's length
+ */
+class TrieCursor
+{
+public:
+  /*!
+   * Get the prefix the cursor is at
+   * \return The prefix
+   */
+  const std::string& prefix() const { return prefix_; }
+
+  /*!
+   * Check if the whole prefix is in the trie
+   * \return True if some command starts with the prefix
+   */
+  bool found() const { return matched_ == prefix_.size(); }
+
+  //! Move the cursor back to the root
+  void clear()
+  {
+    prefix_.clear();
+    steps_.clear();
+    matched_ = 0;
+  }
+
+private:
+  friend class CommandTrie;
+
+  //! Where in the trie a character of the prefix took us
+  struct Step
+  {
+    std::uint32_t node;      /*!< The node whose edge we're on */
+    std::uint32_t edge_pos;  /*!< How many characters of the node's label we've matched */
+  };
+
+  //! The prefix
+  std::string prefix_;
+
+  //! Where each of the matched characters of the prefix took us
+  std::vector<Step> steps_;
+
+  //! How many characters of the prefix are in the trie (the rest don't match anything)
+  std::size_t matched_ = 0;
+
+  //! The trie's version when the steps were found, as changing the trie moves nodes about
+  std::uint64_t version_ = 0;
+};
+
+/*!
+ * One of the arrays a trie keeps its nodes in. It either owns its elements,
+ * or looks at ones that are somewhere else (a trie image mapped from a file),
+ * which are copied the first time the array is changed. Reads go through the
+ * same pointer either way, so searching a mapped trie costs the same as
+ * searching one built in memory
+ */
+template <typename T>
+class TrieArray
+{
+public:
+  TrieArray() = default;
+
+  TrieArray(const TrieArray& other) :
+    owned_(other.owned_),
+    data_(other.viewing_ ? other.data_ : owned_.data()),
+    size_(other.size_),
+    viewing_(other.viewing_)
+  {
+  }
+
+  TrieArray(TrieArray&& other) noexcept :
+    owned_(std::move(other.owned_)),
+    data_(other.viewing_ ? other.data_ : owned_.data()),
+    size_(other.size_),
+    viewing_(other.viewing_)
+  {
+    other.clear();
+  }
+
+  TrieArray& operator=(TrieArray other) noexcept
+  {
+    owned_.swap(other.owned_);
+    data_ = other.viewing_ ? other.data_ : owned_.data();
+    size_ = other.size_;
+    viewing_ = other.viewing_;
+    return *this;
+  }
+
+  /*!
+   * Look at elements kept somewhere else, instead of owning them
+   * \param data The elements, which must stay where they are until the array is changed or goes
+   * \param size The number of elements
+   */
+  void view(const T* data, std::size_t size)
+  {
+    owned_ = std::vector<T>();
+    data_ = data;
+    size_ = size;
+    viewing_ = true;
+  }
+
+  //! Check if the array is looking at elements it doesn't own
+  bool isView() const { return viewing_; }
+
+  const T& operator[](std::size_t i) const { return data_[i]; }
+  T& operator[](std::size_t i) { own(); return owned_[i]; }
+  const T* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  //! Get the number of elements there's room for (nothing is allocated for a view)
+  std::size_t capacity() const { return owned_.capacity(); }
+
+  void emplace_back() { own(); owned_.emplace_back(); sync(); }
+  void resize(std::size_t size, const T& value) { own(); owned_.resize(size, value); sync(); }
+  void append(const T* values, std::size_t n) { own(); owned_.insert(owned_.end(), values, values + n); sync(); }
+  void clear() { owned_.clear(); viewing_ = false; sync(); }
+
+private:
+
+  //! Copy the elements being looked at, so they can be changed
+  void own()
+  {
+    if (viewing_)
+    {
+      owned_.assign(data_, data_ + size_);
+      viewing_ = false;
+      sync();
+    }
+  }
+
+  //! Point at the owned elements again after they've changed
+  void sync()
+  {
+    data_ = owned_.data();
+    size_ = owned_.size();
+  }
+
+  //! The elements, if the array owns them
+  std::vector<T> owned_;
+
+  //! The elements being read
+  const T* data_ = nullptr;
+
+  //! The number of elements
+  std::size_t size_ = 0;
+
+  //! Whether the elements are somewhere else
+  bool viewing_ = false;
 };
 
 /*!
@@ -58,20 +360,36 @@ public:
   /*!
    * Construct the class with characters that are allowed
    * \param valid_chars The list of allowable chars in a command name
+   * \param mode How to lay out the nodes (default is the compressed radix layout)
    */
-  CommandTrie(const std::string& valid_chars);
-
-  /*!
-   * Destructor destroys the tree 
-   */
-  ~CommandTrie();
+  CommandTrie(const std::string& valid_chars, TrieMode mode = TrieMode::radix);
 
   /*!
    * Insert a command into the trie
    * \param str The string to insert into the trie
+   * \param value A value to keep with the command, found again with lookup() (default is 0).
+   *              If the command is already there, its value is replaced
    * \throws std::out_of_range The string includes invalid characters (based on constructor call)
+   * \throws std::length_error The trie has run out of node indices
+   */
+  void insert(const std::string& str, std::uint32_t value = 0);
+
+  /*!
+   * Remove a command from the trie
+   * \param str The command to remove
+   * \return True if the command was in the trie
+   * \note The nodes and child blocks that are no longer needed are reused by later inserts.
+   *       The space for their labels isn't, until the trie is empty
+   */
+  bool remove(const std::string& str);
+
+  /*!
+   * Find the value kept with a command
+   * \param str The command to look for
+   * \retval value Set to the command's value, if it's in the trie
+   * \return True if str was inserted as a command (not just as part of one)
    */
-  void insert(const std::string& str);
+  bool lookup(const std::string& str, std::uint32_t& value) const;
 
   /*!
    * Search for a string within the trie
@@ -86,26 +404,142 @@ public:
   std::tuple<std::size_t, std::string, std::vector<std::string>> 
     find(const std::string& str, bool ret_pos = false) const;
 
+  //! Pass as the maximum number of commands to find to get all of them
+  static constexpr std::size_t ALL_COMMANDS = std::numeric_limits<std::size_t>::max();
+
+  /*!
+   * Search for a string within the trie, putting the results in a reusable buffer
+   * \param str The string to search for
+   * \retval matches The results of the search (anything already there is cleared first)
+   * \param ret_pos If true, also find matching commands. Setting to true increases search time
+   *                (default is false).
+   * \param first The number of matching commands to skip before the ones returned (default is 0)
+   * \param max_commands The most matching commands to return (default is all of them)
+   * \note Unlike the version returning a tuple, this doesn't allocate once matches is big enough.
+   *       The total number of matches is always set, and subtrees before first are skipped
+   *       without being walked, so getting a page of a large set of matches is cheap
+   */
+  void find(const std::string& str, TrieMatches& matches, bool ret_pos = false, std::size_t first = 0,
+    std::size_t max_commands = ALL_COMMANDS) const;
+
+  /*!
+   * Search for a string within the trie, returning the matching commands with the highest scores
+   * \param str The string to search for
+   * \retval matches The results of the search (anything already there is cleared first)
+   * \param first The number of the best matching commands to skip before the ones returned
+   * \param max_commands The most matching commands to return
+   * \note The commands come out best first (ties are in character order). Each node knows the best score
+   *       in its subtree, so we search best first and only visit the nodes on the way to the commands
+   *       returned, rather than finding every match and sorting them
+   */
+  void findRanked(const std::string& str, TrieMatches& matches, std::size_t first, std::size_t max_commands) const;
+
+  /*!
+   * Move a cursor to a new prefix, walking only the part that's different from its old prefix
+   * \retval cursor The cursor to move. If the trie has changed since it last moved, it starts again from the root
+   * \param str The new prefix
+   * \note Typing a character moves the cursor one character down, and deleting one moves it back one
+   */
+  void moveCursor(TrieCursor& cursor, std::string_view str) const;
+
+  /*!
+   * Search for the prefix a cursor is at, like find() but without walking the prefix again
+   * \param cursor The cursor, which must have been moved by this trie
+   * \retval matches The results of the search (anything already there is cleared first)
+   * \param ret_pos If true, also find matching commands (default is false)
+   * \param first The number of matching commands to skip before the ones returned (default is 0)
+   * \param max_commands The most matching commands to return (default is all of them)
+   */
+  void find(const TrieCursor& cursor, TrieMatches& matches, bool ret_pos = false, std::size_t first = 0,
+    std::size_t max_commands = ALL_COMMANDS) const;
+
+  /*!
+   * Search for the prefix a cursor is at, returning the best scoring matches like findRanked()
+   * \param cursor The cursor, which must have been moved by this trie
+   * \retval matches The results of the search (anything already there is cleared first)
+   * \param first The number of the best matching commands to skip before the ones returned
+   * \param max_commands The most matching commands to return
+   */
+  void findRanked(const TrieCursor& cursor, TrieMatches& matches, std::size_t first, std::size_t max_commands) const;
+
+  /*!
+   * Increase the usage score of a command, so it ranks higher in findRanked()
+   * \param str The command that was used
+   * \param amount How much to increase the score by (default is 1)
+   * \return True if the command is in the trie (otherwise nothing changes)
+   */
+  bool addScore(const std::string& str, std::uint32_t amount = 1);
+
+  /*!
+   * Check whether a command is in the trie
+   * \param str The command to look for
+   * \return True if str was inserted as a command (not just as part of one)
+   */
+  bool contains(const std::string& str) const;
+
+  /*!
+   * Get the memory the trie is using
+   * \return The number of bytes allocated for the nodes, labels, child blocks and free lists
+   *         (this includes spare capacity, but not the size of the CommandTrie itself)
+   */
+  std::size_t memoryUsage() const;
+
+  /*!
+   * Get the number of nodes in the trie
+   * \return The number of nodes in use (not counting any on the free list)
+   */
+  std::size_t nodeCount() const { return nodes_.size() - free_nodes_.size(); }
+
+  /*!
+   * Save the trie as an image that openImage() can map straight back in. The image
+   * uses indices rather than pointers, so it can be mapped anywhere. It's written
+   * alongside the old image and then replaces it, so tries with the old image open
+   * (including this one) can still use it
+   * \param path The path of the image file
+   * \throws std::runtime_error The image couldn't be written
+   */
+  void saveImage(const std::string& path) const;
+
+  /*!
+   * Open a trie saved with saveImage(). The nodes, labels and child blocks are searched where
+   * they are in the mapped file, so nothing is built when the trie is opened - the indices are
+   * only read once, to check they stay inside the image. They're copied into memory the first
+   * time the trie is changed
+   * \param path The path of the image file
+   * \return The trie
+   * \throws std::runtime_error The file couldn't be opened, isn't an image from this kind of machine,
+   *                            or is damaged
+   */
+  static CommandTrie openImage(const std::string& path);
+
+  /*!
+   * Check if the trie is still being searched in the image it was opened from
+   * \return True if the nodes are in a mapped image
+   */
+  bool isImage() const { return nodes_.isView(); }
+
   /*!
    * Just for debugging purposes, print out the tree
-   * \note This function just checks the root isn't nullptr, and calls the recursive version
+   * \note This function just checks the trie isn't empty, and calls the recursive version
    */
   void print();
   
 private:
 
-  /*!
-   * Destroy the trie
-   */
-  void axe(TrieNode* node);
+  //! The index of the root node (no node can have the root as a child, so 0 also means 'no child')
+  static constexpr std::uint32_t ROOT_NODE = 0;
+
+  //! The number of child block sizes we keep free lists for (block sizes are powers of 2,
+  //! up to the 2^8 = 256 children a node can have)
+  static constexpr unsigned int N_BLOCK_SIZES = 9;
 
   /*!
-   * Build the index for valid ASCII characters -> trie node array position
+   * Build the index for valid bytes -> trie node array position
    */
   void buildIndex(const std::string& valid_chars);
 
   /*!
-   * Get the index for a given ASCII char
+   * Get the index for a given byte
    * \param c The character to get the index for
    * \return The index for the given character, or 255 if the character is invalid
    * \note This is written as a function to allow us to change the underlying method later
@@ -118,45 +552,176 @@ private:
   }
 
   /*!
-   * Create a new node
-   * \return The new node
+   * Create a new node at the end of the node vector
+   * \return The index of the new node
+   * \throws std::length_error There are no more node indices available
+   */
+  std::uint32_t createTrieNode();
+
+  /*!
+   * Get the child of a node for a character index
+   * \param node The node to look in
+   * \param idx The character index of the child
+   * \return The index of the child node, or ROOT_NODE if there is no child for idx
+   */
+  inline std::uint32_t child(const TrieNode& node, unsigned int idx) const;
+
+  /*!
+   * Create a new child of a node with the given edge label
+   * \param node The index of the node to add the child to
+   * \param str The string containing the label
+   * \param pos The start of the label in str
+   * \param length The length of the label
+   * \return The index of the new child node
+   * \throws std::length_error There is no more space for labels
+   */
+  std::uint32_t addChild(std::uint32_t node, const std::string& str, std::string::size_type pos,
+    std::string::size_type length);
+
+  /*!
+   * Unlink a child from a node, moving the node's children to a smaller block if they'll fit
+   * \param node The index of the node to remove the child from
+   * \param idx The character index of the child
+   */
+  void unlinkChild(std::uint32_t node, unsigned int idx);
+
+  /*!
+   * Put a node, and everything below it, on the free list
+   * \param node The index of the node, which mustn't be linked to a parent any more
+   */
+  void freeSubtree(std::uint32_t node);
+
+  /*!
+   * Link an existing node in as a child, moving the node's children to a bigger block if needed
+   * \param node The index of the node to add the child to
+   * \param idx The character index of the child (the first character of its label)
+   * \param child_node The index of the child
+   */
+  void linkChild(std::uint32_t node, unsigned int idx, std::uint32_t child_node);
+
+  /*!
+   * Split a node's edge in two, so the node ends part way along its old label
+   * \param node The index of the node to split
+   * \param length The length of the label the node keeps; a new child gets the rest
+   */
+  void splitNode(std::uint32_t node, std::uint32_t length);
+
+  /*!
+   * Get a block of child slots, reusing a free one if possible
+   * \param size_class The block holds 2^size_class slots
+   * \return The offset of the block in the slot vector
+   */
+  std::uint32_t allocateChildBlock(unsigned int size_class);
+
+  /*!
+   * Check that every index in a trie opened from an image stays inside its arrays,
+   * and that the nodes form a tree, so searching it can't read past the image
+   * \param path The path of the image, for the error message
+   * \throws std::runtime_error The image is damaged
    */
-  TrieNode* createTrieNode();
+  void checkImage(const std::string& path) const;
+
+  /*!
+   * Get the number of live children of a node
+   * \param node The node to check
+   * \return The number of children
+   */
+  inline unsigned int countChildren(const TrieNode& node) const;
+
+  /*!
+   * Get the first live child of a node at or after a character index
+   * \param node The node to check
+   * \param from The character index to start looking from
+   * \return The character index of the child, or trie_node_size_ if there are no more
+   */
+  inline unsigned int nextChild(const TrieNode& node, unsigned int from) const;
 
   /*!
    * Get the longest unambiguous string that extends beyond passed in string
    * \param node The next node to test
+   * \retval word The word to the node on the way in, and to the returned node on the way out
    * \return A tuple indicating the number of matches when we reach the end of the unambiguous
-   *         path, and the unambiguous path's string, and the node where it stopped
+   *         path and the node where it stopped
    * \throws std::runtime_error One of the nodes is incorrecly setup
    */
-  std::tuple<std::size_t, std::string, TrieNode*> getLongestString(TrieNode* node) const;
+  std::tuple<std::size_t, std::uint32_t> getLongestString(std::uint32_t node, std::string& word) const;
 
   /*!
-   * Get the number of children of a node that are non-nullptrs
-   * \param node The node to check
-   * \return A vector of indices to the live children
+   * Find the node for a string
+   * \param str The string to search for
+   * \retval rest_of_edge The position in the labels of any part of the node's edge past the end of str
+   * \retval rest_length The length of the edge past the end of str
+   * \return The node where str ends (possibly part way along its edge), or nothing if str isn't in the trie
    */
-  inline std::vector<unsigned int> getLiveChildren(TrieNode* node) const;
+  std::tuple<bool, std::uint32_t> findNode(const std::string& str, std::uint32_t& rest_of_edge,
+    std::uint32_t& rest_length) const;
 
   /*!
    * Get the possible commands from a given node
    * \param node The node to get the commands from 
-   * \retval poss_cmds The vector we're building up containing possible commands
+   * \retval matches The results we're adding the commands to. Its working word must hold the word to
+   *                 the node on the way in, and is unchanged on return
+   * \param skip The number of commands still to skip before adding any
+   * \param remaining The number of commands we can still add
+   */
+  void getPossibleCommands(std::uint32_t node, TrieMatches& matches, std::size_t& skip,
+    std::size_t& remaining) const;
+
+  /*!
+   * Get the position a cursor is at, as findNode() would for its prefix
+   * \param cursor The cursor
+   * \retval rest_of_edge The position in the labels of any part of the node's edge past the end of the prefix
+   * \retval rest_length The length of the edge past the end of the prefix
+   * \return The node where the prefix ends, or nothing if the prefix isn't in the trie
    */
-  void getPossibleCommands(TrieNode* node, std::vector<std::string>& poss_cmds) const;
+  std::tuple<bool, std::uint32_t> cursorNode(const TrieCursor& cursor, std::uint32_t& rest_of_edge,
+    std::uint32_t& rest_length) const;
+
+  /*!
+   * Fill in the completion of a string that's been found in the trie
+   * \param str The string
+   * \param node The node where the string ends
+   * \param rest_of_edge The position in the labels of any part of the node's edge past the end of str
+   * \param rest_length The length of the edge past the end of str
+   * \retval matches The results, which get the completion, the number of paths and the total
+   * \return The node at the end of the completion
+   */
+  std::uint32_t complete(std::string_view str, std::uint32_t node, std::uint32_t rest_of_edge,
+    std::uint32_t rest_length, TrieMatches& matches) const;
+
+  /*!
+   * Add the best scoring commands under a node to the results, best first
+   * \param start_node The node at the end of the completion in the results
+   * \retval matches The results, which must already have the completion
+   * \param first The number of the best matching commands to skip before the ones returned
+   * \param max_commands The most matching commands to return
+   */
+  void rankFrom(std::uint32_t start_node, TrieMatches& matches, std::size_t first, std::size_t max_commands) const;
 
   /*!
    *  Recursively print out all the nodes of the trie - useful for debugging
    *  \param node The current node to print out information for
+   *  \param word The word to the node
    */
-  void print(TrieNode* node);
+  void print(std::uint32_t node, std::string& word);
+
+  //! All the nodes in the trie - the root (if there is one) is the first
+  TrieArray<TrieNode> nodes_;
 
-  //! The root of the trie
-  TrieNode* trie_root_;
+  //! The edge labels for all the nodes
+  TrieArray<char> labels_;
 
-  /*! A vector containing the indexes for each ASCII value
-   *  \note This allows us to quickly use the ASCII code as an index to the vector
+  //! The child blocks for all the nodes - each holds node indices in character order
+  TrieArray<std::uint32_t> child_slots_;
+
+  //! Child blocks that have been outgrown and can be reused, one list per block size
+  std::vector<std::uint32_t> free_blocks_[N_BLOCK_SIZES];
+
+  //! Nodes that have been removed and can be reused
+  std::vector<std::uint32_t> free_nodes_;
+
+  /*! A vector containing the indexes for each byte value
+   *  \note This allows us to quickly use the byte as an index to the vector
    *        to get an index in the trie
    */
   std::vector<unsigned int> index_;
@@ -168,5 +733,14 @@ private:
 
   //! The number of indicies we need to represent in each node
   unsigned int trie_node_size_;
+
+  //! How we lay out the nodes
+  TrieMode mode_;
+
+  //! Changed whenever a command is added or removed, so old cursors are walked again
+  std::uint64_t version_ = 1;
+
+  //! The image the arrays are looking at, if the trie was opened from one
+  std::shared_ptr<const MappedFile> image_;
 };
 
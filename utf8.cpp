@@ -0,0 +1,316 @@
+/*
+ * File: utf8.cpp
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// test-console includes
+#include <utf8.h>
+
+// STL includes
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+namespace
+{
+  //! A range of characters with the same width
+  struct WidthRange
+  {
+    char32_t first;  /*!< The first character in the range */
+    char32_t last;   /*!< The last character in the range */
+  };
+
+  //! Wide (East Asian full width and wide) characters, which take two columns
+  constexpr WidthRange WIDE_CHARS[] = {
+    { 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC }, { 0x23F0, 0x23F0 },
+    { 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 }, { 0x2648, 0x2653 }, { 0x267F, 0x267F },
+    { 0x2693, 0x2693 }, { 0x26A1, 0x26A1 }, { 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 },
+    { 0x26CE, 0x26CE }, { 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 },
+    { 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B }, { 0x2728, 0x2728 },
+    { 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 }, { 0x2757, 0x2757 }, { 0x2795, 0x2797 },
+    { 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF }, { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 },
+    { 0x2E80, 0x303E }, { 0x3041, 0x33FF }, { 0x3400, 0x4DBF }, { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF },
+    { 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF }, { 0xFE10, 0xFE19 }, { 0xFE30, 0xFE6F },
+    { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 },
+    { 0x16FE0, 0x16FE4 }, { 0x17000, 0x18CFF }, { 0x1B000, 0x1B2FF }, { 0x1F004, 0x1F004 },
+    { 0x1F0CF, 0x1F0CF }, { 0x1F18E, 0x1F18E }, { 0x1F191, 0x1F19A }, { 0x1F200, 0x1F202 },
+    { 0x1F210, 0x1F23B }, { 0x1F240, 0x1F248 }, { 0x1F250, 0x1F251 }, { 0x1F260, 0x1F265 },
+    { 0x1F300, 0x1F64F }, { 0x1F680, 0x1F6FF }, { 0x1F7E0, 0x1F7EB }, { 0x1F90C, 0x1F9FF },
+    { 0x1FA70, 0x1FAFF }, { 0x20000, 0x2FFFD }, { 0x30000, 0x3FFFD }
+  };
+
+  //! Combining marks and other characters that don't move the cursor
+  constexpr WidthRange ZERO_WIDTH_CHARS[] = {
+    { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x05BF, 0x05BF }, { 0x05C1, 0x05C2 },
+    { 0x05C4, 0x05C5 }, { 0x05C7, 0x05C7 }, { 0x0610, 0x061A }, { 0x064B, 0x065F }, { 0x0670, 0x0670 },
+    { 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 }, { 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED }, { 0x0711, 0x0711 },
+    { 0x0730, 0x074A }, { 0x07A6, 0x07B0 }, { 0x07EB, 0x07F3 }, { 0x0816, 0x0819 }, { 0x081B, 0x0823 },
+    { 0x0825, 0x0827 }, { 0x0829, 0x082D }, { 0x0859, 0x085B }, { 0x08D3, 0x08E1 }, { 0x08E3, 0x0902 },
+    { 0x093A, 0x093A }, { 0x093C, 0x093C }, { 0x0941, 0x0948 }, { 0x094D, 0x094D }, { 0x0951, 0x0957 },
+    { 0x0962, 0x0963 }, { 0x0981, 0x0981 }, { 0x09BC, 0x09BC }, { 0x09C1, 0x09C4 }, { 0x09CD, 0x09CD },
+    { 0x09E2, 0x09E3 }, { 0x0A01, 0x0A02 }, { 0x0A3C, 0x0A3C }, { 0x0A41, 0x0A42 }, { 0x0A47, 0x0A48 },
+    { 0x0A4B, 0x0A4D }, { 0x0A51, 0x0A51 }, { 0x0A70, 0x0A71 }, { 0x0A75, 0x0A75 }, { 0x0A81, 0x0A82 },
+    { 0x0ABC, 0x0ABC }, { 0x0AC1, 0x0AC5 }, { 0x0AC7, 0x0AC8 }, { 0x0ACD, 0x0ACD }, { 0x0AE2, 0x0AE3 },
+    { 0x0B01, 0x0B01 }, { 0x0B3C, 0x0B3C }, { 0x0B3F, 0x0B3F }, { 0x0B41, 0x0B44 }, { 0x0B4D, 0x0B4D },
+    { 0x0B56, 0x0B56 }, { 0x0B62, 0x0B63 }, { 0x0B82, 0x0B82 }, { 0x0BC0, 0x0BC0 }, { 0x0BCD, 0x0BCD },
+    { 0x0C00, 0x0C00 }, { 0x0C3E, 0x0C40 }, { 0x0C46, 0x0C48 }, { 0x0C4A, 0x0C4D }, { 0x0C55, 0x0C56 },
+    { 0x0C62, 0x0C63 }, { 0x0CBC, 0x0CBC }, { 0x0CCC, 0x0CCD }, { 0x0CE2, 0x0CE3 }, { 0x0D00, 0x0D01 },
+    { 0x0D41, 0x0D44 }, { 0x0D4D, 0x0D4D }, { 0x0D62, 0x0D63 }, { 0x0DCA, 0x0DCA }, { 0x0DD2, 0x0DD4 },
+    { 0x0DD6, 0x0DD6 }, { 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E }, { 0x0EB1, 0x0EB1 },
+    { 0x0EB4, 0x0EBC }, { 0x0EC8, 0x0ECD }, { 0x0F18, 0x0F19 }, { 0x0F35, 0x0F35 }, { 0x0F37, 0x0F37 },
+    { 0x0F39, 0x0F39 }, { 0x0F71, 0x0F7E }, { 0x0F80, 0x0F84 }, { 0x0F86, 0x0F87 }, { 0x0F8D, 0x0FBC },
+    { 0x0FC6, 0x0FC6 }, { 0x102D, 0x1030 }, { 0x1032, 0x1037 }, { 0x1039, 0x103A }, { 0x103D, 0x103E },
+    { 0x1058, 0x1059 }, { 0x105E, 0x1060 }, { 0x1071, 0x1074 }, { 0x1082, 0x1082 }, { 0x1085, 0x1086 },
+    { 0x108D, 0x108D }, { 0x109D, 0x109D }, { 0x1160, 0x11FF }, { 0x135D, 0x135F }, { 0x1712, 0x1714 },
+    { 0x1732, 0x1734 }, { 0x1752, 0x1753 }, { 0x1772, 0x1773 }, { 0x17B4, 0x17B5 }, { 0x17B7, 0x17BD },
+    { 0x17C6, 0x17C6 }, { 0x17C9, 0x17D3 }, { 0x17DD, 0x17DD }, { 0x180B, 0x180E }, { 0x1885, 0x1886 },
+    { 0x18A9, 0x18A9 }, { 0x1920, 0x1922 }, { 0x1927, 0x1928 }, { 0x1932, 0x1932 }, { 0x1939, 0x193B },
+    { 0x1A17, 0x1A18 }, { 0x1A1B, 0x1A1B }, { 0x1A56, 0x1A56 }, { 0x1A58, 0x1A5E }, { 0x1A60, 0x1A60 },
+    { 0x1A62, 0x1A62 }, { 0x1A65, 0x1A6C }, { 0x1A73, 0x1A7C }, { 0x1A7F, 0x1A7F }, { 0x1AB0, 0x1AFF },
+    { 0x1B00, 0x1B03 }, { 0x1B34, 0x1B34 }, { 0x1B36, 0x1B3A }, { 0x1B3C, 0x1B3C }, { 0x1B42, 0x1B42 },
+    { 0x1B6B, 0x1B73 }, { 0x1B80, 0x1B81 }, { 0x1BA2, 0x1BA5 }, { 0x1BA8, 0x1BA9 }, { 0x1BAB, 0x1BAD },
+    { 0x1BE6, 0x1BE6 }, { 0x1BE8, 0x1BE9 }, { 0x1BED, 0x1BED }, { 0x1BEF, 0x1BF1 }, { 0x1C2C, 0x1C33 },
+    { 0x1C36, 0x1C37 }, { 0x1CD0, 0x1CD2 }, { 0x1CD4, 0x1CE0 }, { 0x1CE2, 0x1CE8 }, { 0x1CED, 0x1CED },
+    { 0x1CF4, 0x1CF4 }, { 0x1CF8, 0x1CF9 }, { 0x1DC0, 0x1DFF }, { 0x200B, 0x200F }, { 0x202A, 0x202E },
+    { 0x2060, 0x2064 }, { 0x20D0, 0x20F0 }, { 0x2CEF, 0x2CF1 }, { 0x2D7F, 0x2D7F }, { 0x2DE0, 0x2DFF },
+    { 0x302A, 0x302D }, { 0x3099, 0x309A }, { 0xA66F, 0xA672 }, { 0xA674, 0xA67D }, { 0xA69E, 0xA69F },
+    { 0xA6F0, 0xA6F1 }, { 0xA802, 0xA802 }, { 0xA806, 0xA806 }, { 0xA80B, 0xA80B }, { 0xA825, 0xA826 },
+    { 0xA8C4, 0xA8C5 }, { 0xA8E0, 0xA8F1 }, { 0xA8FF, 0xA8FF }, { 0xA926, 0xA92D }, { 0xA947, 0xA951 },
+    { 0xA980, 0xA982 }, { 0xA9B3, 0xA9B3 }, { 0xA9B6, 0xA9B9 }, { 0xA9BC, 0xA9BD }, { 0xA9E5, 0xA9E5 },
+    { 0xAA29, 0xAA2E }, { 0xAA31, 0xAA32 }, { 0xAA35, 0xAA36 }, { 0xAA43, 0xAA43 }, { 0xAA4C, 0xAA4C },
+    { 0xAA7C, 0xAA7C }, { 0xAAB0, 0xAAB0 }, { 0xAAB2, 0xAAB4 }, { 0xAAB7, 0xAAB8 }, { 0xAABE, 0xAABF },
+    { 0xAAC1, 0xAAC1 }, { 0xAAEC, 0xAAED }, { 0xAAF6, 0xAAF6 }, { 0xABE5, 0xABE5 }, { 0xABE8, 0xABE8 },
+    { 0xABED, 0xABED }, { 0xD7B0, 0xD7FF }, { 0xFB1E, 0xFB1E }, { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F },
+    { 0xFEFF, 0xFEFF }, { 0xFFF9, 0xFFFB },
+    { 0x101FD, 0x101FD }, { 0x102E0, 0x102E0 }, { 0x10376, 0x1037A }, { 0x10A01, 0x10A0F },
+    { 0x10A38, 0x10A3F }, { 0x11001, 0x11001 }, { 0x11038, 0x11046 }, { 0x1107F, 0x11081 },
+    { 0x1D167, 0x1D169 }, { 0x1D173, 0x1D182 }, { 0x1D185, 0x1D18B }, { 0x1D1AA, 0x1D1AD },
+    { 0x1E8D0, 0x1E8D6 }, { 0x1E944, 0x1E94A }, { 0xE0001, 0xE0001 }, { 0xE0020, 0xE007F },
+    { 0xE0100, 0xE01EF }
+  };
+
+  //! The number of characters in the Basic Multilingual Plane, which the width table covers
+  constexpr std::size_t BMP_SIZE = 0x10000;
+
+  //! The width of every character in the BMP, packed four to a byte, so looking one up is an index and a shift
+  using WidthTable = std::array<std::uint8_t, BMP_SIZE / 4>;
+
+  // Set the width of a range of characters in the table
+  void setWidths(WidthTable& table, const WidthRange& range, unsigned int width)
+  {
+    for (char32_t c = range.first; c <= range.last && c < BMP_SIZE; ++c)
+    {
+      unsigned int shift = (c % 4) * 2;
+      table[c / 4] = static_cast<std::uint8_t>((table[c / 4] & ~(3u << shift)) | (width << shift));
+    }
+  }
+
+  // Look up a character in the width table
+  inline unsigned int tableWidth(const WidthTable& table, char32_t c)
+  {
+    return (table[c / 4] >> ((c % 4) * 2)) & 3;
+  }
+
+  // Build the width table. This is done the first time it's needed rather than
+  // by the compiler, as filling 64K entries is more than some compilers will
+  // evaluate at compile time
+  WidthTable makeWidthTable()
+  {
+    // Everything's one column to start with (0b01 in each pair of bits)
+    WidthTable table;
+    table.fill(0x55);
+
+    // Controls don't take up any room. Zero width characters go after the
+    // wide ones, as a few of them are inside wide ranges
+    setWidths(table, { 0x00, 0x1F }, 0);
+    setWidths(table, { 0x7F, 0x9F }, 0);
+    for (const auto& range : WIDE_CHARS)
+      setWidths(table, range, 2);
+    for (const auto& range : ZERO_WIDTH_CHARS)
+      setWidths(table, range, 0);
+
+    assert(tableWidth(table, 'a') == 1 && "ASCII letters take one column");
+    assert(tableWidth(table, 0x4E2D) == 2 && "CJK ideographs take two columns");
+    assert(tableWidth(table, 0x0301) == 0 && "Combining accents don't take any");
+    return table;
+  }
+
+  // Get the width of every character in the BMP
+  const WidthTable& bmpWidths()
+  {
+    static const WidthTable table = makeWidthTable();
+    return table;
+  }
+
+  // Check if a character is in a set of sorted ranges
+  template <std::size_t N>
+  bool inRanges(const WidthRange (&ranges)[N], char32_t c)
+  {
+    auto it = std::upper_bound(std::begin(ranges), std::end(ranges), c,
+      [](char32_t value, const WidthRange& range) { return value < range.first; });
+    return it != std::begin(ranges) && c <= (it - 1)->last;
+  }
+
+  // Check a sequence is one whole character
+  bool isValidSequence(std::string_view sequence)
+  {
+    if (sequence.empty() || utf8SequenceLength(static_cast<unsigned char>(sequence[0])) != sequence.size())
+      return false;
+    for (std::size_t i = 1; i < sequence.size(); ++i)
+    {
+      if (!isUtf8Continuation(static_cast<unsigned char>(sequence[i])))
+        return false;
+    }
+
+    // The second byte rules out the overlong forms, surrogates and anything past U+10FFFF
+    auto lead = static_cast<unsigned char>(sequence[0]);
+    auto next = static_cast<unsigned char>(sequence.size() > 1 ? sequence[1] : 0x80);
+    if (lead == 0xE0 && next < 0xA0)
+      return false;
+    if (lead == 0xED && next > 0x9F)
+      return false;
+    if (lead == 0xF0 && next < 0x90)
+      return false;
+    if (lead == 0xF4 && next > 0x8F)
+      return false;
+    return true;
+  }
+}
+
+// Check some text is valid UTF-8
+bool isValidUtf8(std::string_view text)
+{
+  std::size_t pos = 0;
+  while (pos < text.size())
+  {
+    std::size_t length = utf8SequenceLength(static_cast<unsigned char>(text[pos]));
+    if (length == 0 || pos + length > text.size() || !isValidSequence(text.substr(pos, length)))
+      return false;
+    pos += length;
+  }
+  return true;
+}
+
+// Decode a character
+char32_t decodeUtf8(std::string_view text, std::size_t pos, std::size_t& length)
+{
+  auto lead = static_cast<unsigned char>(text[pos]);
+  length = utf8SequenceLength(lead);
+  if (length == 1)
+    return lead;
+  if (length == 0 || pos + length > text.size() || !isValidSequence(text.substr(pos, length)))
+  {
+    length = 1;
+    return 0xFFFD;
+  }
+
+  char32_t c = lead & (0x7F >> length);
+  for (std::size_t i = 1; i < length; ++i)
+    c = (c << 6) | (static_cast<unsigned char>(text[pos + i]) & 0x3F);
+  return c;
+}
+
+// Encode a character
+std::size_t encodeUtf8(char32_t c, char* out)
+{
+  if (c < 0x80)
+  {
+    out[0] = static_cast<char>(c);
+    return 1;
+  }
+  if (c < 0x800)
+  {
+    out[0] = static_cast<char>(0xC0 | (c >> 6));
+    out[1] = static_cast<char>(0x80 | (c & 0x3F));
+    return 2;
+  }
+  if (c >= 0xD800 && c <= 0xDFFF)
+    return 0;
+  if (c < 0x10000)
+  {
+    out[0] = static_cast<char>(0xE0 | (c >> 12));
+    out[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (c & 0x3F));
+    return 3;
+  }
+  if (c < 0x110000)
+  {
+    out[0] = static_cast<char>(0xF0 | (c >> 18));
+    out[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (c & 0x3F));
+    return 4;
+  }
+  return 0;
+}
+
+// Get the width of a character
+unsigned int charWidth(char32_t c)
+{
+  if (c < BMP_SIZE)
+    return tableWidth(bmpWidths(), c);
+  if (inRanges(ZERO_WIDTH_CHARS, c))
+    return 0;
+  return inRanges(WIDE_CHARS, c) ? 2 : 1;
+}
+
+// Get the width of some text
+std::size_t displayWidth(std::string_view text)
+{
+  std::size_t width = 0;
+  std::size_t pos = 0;
+  while (pos < text.size())
+  {
+    // Printable ASCII is one column, without decoding anything
+    auto c = static_cast<unsigned char>(text[pos]);
+    if (c >= 0x20 && c < 0x7F)
+    {
+      ++width;
+      ++pos;
+      continue;
+    }
+
+    std::size_t length = 1;
+    width += charWidth(decodeUtf8(text, pos, length));
+    pos += length;
+  }
+  return width;
+}
+
+// Get the length without a partial character at the end
+std::size_t completeUtf8Length(std::string_view text)
+{
+  // Look back for the start of the last character
+  std::size_t start = text.size();
+  while (start > 0 && text.size() - start < UTF8_MAX_BYTES && isUtf8Continuation(static_cast<unsigned char>(text[start - 1])))
+    --start;
+  if (start == 0)
+    return text.size();
+
+  std::size_t length = utf8SequenceLength(static_cast<unsigned char>(text[start - 1]));
+  return length > text.size() - (start - 1) ? start - 1 : text.size();
+}
@@ -0,0 +1,118 @@
+/*
+ * File: utf8.h
+ * Author: Thyme Chrystal
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Thyme Chrystal
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// STL includes
+#include <string_view>
+#include <cstddef>
+
+/*
+ * Helpers for the UTF-8 text the console edits. Lines are kept as UTF-8
+ * bytes, so the trie, the history and the output all work a byte at a time
+ * as before, and only moving the cursor and working out where it is on the
+ * screen need to know where characters start and how wide they are.
+ */
+
+//! The most bytes a character takes in UTF-8
+constexpr std::size_t UTF8_MAX_BYTES = 4;
+
+/*!
+ * Check if a byte continues a UTF-8 sequence (rather than starting a character)
+ * \param c The byte
+ * \return True for a continuation byte
+ */
+constexpr bool isUtf8Continuation(unsigned char c)
+{
+  return (c & 0xC0) == 0x80;
+}
+
+/*!
+ * Get the length of a UTF-8 sequence from its first byte
+ * \param c The first byte
+ * \return The number of bytes (1-4), or 0 if c can't start a character
+ */
+constexpr std::size_t utf8SequenceLength(unsigned char c)
+{
+  if (c < 0x80)
+    return 1;
+  if (c < 0xC2)
+    return 0;  // A continuation byte, or the start of an overlong sequence
+  if (c < 0xE0)
+    return 2;
+  if (c < 0xF0)
+    return 3;
+  if (c < 0xF5)
+    return 4;
+  return 0;
+}
+
+/*!
+ * Check that some text is all valid UTF-8
+ * \param text The text
+ * \return True if it's all whole characters, with no overlong forms, surrogates or values past U+10FFFF
+ */
+bool isValidUtf8(std::string_view text);
+
+/*!
+ * Decode the character at a position
+ * \param text The text
+ * \param pos Where the character starts
+ * \retval length Set to the number of bytes the character takes (at least 1, so a bad byte is skipped)
+ * \return The character, or U+FFFD if the bytes aren't valid UTF-8
+ */
+char32_t decodeUtf8(std::string_view text, std::size_t pos, std::size_t& length);
+
+/*!
+ * Encode a character in UTF-8
+ * \param c The character
+ * \retval out Where the bytes are written (room for UTF8_MAX_BYTES)
+ * \return The number of bytes written (0 if c isn't a character)
+ */
+std::size_t encodeUtf8(char32_t c, char* out);
+
+/*!
+ * Get the number of columns a character takes up on a terminal, following wcwidth()
+ * \param c The character
+ * \return 2 for wide (East Asian) characters, 0 for combining marks and controls, or 1
+ */
+unsigned int charWidth(char32_t c);
+
+/*!
+ * Get the number of columns some text takes up on a terminal
+ * \param text The UTF-8 text
+ * \return The number of columns
+ */
+std::size_t displayWidth(std::string_view text);
+
+/*!
+ * Get the length of the start of some text that doesn't stop part way through a character
+ * \param text The UTF-8 text
+ * \return The length in bytes
+ */
+std::size_t completeUtf8Length(std::string_view text);